@@ -0,0 +1,169 @@
+/*
+ *	autoplay.c - lets the computer player (tri2s-ai.c) play tri2s games on the host
+ *
+ *	this is the standard long-run stress and benchmark workload: it reports how many
+ *	landing places the player scores per second and how many games it plays per second.
+ *
+ *	every game is recorded (see tri2s-replay.h) as the device would, and the last line
+ *	says how many of them fit into the EEPROM.  with -o the first one is written to a
+ *	file, for host/replay or the EEPROM of the device.  it is cut off after REPLAY_SIZE
+ *	bytes.
+ *
+ *	usage: autoplay [-n games] [-s seed] [-m maxsteps] [-w lines,height,holes,bumpiness] [-o file] [-v]
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "tri2s-core.h"
+#include "tri2s-ai.h"
+#include "tri2s-replay.h"
+
+static double now (void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* a recording in progress */
+struct recording {
+	uint8_t data[REPLAY_SIZE];
+	int len;
+	int full;					// != 0 once the rest did not fit
+	struct replay_coder coder;
+};
+
+static void record_begin (struct recording* r, uint32_t seed) {
+	int i;
+	r->data[0] = 'T';
+	r->data[1] = REPLAY_FORMAT;
+	for (i = 0; i < 4; i++)
+		r->data[2 + i] = (uint8_t)(seed >> (8 * i));
+	r->data[6] = FIELD_LINES;
+	r->data[7] = FIELD_WIDTH;
+	r->len = REPLAY_HEADER;
+	r->full = 0;
+	replay_encode_begin(&r->coder);
+}
+
+// events are those of the step before (as on the device, see tri2s-record.c)
+static void record_input (struct recording* r, uint8_t input, uint8_t events) {
+	if (r->full)
+		return;
+	if (r->len + REPLAY_MAXOUT > REPLAY_SIZE - 4)
+		r->full = 1;						// full, the recording ends here
+	else
+		r->len += replay_encode(&r->coder, input, events, r->data + r->len);
+}
+
+//
+// ends the recording of the game s, returns 1 if the whole game is in it
+//
+static int record_end (struct recording* r, const struct tri2s_state* s) {
+	uint16_t sum = replay_checksum(s);
+	int over = !r->full && s->over;
+
+	r->len += replay_encode_end(&r->coder, over, r->data + r->len);
+	if (over) {
+		r->data[r->len++] = sum & 0xFF;
+		r->data[r->len++] = sum >> 8;
+	}
+	return over;
+}
+
+//
+// writes the recording to file name, returns 0 on errors
+//
+static int record_write (const struct recording* r, const char* name) {
+	FILE* f;
+
+	if (!(f = fopen(name, "wb")) || (fwrite(r->data, 1, r->len, f) != r->len)) {
+		perror(name);
+		return 0;
+	}
+	fclose(f);
+	return 1;
+}
+
+int main (int argc, char** argv) {
+	unsigned long games = 1000, maxsteps = 1000000, game;
+	uint32_t seed = 1;
+	int c, verbose = 0;
+	const char* output = NULL;
+	static struct recording rec;
+	uint64_t steps = 0, lines = 0, maxlines = 0, capped = 0, fit = 0;
+	double t;
+
+	while ((c = getopt(argc, argv, "n:s:m:w:o:v")) != -1) {
+		int l, h, o, b;
+		switch (c) {
+			case 'n': games = strtoul(optarg, NULL, 0); break;
+			case 's': seed = strtoul(optarg, NULL, 0); break;
+			case 'm': maxsteps = strtoul(optarg, NULL, 0); break;
+			case 'w':
+				if (sscanf(optarg, "%d,%d,%d,%d", &l, &h, &o, &b) != 4) {
+					fprintf(stderr, "-w needs four weights: lines,height,holes,bumpiness\n");
+					return 2;
+				}
+				AiWeights.lines = l;
+				AiWeights.height = h;
+				AiWeights.holes = o;
+				AiWeights.bumpiness = b;
+				break;
+			case 'o': output = optarg; break;
+			case 'v': verbose = 1; break;
+			default:
+				fprintf(stderr, "usage: %s [-n games] [-s seed] [-m maxsteps] [-w lines,height,holes,bumpiness] [-o file] [-v]\n", argv[0]);
+				return 2;
+		}
+	}
+
+	t = now();
+	for (game = 0; game < games; game++) {
+		struct tri2s_state s;
+		struct ai_player p = { { 0, 0, 0, 0 }, 0 };
+		uint64_t n = 0, gamelines = 0;
+		uint8_t events = 0;
+
+		tri2s_init(&s, seed + game);
+		record_begin(&rec, seed + game);
+		while (!(events & EV_GAMEOVER) && n < maxsteps) {
+			uint8_t input = ai_play(&p, &s, events);
+			record_input(&rec, input, events);
+			events = tri2s_step(&s, input);
+			if (events & EV_LINES)
+				gamelines += __builtin_popcountll(s.lines);
+			n++;
+		}
+		if (n >= maxsteps)
+			capped++;
+		fit += record_end(&rec, &s);
+		if (output && game == 0 && !record_write(&rec, output))
+			return 2;
+		if (verbose)
+			printf("game %lu: %" PRIu64 " steps, %" PRIu64 " lines, level %u%s\n",
+				game, n, gamelines, s.levelcount, (n >= maxsteps) ? " (still running)" : "");
+		steps += n;
+		lines += gamelines;
+		if (gamelines > maxlines)
+			maxlines = gamelines;
+	}
+	t = now() - t;
+
+	printf("games %lu (%" PRIu64 " stopped at %lu steps), steps %" PRIu64 ", lines %" PRIu64 " (%.1f per game, best %" PRIu64 ")\n",
+		games, capped, maxsteps, steps, lines, (double)lines / games, maxlines);
+	printf("searches %" PRIu32 ", placements %" PRIu32 ", cache hits %.1f%%\n",
+		AiStats.searches, AiStats.placements,
+		AiStats.placements ? 100.0 * AiStats.cachehits / AiStats.placements : 0.0);
+	printf("%.0f placements/sec, %.1f games/sec, %.0f steps/sec\n",
+		AiStats.placements / t, games / t, steps / t);
+	printf("recordings: %" PRIu64 " of %lu games fit into %d bytes\n", fit, games, REPLAY_SIZE);
+	return 0;
+}
@@ -0,0 +1,24 @@
+/*
+ *	avr/eeprom.h - stand-in for the avr-libc header, for building the game on the host
+ *
+ *	(see eeprom-host.c)  the EEPROM is an array, optionally kept in a file.
+ */
+
+#ifndef HOST_AVR_EEPROM_H
+#define HOST_AVR_EEPROM_H
+
+#include <inttypes.h>
+
+#define EEMEM
+
+uint8_t eeprom_read_byte (const uint8_t* addr);
+void eeprom_write_byte (uint8_t* addr, uint8_t value);
+void eeprom_update_byte (uint8_t* addr, uint8_t value);
+uint8_t eeprom_is_ready (void);
+void eeprom_busy_wait (void);
+
+// host only
+void eeprom_load (const char* file);
+void eeprom_save (const char* file);
+
+#endif /* HOST_AVR_EEPROM_H */
@@ -0,0 +1,15 @@
+/*
+ *	avr/interrupt.h - stand-in for the avr-libc header, for building the game on the host
+ *
+ *	(see miggl-host.c)  there are no interrupts, miggl-host.c does the work of the
+ *	timer interrupt whenever the game waits.
+ */
+
+#ifndef HOST_AVR_INTERRUPT_H
+#define HOST_AVR_INTERRUPT_H
+
+#define sei()
+#define cli()
+#define ISR(vector)		void vector (void)
+
+#endif /* HOST_AVR_INTERRUPT_H */
@@ -0,0 +1,43 @@
+/*
+ *	avr/io.h - stand-in for the avr-libc header, for building the game on the host
+ *
+ *	(see miggl-host.c)  the registers are plain variables that nothing else uses.  they are
+ *	static, so miggl.c builds on the host as well (see microbench.c).  with HOST_SHARED_REGS
+ *	they are extern: tri2s-host defines the timer 1 registers in miggl-host.c, which
+ *	reads what the audio code (miggl-audio.c) writes to them.
+ */
+
+#ifndef HOST_AVR_IO_H
+#define HOST_AVR_IO_H
+
+#include <inttypes.h>
+
+#define _BV(bit)	(1 << (bit))
+
+#ifdef HOST_SHARED_REGS
+#define HOST_REG	extern volatile
+#else
+#define HOST_REG	static volatile __attribute__((unused))
+#endif
+
+HOST_REG uint8_t PORTB, PORTC, PORTD;
+HOST_REG uint8_t DDRB, DDRC, DDRD;
+HOST_REG uint8_t PINB, PINC, PIND;
+HOST_REG uint8_t TCCR1A, TCCR1B, TIMSK1;
+HOST_REG uint16_t TCNT1, OCR1A, ICR1;
+HOST_REG uint8_t TCCR2A, TCCR2B, TIMSK2, TIFR2, TCNT2, OCR2A;
+HOST_REG uint8_t UCSR0B;
+
+enum { PB0, PB1, PB2, PB3, PB4, PB5, PB6, PB7 };
+enum { PC0, PC1, PC2, PC3, PC4, PC5, PC6 };
+enum { PD0, PD1, PD2, PD3, PD4, PD5, PD6, PD7 };
+enum { WGM10, WGM11, COM1B0 = 4, COM1B1, COM1A0, COM1A1 };
+enum { CS10, CS11, CS12, WGM12, WGM13 };
+enum { TOIE1 };
+enum { WGM20, WGM21 };
+enum { CS20, CS21, CS22, WGM22 };
+enum { TOIE2, OCIE2A, OCIE2B };
+enum { TOV2, OCF2A, OCF2B };
+enum { TXEN0 = 3, RXEN0 };
+
+#endif /* HOST_AVR_IO_H */
@@ -0,0 +1,19 @@
+/*
+ *	avr/pgmspace.h - stand-in for the avr-libc header, for building the game on the host
+ *
+ *	(see miggl-host.c)  the host has only one address space.
+ */
+
+#ifndef HOST_AVR_PGMSPACE_H
+#define HOST_AVR_PGMSPACE_H
+
+#include <inttypes.h>
+
+#define PROGMEM
+#define PSTR(s)					(s)
+#define pgm_read_byte(addr)		(*(const uint8_t*)(addr))
+#define pgm_read_word(addr)		(*(const uint16_t*)(addr))
+#define pgm_read_dword(addr)	(*(const uint32_t*)(addr))
+#define pgm_read_ptr(addr)		(*(void* const*)(addr))
+
+#endif /* HOST_AVR_PGMSPACE_H */
@@ -0,0 +1,64 @@
+/*
+ *	eeprom-host.c - the EEPROM functions of avr/eeprom.h for the host
+ *
+ *	(moved here from miggl-host.c, so microbench.c can use them too)  the EEPROM is an
+ *	array, erased (all 0xFF) at the start, and can be loaded from and saved to a file.
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <avr/eeprom.h>
+
+#define EEPROM_SIZE		512
+
+static uint8_t Eeprom[EEPROM_SIZE] = { [0 ... EEPROM_SIZE - 1] = 0xFF };	// like an erased EEPROM
+
+
+uint8_t eeprom_read_byte (const uint8_t* addr) {
+	return Eeprom[(uintptr_t)addr % EEPROM_SIZE];
+}
+
+void eeprom_write_byte (uint8_t* addr, uint8_t value) {
+	Eeprom[(uintptr_t)addr % EEPROM_SIZE] = value;
+}
+
+void eeprom_update_byte (uint8_t* addr, uint8_t value) {
+	Eeprom[(uintptr_t)addr % EEPROM_SIZE] = value;
+}
+
+uint8_t eeprom_is_ready (void) {
+	return 1;
+}
+
+void eeprom_busy_wait (void) {
+}
+
+//
+// reads the EEPROM from a file, if there is one
+//
+void eeprom_load (const char* file) {
+	FILE* f;
+
+	if ((f = fopen(file, "rb"))) {
+		if (fread(Eeprom, 1, sizeof(Eeprom), f) == 0)
+			memset(Eeprom, 0xFF, sizeof(Eeprom));
+		fclose(f);
+	}
+}
+
+//
+// writes the EEPROM to a file
+//
+void eeprom_save (const char* file) {
+	FILE* f;
+
+	if ((f = fopen(file, "wb"))) {
+		fwrite(Eeprom, 1, sizeof(Eeprom), f);
+		fclose(f);
+	}
+}
@@ -0,0 +1,260 @@
+/*
+ *	evalbatch.c - places stones on many fields at once and scores them, with SIMD
+ *
+ *	(see evalbatch.h)
+ *
+ *	all kernels do the same, a field per 64 bit lane:
+ *
+ *		the complete lines		the AND of the columns (bytes), without the hidden line
+ *		removing them			for each line, top to bottom: in the lanes that have it,
+ *								the bits above it move down one, per byte
+ *		height					per column 8 - the cells above its top-most filled one,
+ *								an empty column has 8 of those
+ *		holes					per column the empty cells below the top-most filled one
+ *		bumpiness				the height differences of neighbouring columns
+ *
+ *	the sums over the columns are _mm_sad_epu8(), the sum of absolute differences of the
+ *	bytes of a lane, which is also what the bumpiness is.
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#include <inttypes.h>
+#include <string.h>
+
+#include "evalbatch.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86	1
+#endif
+
+#define BYTES(v)		((board_t)(v) * 0x0101010101010101ULL)		// v in every byte
+#define COLUMNS			(((board_t)1 << (8 * FIELD_WIDTH - 1) << 1) - 1)	// the bytes of the columns
+#define NEIGHBOURS		(COLUMNS >> 8)								// columns with one to the right
+
+
+//
+// packs a field into a board_t and back
+//
+board_t board_pack (const field_t* field) {
+	board_t b = 0;
+	uint8_t i;
+	for (i = 0; i < FIELD_WIDTH; i++)
+		b |= (board_t)field[i] << (8 * i);
+	return b;
+}
+
+void board_unpack (board_t b, field_t* field) {
+	uint8_t i;
+	for (i = 0; i < FIELD_WIDTH; i++)
+		field[i] = (field_t)(b >> (8 * i));
+}
+
+//
+// returns the cells of a stone at (x y), it has to be within bounds (see stone_in_bounds())
+//
+board_t stone_board (uint8_t stone, int8_t x, int8_t y) {
+	field_t f[FIELD_WIDTH];
+	field_clear(f);
+	field_place_stone(f, stone, x, y);
+	return board_pack(f);
+}
+
+
+/* scalar */
+
+static uint8_t popcount8 (uint8_t x) {
+	return __builtin_popcount(x);
+}
+
+void eval_batch_scalar (struct eval_batch* b) {
+	int i, c;
+
+	for (i = 0; i < b->n; i++) {
+		board_t r = b->field[i] | b->stone[i];
+		uint8_t lines = FIELD_LINEMASK, line, h, lasth = 0, height = 0, holes = 0, bump = 0;
+
+		b->fits[i] = !(b->field[i] & b->stone[i]);
+		for (c = 0; c < FIELD_WIDTH; c++)
+			lines &= (uint8_t)(r >> (8 * c));
+		b->lines[i] = lines;
+		for (line = 1; line < 8; line++)
+			if (lines & (1 << line))
+				r = ((r & BYTES((1 << line) - 1)) << 1) | (r & BYTES((uint8_t)(0xFF << (line + 1))));
+		b->result[i] = r;
+
+		for (c = 0; c < FIELD_WIDTH; c++) {
+			uint8_t col = r >> (8 * c), top = col & -col;
+			h = 8 - popcount8(top - 1);
+			holes += popcount8(~(col | (uint8_t)((top << 1) - 1)));
+			height += h;
+			if (c > 0)
+				bump += (h > lasth) ? (h - lasth) : (lasth - h);
+			lasth = h;
+		}
+		b->height[i] = height;
+		b->holes[i] = holes;
+		b->bumpiness[i] = bump;
+	}
+}
+
+
+#ifdef HAVE_X86
+
+/* SSE2, two fields at a time */
+
+static inline __m128i popcount8_sse2 (__m128i x) {
+	x = _mm_sub_epi8(x, _mm_and_si128(_mm_srli_epi16(x, 1), _mm_set1_epi8(0x55)));
+	x = _mm_add_epi8(_mm_and_si128(x, _mm_set1_epi8(0x33)), _mm_and_si128(_mm_srli_epi16(x, 2), _mm_set1_epi8(0x33)));
+	return _mm_and_si128(_mm_add_epi8(x, _mm_srli_epi16(x, 4)), _mm_set1_epi8(0x0F));
+}
+
+__attribute__((target("sse2")))
+void eval_batch_sse2 (struct eval_batch* b) {
+	const __m128i zero = _mm_setzero_si128(), one = _mm_set1_epi8(1);
+	uint64_t lines[2], height[2], holes[2], bump[2], overlap[2];
+	int i, j, c;
+
+	for (i = 0; i < b->n; i += 2) {
+		__m128i f = _mm_load_si128((const __m128i*)&b->field[i]);
+		__m128i s = _mm_load_si128((const __m128i*)&b->stone[i]);
+		__m128i r = _mm_or_si128(f, s), l = r, top, pc, h;
+		int line;
+
+		_mm_storeu_si128((__m128i*)overlap, _mm_and_si128(f, s));
+		for (c = 1; c < FIELD_WIDTH; c++)
+			l = _mm_and_si128(l, _mm_srli_epi64(r, 8 * c));
+		l = _mm_and_si128(l, _mm_set1_epi64x(FIELD_LINEMASK));
+		_mm_storeu_si128((__m128i*)lines, l);
+
+		for (line = 1; line < 8; line++) {
+			__m128i sel = _mm_sub_epi64(zero, _mm_and_si128(_mm_srli_epi64(l, line), _mm_set1_epi64x(1)));
+			__m128i up = _mm_slli_epi64(_mm_and_si128(r, _mm_set1_epi64x(BYTES((1 << line) - 1))), 1);
+			__m128i down = _mm_and_si128(r, _mm_set1_epi64x(BYTES((uint8_t)(0xFF << (line + 1)))));
+			r = _mm_or_si128(_mm_and_si128(sel, _mm_or_si128(up, down)), _mm_andnot_si128(sel, r));
+		}
+		_mm_store_si128((__m128i*)&b->result[i], r);
+
+		top = _mm_and_si128(r, _mm_sub_epi8(zero, r));
+		pc = popcount8_sse2(_mm_sub_epi8(top, one));
+		h = _mm_sub_epi8(_mm_set1_epi8(8), pc);
+		_mm_storeu_si128((__m128i*)height, _mm_sad_epu8(h, zero));
+		_mm_storeu_si128((__m128i*)holes, _mm_sad_epu8(popcount8_sse2(
+			_mm_andnot_si128(_mm_or_si128(r, _mm_sub_epi8(_mm_add_epi8(top, top), one)), _mm_set1_epi64x(COLUMNS))), zero));
+		_mm_storeu_si128((__m128i*)bump, _mm_sad_epu8(_mm_and_si128(h, _mm_set1_epi64x(NEIGHBOURS)),
+			_mm_and_si128(_mm_srli_epi64(h, 8), _mm_set1_epi64x(NEIGHBOURS))));
+
+		for (j = 0; j < 2; j++) {
+			b->fits[i + j] = !overlap[j];
+			b->lines[i + j] = lines[j];
+			b->height[i + j] = height[j];
+			b->holes[i + j] = holes[j];
+			b->bumpiness[i + j] = bump[j];
+		}
+	}
+}
+
+
+/* AVX2, four fields at a time */
+
+__attribute__((target("avx2")))
+static inline __m256i popcount8_avx2 (__m256i x) {
+	const __m256i nibbles = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+		0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i low = _mm256_set1_epi8(0x0F);
+	return _mm256_add_epi8(_mm256_shuffle_epi8(nibbles, _mm256_and_si256(x, low)),
+		_mm256_shuffle_epi8(nibbles, _mm256_and_si256(_mm256_srli_epi16(x, 4), low)));
+}
+
+__attribute__((target("avx2")))
+void eval_batch_avx2 (struct eval_batch* b) {
+	const __m256i zero = _mm256_setzero_si256(), one = _mm256_set1_epi8(1);
+	uint64_t lines[4], height[4], holes[4], bump[4], overlap[4];
+	int i, j, c;
+
+	for (i = 0; i < b->n; i += 4) {
+		__m256i f = _mm256_load_si256((const __m256i*)&b->field[i]);
+		__m256i s = _mm256_load_si256((const __m256i*)&b->stone[i]);
+		__m256i r = _mm256_or_si256(f, s), l = r, top, pc, h;
+		int line;
+
+		_mm256_storeu_si256((__m256i*)overlap, _mm256_and_si256(f, s));
+		for (c = 1; c < FIELD_WIDTH; c++)
+			l = _mm256_and_si256(l, _mm256_srli_epi64(r, 8 * c));
+		l = _mm256_and_si256(l, _mm256_set1_epi64x(FIELD_LINEMASK));
+		_mm256_storeu_si256((__m256i*)lines, l);
+
+		for (line = 1; line < 8; line++) {
+			__m256i sel = _mm256_sub_epi64(zero, _mm256_and_si256(_mm256_srli_epi64(l, line), _mm256_set1_epi64x(1)));
+			__m256i up = _mm256_slli_epi64(_mm256_and_si256(r, _mm256_set1_epi64x(BYTES((1 << line) - 1))), 1);
+			__m256i down = _mm256_and_si256(r, _mm256_set1_epi64x(BYTES((uint8_t)(0xFF << (line + 1)))));
+			r = _mm256_blendv_epi8(r, _mm256_or_si256(up, down), sel);
+		}
+		_mm256_store_si256((__m256i*)&b->result[i], r);
+
+		top = _mm256_and_si256(r, _mm256_sub_epi8(zero, r));
+		pc = popcount8_avx2(_mm256_sub_epi8(top, one));
+		h = _mm256_sub_epi8(_mm256_set1_epi8(8), pc);
+		_mm256_storeu_si256((__m256i*)height, _mm256_sad_epu8(h, zero));
+		_mm256_storeu_si256((__m256i*)holes, _mm256_sad_epu8(popcount8_avx2(
+			_mm256_andnot_si256(_mm256_or_si256(r, _mm256_sub_epi8(_mm256_add_epi8(top, top), one)), _mm256_set1_epi64x(COLUMNS))), zero));
+		_mm256_storeu_si256((__m256i*)bump, _mm256_sad_epu8(_mm256_and_si256(h, _mm256_set1_epi64x(NEIGHBOURS)),
+			_mm256_and_si256(_mm256_srli_epi64(h, 8), _mm256_set1_epi64x(NEIGHBOURS))));
+
+		for (j = 0; j < 4; j++) {
+			b->fits[i + j] = !overlap[j];
+			b->lines[i + j] = lines[j];
+			b->height[i + j] = height[j];
+			b->holes[i + j] = holes[j];
+			b->bumpiness[i + j] = bump[j];
+		}
+	}
+}
+
+#else
+
+void eval_batch_sse2 (struct eval_batch* b) {
+	eval_batch_scalar(b);
+}
+
+void eval_batch_avx2 (struct eval_batch* b) {
+	eval_batch_scalar(b);
+}
+
+#endif
+
+
+/* the best kernel for this CPU */
+
+static void (*Kernel)(struct eval_batch* b);
+static const char* KernelName;
+
+static void choose_kernel (void) {
+	Kernel = eval_batch_scalar;
+	KernelName = "scalar";
+#ifdef HAVE_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		Kernel = eval_batch_avx2;
+		KernelName = "avx2";
+	} else if (__builtin_cpu_supports("sse2")) {
+		Kernel = eval_batch_sse2;
+		KernelName = "sse2";
+	}
+#endif
+}
+
+void eval_batch (struct eval_batch* b) {
+	if (!Kernel)
+		choose_kernel();
+	Kernel(b);
+}
+
+const char* eval_batch_kernel (void) {
+	if (!Kernel)
+		choose_kernel();
+	return KernelName;
+}
@@ -0,0 +1,58 @@
+/*
+ *	evalbatch.h - places stones on many fields at once and scores them, with SIMD
+ *
+ *	what the computer player (tri2s-ai.c) does for every place a stone can land in, for
+ *	a whole batch of fields and places at once: does the stone fit, which lines are
+ *	complete, the field with them removed, and the features ai_score_field() weighs
+ *	(the height of the stack, the holes below it and its bumpiness).
+ *
+ *	a field is a board_t: column i in byte i, bit 0 the hidden line and bit 7 the bottom
+ *	line, the same bits as field_t (see playfield.h).  so this is for the game's field of
+ *	7 lines (and up to 8 columns) only.  a 64 bit lane holds a field, SSE2 does two at a
+ *	time, AVX2 four.  eval_batch() uses AVX2 if the CPU has it, the others are there for
+ *	testing and comparing (see evalbench.c).
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#ifndef EVALBATCH_H
+#define EVALBATCH_H
+
+#include <inttypes.h>
+#include "playfield.h"
+
+#if (FIELD_LINES != 7) || (FIELD_WIDTH > 8)
+#error "evalbatch.h needs a field of 7 lines and at most 8 columns"
+#endif
+
+typedef uint64_t board_t;
+
+#define EVAL_BATCH		256		// fields per batch (a multiple of 4)
+
+/* a batch, the arrays are SIMD lanes */
+struct eval_batch {
+	board_t field[EVAL_BATCH];			// in: the fields ...
+	board_t stone[EVAL_BATCH];			// ... and the cells of the stone (see stone_board())
+	int n;								// ... in the batch
+	board_t result[EVAL_BATCH]			// out: the field with the stone, complete lines removed
+		__attribute__((aligned(32)));
+	uint8_t fits[EVAL_BATCH];			// 1 if the stone does not overlap the field
+	uint8_t lines[EVAL_BATCH];			// the complete lines (bits as in field_complete_lines())
+	uint8_t height[EVAL_BATCH];			// features of result, see ai_score_field()
+	uint8_t holes[EVAL_BATCH];
+	uint8_t bumpiness[EVAL_BATCH];
+} __attribute__((aligned(32)));
+
+board_t board_pack (const field_t* field);
+void board_unpack (board_t b, field_t* field);
+board_t stone_board (uint8_t stone, int8_t x, int8_t y);
+
+void eval_batch_scalar (struct eval_batch* b);
+void eval_batch_sse2 (struct eval_batch* b);
+void eval_batch_avx2 (struct eval_batch* b);
+void eval_batch (struct eval_batch* b);
+const char* eval_batch_kernel (void);
+
+#endif /* EVALBATCH_H */
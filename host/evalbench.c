@@ -0,0 +1,208 @@
+/*
+ *	evalbench.c - checks the kernels of evalbatch.c against the game and times them
+ *
+ *	every kernel gets the same batches of random fields and stones and has to give the
+ *	same answers as the functions of playfield.h and tri2s-ai.c for each of them:
+ *	stone_fits(), field_place_stone() and field_remove_lines() for the field, and
+ *	ai_score_field() with one weight at a time for the features.  then each kernel, and
+ *	ai_evaluate() for comparison, is timed on one thread; the numbers are fields
+ *	(a stone placed and the result scored) per second per core.
+ *
+ *	usage: evalbench [-n batches] [-s seed] [-q]
+ *
+ *		-n batches		batches of EVAL_BATCH fields that are checked, and timed
+ *		-q				no details about mismatches, only the benchmark lines
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "tri2s-core.h"
+#include "tri2s-ai.h"
+#include "evalbatch.h"
+
+#define ROUNDS		200		// times every batch is evaluated for the timing
+
+/* the kernels */
+static const struct {
+	const char* name;
+	void (*run)(struct eval_batch* b);
+} Kernels[] = {
+	{ "scalar", eval_batch_scalar },
+	{ "sse2", eval_batch_sse2 },
+	{ "avx2", eval_batch_avx2 },
+};
+#define KERNELS		(sizeof(Kernels) / sizeof(Kernels[0]))
+
+static double now (void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//
+// the inputs of a batch: a random field (hidden line included) and a random stone
+// somewhere within bounds.  most fields get the bottom lines nearly full, so lines
+// are completed now and then.
+//
+static void fill_batch (struct eval_batch* b, struct tri2s_state* rnd, int8_t* xs, int8_t* ys, uint8_t* stones) {
+	field_t f[FIELD_WIDTH];
+	int i, c;
+
+	for (i = 0; i < EVAL_BATCH; i++) {
+		uint8_t fill = tri2s_random(rnd, 8);
+		for (c = 0; c < FIELD_WIDTH; c++)
+			f[c] = (field_t)(tri2s_random(rnd, 256) | ~((2 << fill) - 1));
+		if (tri2s_random(rnd, 2))
+			f[tri2s_random(rnd, FIELD_WIDTH)] &= ~FIELD_BIT(tri2s_random(rnd, FIELD_LINES));
+		do {
+			stones[i] = get_random_stone(rnd);
+			xs[i] = 1 + tri2s_random(rnd, FIELD_LINES);
+			ys[i] = tri2s_random(rnd, FIELD_WIDTH);
+		} while (!stone_in_bounds(stones[i], xs[i], ys[i]));
+		// half the time, a stone that fits
+		if (tri2s_random(rnd, 2)) {
+			field_t s[FIELD_WIDTH];
+			board_unpack(stone_board(stones[i], xs[i], ys[i]), s);
+			for (c = 0; c < FIELD_WIDTH; c++)
+				f[c] &= ~s[c];
+		}
+		b->field[i] = board_pack(f);
+		b->stone[i] = stone_board(stones[i], xs[i], ys[i]);
+	}
+	b->n = EVAL_BATCH;
+}
+
+//
+// ai_score_field() with only one of the weights set
+//
+static int32_t feature (const field_t* f, int16_t height, int16_t holes, int16_t bumpiness) {
+	struct ai_weights w = { 0, height, holes, bumpiness };
+	AiWeights = w;
+	return ai_score_field(f);
+}
+
+//
+// compares the results of a kernel with the game, returns the number of mismatches
+//
+static int check_batch (const char* name, const struct eval_batch* b, const int8_t* xs, const int8_t* ys, const uint8_t* stones, int verbose) {
+	struct ai_weights saved = AiWeights;
+	field_t f[FIELD_WIDTH];
+	int i, bad = 0;
+
+	for (i = 0; i < b->n; i++) {
+		field_t lines;
+		uint8_t fits;
+
+		board_unpack(b->field[i], f);
+		fits = stone_fits(f, stones[i], xs[i], ys[i]);
+		field_place_stone(f, stones[i], xs[i], ys[i]);
+		lines = field_complete_lines(f);
+		field_remove_lines(f, lines);
+
+		if (b->fits[i] != fits || b->lines[i] != lines || b->result[i] != board_pack(f) ||
+				b->height[i] != feature(f, 1, 0, 0) || b->holes[i] != feature(f, 0, 1, 0) ||
+				b->bumpiness[i] != feature(f, 0, 0, 1)) {
+			if (verbose && bad < 10)
+				printf("%s: field %010" PRIx64 " stone %02x at (%d %d): fits %d lines %02x result %010" PRIx64
+					" height %d holes %d bumpiness %d, the game says %d %02x %010" PRIx64 " %d %d %d\n",
+					name, b->field[i], stones[i], xs[i], ys[i], b->fits[i], b->lines[i], b->result[i],
+					b->height[i], b->holes[i], b->bumpiness[i], fits, lines, board_pack(f),
+					feature(f, 1, 0, 0), feature(f, 0, 1, 0), feature(f, 0, 0, 1));
+			bad++;
+		}
+	}
+	AiWeights = saved;
+	return bad;
+}
+
+int main (int argc, char** argv) {
+	static struct eval_batch batch;
+	struct eval_batch* inputs;
+	struct tri2s_state rnd;
+	int8_t *xs, *ys;
+	uint8_t* stones;
+	int batches = 100, verbose = 1, i, j, r, bad = 0;
+	uint32_t seed = 1;
+	volatile int32_t sink = 0;
+	unsigned k;
+	double t;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:s:q")) != -1) {
+		switch (opt) {
+			case 'n': batches = atoi(optarg); break;
+			case 's': seed = strtoul(optarg, NULL, 0); break;
+			case 'q': verbose = 0; break;
+			default:
+				fprintf(stderr, "usage: %s [-n batches] [-s seed] [-q]\n", argv[0]);
+				return 2;
+		}
+	}
+	if (batches < 1)
+		batches = 1;
+
+	inputs = aligned_alloc(32, sizeof(*inputs) * batches);
+	xs = malloc(batches * EVAL_BATCH);
+	ys = malloc(batches * EVAL_BATCH);
+	stones = malloc(batches * EVAL_BATCH);
+	if (!inputs || !xs || !ys || !stones) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	// check every kernel on every batch
+	tri2s_init(&rnd, seed);
+	for (i = 0; i < batches; i++) {
+		int o = i * EVAL_BATCH;
+		fill_batch(&inputs[i], &rnd, xs + o, ys + o, stones + o);
+		for (k = 0; k < KERNELS; k++) {
+			batch = inputs[i];
+			Kernels[k].run(&batch);
+			bad += check_batch(Kernels[k].name, &batch, xs + o, ys + o, stones + o, verbose);
+		}
+	}
+	if (verbose)
+		printf("%d fields, %d mismatches, eval_batch() uses %s\n", batches * EVAL_BATCH, bad, eval_batch_kernel());
+
+	// time them
+	for (k = 0; k < KERNELS; k++) {
+		t = now();
+		for (r = 0; r < ROUNDS; r++)
+			for (i = 0; i < batches; i++) {
+				batch.n = EVAL_BATCH;
+				for (j = 0; j < EVAL_BATCH; j++) {
+					batch.field[j] = inputs[i].field[j];
+					batch.stone[j] = inputs[i].stone[j];
+				}
+				Kernels[k].run(&batch);
+				sink += batch.height[r & (EVAL_BATCH - 1)];
+			}
+		t = now() - t;
+		printf("%-8s %12.0f fields/s per core\n", Kernels[k].name, (double)ROUNDS * batches * EVAL_BATCH / t);
+	}
+
+	// and the game's own, one at a time
+	t = now();
+	for (r = 0; r < ROUNDS; r++)
+		for (i = 0; i < batches * EVAL_BATCH; i++) {
+			field_t f[FIELD_WIDTH];
+			board_unpack(inputs[i / EVAL_BATCH].field[i % EVAL_BATCH], f);
+			sink += ai_evaluate(f, stones[i], xs[i], ys[i]);
+		}
+	t = now() - t;
+	printf("%-8s %12.0f fields/s per core\n", "game", (double)ROUNDS * batches * EVAL_BATCH / t);
+
+	free(inputs);
+	free(xs);
+	free(ys);
+	free(stones);
+	return bad ? 1 : 0;
+}
@@ -0,0 +1,123 @@
+/*
+ *	fieldbench.c - host benchmark for the playfield operations
+ *
+ *	times collision tests, complete line detection and line removal (see playfield.h)
+ *	for the field size this is compiled with, e.g.
+ *
+ *		gcc -O2 -DFIELD_LINES=16 -o fieldbench fieldbench.c
+ *
+ *	"make bench-field" builds and runs it for a range of field sizes.
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../playfield.h"
+
+#define NFIELDS		256
+#define ROUNDS		20000
+
+static const uint8_t Stones[] = {
+	UP | MIDDLE | RIGHT, UP | LEFT | MIDDLE, LEFT | MIDDLE | DOWN, MIDDLE | RIGHT | DOWN,
+	UP | MIDDLE | DOWN, LEFT | MIDDLE | RIGHT
+};
+
+static field_t Fields[NFIELDS][FIELD_WIDTH];
+
+static volatile uint32_t Sink;
+
+static uint32_t xorshift (void) {
+	static uint32_t s = 2463534242UL;
+	s ^= s << 13;
+	s ^= s >> 17;
+	s ^= s << 5;
+	return s;
+}
+
+static double now (void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//
+// fills the fields with stacks of random height, every 4th one with a complete bottom line
+//
+static void make_fields (void) {
+	int i, y;
+	for (i = 0; i < NFIELDS; i++)
+		for (y = 0; y < FIELD_WIDTH; y++) {
+			int h = xorshift() % (FIELD_LINES / 2 + 1);
+			field_t below = (h == 0) ? 0 : (field_t)(FIELD_LINEMASK & ~(FIELD_BIT(FIELD_LINES - h) - 1));
+			Fields[i][y] = below & (field_t)(((uint64_t)xorshift() << 32) | xorshift());
+			if ((i & 3) == 0)
+				Fields[i][y] |= FIELD_BIT(FIELD_LINES - 1);
+		}
+}
+
+static void bench_fits (void) {
+	uint32_t sum = 0;
+	long ops = 0;
+	int r, i, s, x, y;
+	double t = now();
+	for (r = 0; r < ROUNDS / 100; r++)
+		for (i = 0; i < NFIELDS; i++)
+			for (s = 0; s < 6; s++)
+				for (x = 0; x <= FIELD_LINES; x++)
+					for (y = 0; y < FIELD_WIDTH; y++) {
+						sum += stone_fits(Fields[i], Stones[s], x, y);
+						ops++;
+					}
+	t = now() - t;
+	Sink = sum;
+	printf("  stone_fits           %8.2f ns/op\n", t * 1e9 / ops);
+}
+
+static void bench_complete (void) {
+	uint32_t sum = 0;
+	long ops = 0;
+	int r, i;
+	double t = now();
+	for (r = 0; r < ROUNDS; r++)
+		for (i = 0; i < NFIELDS; i++) {
+			sum += field_complete_line(Fields[i]);
+			ops++;
+		}
+	t = now() - t;
+	Sink = sum;
+	printf("  field_complete_line  %8.2f ns/op\n", t * 1e9 / ops);
+}
+
+static void bench_remove (void) {
+	field_t f[FIELD_WIDTH];
+	uint32_t sum = 0;
+	long ops = 0;
+	int r, i, y;
+	double t = now();
+	for (r = 0; r < ROUNDS; r++)
+		for (i = 0; i < NFIELDS; i++) {
+			for (y = 0; y < FIELD_WIDTH; y++)
+				f[y] = Fields[i][y];
+			field_remove_line(f, (r + i) % FIELD_LINES);
+			sum += (uint32_t)f[0];
+			ops++;
+		}
+	t = now() - t;
+	Sink = sum;
+	printf("  field_remove_line    %8.2f ns/op\n", t * 1e9 / ops);
+}
+
+int main (void) {
+	make_fields();
+	printf("field %d lines x %d columns (%d bit columns)\n", FIELD_LINES, FIELD_WIDTH, (int)sizeof(field_t) * 8);
+	bench_fits();
+	bench_complete();
+	bench_remove();
+	return 0;
+}
@@ -0,0 +1,366 @@
+/*
+ *	linksim.c - two devices playing matches over a simulated serial link
+ *
+ *	runs tri2s-link.c twice in one process, each with the computer player (tri2s-ai.c) on
+ *	the buttons, and connects them with a simulated UART in both directions: every byte
+ *	takes 10 bits at the baud rate on the line, and then the latency (plus up to the
+ *	jitter, in order) until it arrives.  each device plays a tick every 100ms of its own
+ *	clock, which can run off from the other one's (-p for the phase, -d for the drift),
+ *	and bytes can be damaged on the way (-e).  the player makes a random move now and
+ *	then (-m), so the games end and the guesses of the link can be wrong.
+ *
+ *	after every tick the confirmed games of each device are hashed by their tick, and the
+ *	two devices have to agree on every tick both have, and on who won.  it prints how
+ *	much the link sends (bytes per tick, bytes per second and the share of the line), how
+ *	long the bytes took to arrive, how far the devices played ahead of the confirmed games
+ *	and how often they waited for the other one or played ticks again.  it exits with 1 if
+ *	the games went apart.  -q prints one line.
+ *
+ *	usage: linksim [-n matches] [-s seed] [-b baud] [-l latency] [-j jitter] [-p phase]
+ *	               [-d drift] [-e errors] [-m mistakes] [-x maxticks] [-q]
+ *
+ *		-l, -j, -p		in ms
+ *		-d				the second device's clock, in percent slower (can be negative)
+ *		-e				the chance of a byte getting a bit flipped, e.g. 0.001
+ *		-m				the chance of a random input instead of the player's, in percent
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "tri2s-core.h"
+#include "tri2s-ai.h"
+#include "tri2s-link.h"
+
+#define TICK_US			100000	// a frame of the device
+#define WIRE_BYTES		65536	// bytes on the way, per direction
+#define LINGER			10		// ticks a device goes on after the match (LINK_LINGER in tri2s.c)
+
+static double now (void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* one direction of the link */
+struct wire {
+	uint8_t byte[WIRE_BYTES];
+	int64_t sent[WIRE_BYTES];	// when it was handed to the UART (us)
+	int64_t arrive[WIRE_BYTES];	// when it is there
+	unsigned head, tail;
+	int64_t busy;				// the line is busy sending until then
+};
+
+/* a simulated device */
+struct device {
+	struct link link;
+	struct ai_player player;
+	uint8_t events;				// of the last tick played, for the player
+	int64_t next;				// time of the next tick (us)
+	int64_t period;
+	int linger;					// ticks since the match was over
+	int finished;
+	uint8_t last;				// what link_tick() returned last
+	uint32_t* hash;				// of the confirmed games, by tick ...
+	uint8_t* hashed;			// ... if there is one
+};
+
+static struct device Dev[2];
+static struct wire Wire[2];			// Wire[i] is what device i sends
+
+/* the options */
+static unsigned long Baud = 38400;
+static double Latency = 5, Jitter = 0, Phase = 37, Drift = 0.5;
+static double Errors = 0, Mistakes = 5;
+static unsigned long MaxTicks = 20000;
+
+/* the totals */
+static uint64_t Ticks, Stalls, Rollbacks, Replayed, MsgErrors, Sent, Damaged;
+static uint64_t LagSum, LagCount, LagMax;
+static double ByteLatSum, ByteLatMax;
+static uint64_t ByteLatCount;
+static double SimTime;
+
+static uint32_t Rand = 1;
+
+static uint32_t rnd (void) {
+	Rand = Rand * 1103515245 + 12345;
+	return Rand >> 8;
+}
+
+static double rnd01 (void) {
+	return (rnd() & 0xFFFFFF) / (double)0x1000000;
+}
+
+//
+// a hash of the whole of both games (versus_checksum() leaves out the falling stone's place)
+//
+static uint32_t versus_hash (const struct versus_state* v) {
+	uint32_t h = 2166136261u;
+	int i, j;
+
+#define MIX(x)	(h = (h ^ (uint32_t)(x)) * 16777619u)
+	for (i = 0; i < 2; i++) {
+		const struct tri2s_state* g = &v->game[i];
+		for (j = 0; j < FIELD_WIDTH; j++)
+			MIX(g->field[j]);
+		MIX(g->lines); MIX(g->stone); MIX(g->stonex); MIX(g->stoney);
+		MIX(g->falltime); MIX(g->falltimemax); MIX(g->solvedlines); MIX(g->levelcount);
+		MIX(g->over); MIX(g->seeda); MIX(g->seedb);
+		MIX(v->garbage[i]);
+	}
+	MIX(v->hole);
+#undef MIX
+	return h;
+}
+
+//
+// puts the bytes a device sent at time t on the wire
+//
+static void wire_send (struct wire* w, const uint8_t* p, int n, int64_t t) {
+	int64_t bytetime = 10 * 1000000LL / Baud;
+	int64_t start, arrive;
+
+	while (n--) {
+		start = (w->busy > t) ? w->busy : t;
+		w->busy = start + bytetime;
+		arrive = w->busy + (int64_t)(Latency * 1000 + rnd01() * Jitter * 1000);
+		if ((w->head != w->tail) && (arrive < w->arrive[(w->head - 1) % WIRE_BYTES]))
+			arrive = w->arrive[(w->head - 1) % WIRE_BYTES];		// the bytes stay in order
+		if (w->head - w->tail >= WIRE_BYTES)
+			continue;			// (can't happen with a few bytes per tick)
+		w->byte[w->head % WIRE_BYTES] = *p++;
+		if ((Errors > 0) && (rnd01() < Errors)) {
+			w->byte[w->head % WIRE_BYTES] ^= 1 << (rnd() & 7);
+			Damaged++;
+		}
+		w->sent[w->head % WIRE_BYTES] = t;
+		w->arrive[w->head % WIRE_BYTES] = arrive;
+		w->head++;
+	}
+}
+
+//
+// gives the device the bytes that arrived until time t
+//
+static void wire_deliver (struct wire* w, struct device* d, int64_t t) {
+	double lat;
+
+	while ((w->tail != w->head) && (w->arrive[w->tail % WIRE_BYTES] <= t)) {
+		lat = (w->arrive[w->tail % WIRE_BYTES] - w->sent[w->tail % WIRE_BYTES]) / 1000.0;
+		ByteLatSum += lat;
+		ByteLatCount++;
+		if (lat > ByteLatMax)
+			ByteLatMax = lat;
+		link_receive(&d->link, w->byte[w->tail % WIRE_BYTES]);
+		w->tail++;
+	}
+}
+
+//
+// the player's input for the next tick, or now and then a random one
+//
+static uint8_t device_input (struct device* d) {
+	static const uint8_t random_input[4] = { 0, IN_ROTATE, IN_LEFT, IN_RIGHT };
+	struct link* l = &d->link;
+	uint8_t input;
+
+	if (l->state == LINK_WAIT)
+		return 0;
+	input = ai_play(&d->player, &l->current.game[l->me], d->events);
+	if (rnd01() * 100 < Mistakes)
+		input = random_input[rnd() & 3];
+	return input;
+}
+
+//
+// plays a match with the seeds of the devices.  returns 0 if the devices agreed on it,
+// 1 if the games went apart, 2 if the link was lost, 3 if it was stopped at MaxTicks,
+// 4 if the games went apart and the link noticed it (and was lost)
+//
+static int match (unsigned long n, uint8_t* results) {
+	struct device* dev = Dev;
+	struct device* d;
+	int64_t t = 0;
+	unsigned long k;
+	int i, capped = 0, lost = 0;
+
+	for (i = 0; i < 2; i++) {
+		Wire[i].head = Wire[i].tail = 0;
+		Wire[i].busy = 0;
+		d = &dev[i];
+		memset(&d->player, 0, sizeof(d->player));
+		d->events = 0;
+		d->period = TICK_US;
+		d->next = 0;
+		d->linger = 0;
+		d->finished = 0;
+		d->last = LINK_WAIT;
+		memset(d->hashed, 0, MaxTicks + 1);
+		link_begin(&d->link, rnd() ^ (rnd() << 8));
+	}
+	dev[1].period = (int64_t)(TICK_US * (1 + Drift / 100));
+	dev[1].next = (int64_t)(Phase * 1000);
+
+	while (!dev[0].finished || !dev[1].finished) {
+		i = dev[0].finished ? 1 : (dev[1].finished ? 0 : (dev[1].next < dev[0].next));
+		d = &dev[i];
+		t = d->next;
+		d->next += d->period;
+
+		wire_deliver(&Wire[!i], d, t);
+		d->last = link_tick(&d->link, device_input(d));
+		d->events = (d->last == LINK_PLAYED) ? d->link.events : 0;
+		wire_send(&Wire[i], d->link.out, d->link.outlen, t);
+
+		if (d->link.state != LINK_WAIT) {
+			k = d->link.tick - d->link.done;
+			LagSum += k;
+			LagCount++;
+			if (k > LagMax)
+				LagMax = k;
+		}
+		k = d->link.done;
+		if (k <= MaxTicks) {
+			d->hash[k] = versus_hash(&d->link.confirmed);
+			d->hashed[k] = 1;
+		}
+
+		if (d->last == LINK_OVER) {
+			if (++d->linger >= LINGER)
+				d->finished = 1;
+		} else if (d->last == LINK_LOST) {
+			lost = 1;
+			d->finished = 1;
+		} else if (d->link.tick >= MaxTicks) {
+			capped = 1;
+			dev[0].finished = dev[1].finished = 1;
+		}
+	}
+	SimTime += t / 1e6;
+
+	for (i = 0; i < 2; i++) {
+		struct link_stats* s = &dev[i].link.stats;
+		Ticks += s->ticks;
+		Stalls += s->stalls;
+		Rollbacks += s->rollbacks;
+		Replayed += s->replayed;
+		MsgErrors += s->errors;
+		Sent += s->sent;
+		results[i] = link_result(&dev[i].link);
+	}
+
+	for (k = 0; k <= MaxTicks; k++) {
+		if (dev[0].hashed[k] && dev[1].hashed[k] && (dev[0].hash[k] != dev[1].hash[k])) {
+			if (lost)
+				return 4;		// and the link noticed
+			fprintf(stderr, "match %lu: the games differ at tick %lu\n", n, k);
+			return 1;
+		}
+	}
+	if (lost)
+		return 2;
+	if (capped)
+		return 3;
+	if ((dev[0].link.me == dev[1].link.me) ||
+			!(((results[0] == LINK_DRAW) && (results[1] == LINK_DRAW)) ||
+			  ((results[0] == LINK_WIN) && (results[1] == LINK_LOSE)) ||
+			  ((results[0] == LINK_LOSE) && (results[1] == LINK_WIN)))) {
+		fprintf(stderr, "match %lu: the devices don't agree who won\n", n);
+		return 1;
+	}
+	return 0;
+}
+
+int main (int argc, char** argv) {
+	unsigned long matches = 100, m;
+	unsigned long apart = 0, noticed = 0, lost = 0, capped = 0, draws = 0, wins[2] = { 0, 0 };
+	int c, i, quiet = 0;
+	uint8_t results[2];
+	double t, secs;
+
+	while ((c = getopt(argc, argv, "n:s:b:l:j:p:d:e:m:x:q")) != -1) {
+		switch (c) {
+			case 'n': matches = strtoul(optarg, NULL, 0); break;
+			case 's': Rand = strtoul(optarg, NULL, 0); break;
+			case 'b': Baud = strtoul(optarg, NULL, 0); break;
+			case 'l': Latency = atof(optarg); break;
+			case 'j': Jitter = atof(optarg); break;
+			case 'p': Phase = atof(optarg); break;
+			case 'd': Drift = atof(optarg); break;
+			case 'e': Errors = atof(optarg); break;
+			case 'm': Mistakes = atof(optarg); break;
+			case 'x': MaxTicks = strtoul(optarg, NULL, 0); break;
+			case 'q': quiet = 1; break;
+			default:
+				fprintf(stderr, "usage: %s [-n matches] [-s seed] [-b baud] [-l latency] [-j jitter] [-p phase]\n"
+					"       [-d drift] [-e errors] [-m mistakes] [-x maxticks] [-q]\n", argv[0]);
+				return 2;
+		}
+	}
+	if (!Baud || !MaxTicks) {
+		fprintf(stderr, "-b and -x need to be more than 0\n");
+		return 2;
+	}
+
+	for (i = 0; i < 2; i++) {
+		Dev[i].hash = malloc((MaxTicks + 1) * sizeof(uint32_t));
+		Dev[i].hashed = malloc(MaxTicks + 1);
+		if (!Dev[i].hash || !Dev[i].hashed) {
+			fprintf(stderr, "out of memory\n");
+			return 2;
+		}
+	}
+
+	t = now();
+	for (m = 0; m < matches; m++) {
+		switch (match(m, results)) {
+			case 0:
+				if (results[0] == LINK_DRAW)
+					draws++;
+				else
+					wins[results[0] == LINK_WIN ? 0 : 1]++;
+				break;
+			case 1: apart++; break;
+			case 2: lost++; break;
+			case 3: capped++; break;
+			case 4: noticed++; break;
+		}
+	}
+	t = now() - t;
+	secs = SimTime ? SimTime : 1;
+
+	if (quiet) {
+		printf("baud %lu latency %.1f ms: %.2f bytes/tick, %.1f%% of the line, byte latency %.2f ms, "
+			"lag %.2f ticks, stalls %.2f%%, rollbacks %.2f%%, apart %lu, lost %lu\n",
+			Baud, Latency, Ticks ? (double)Sent / Ticks : 0, 100.0 * Sent * 10 / (Baud * secs * 2),
+			ByteLatCount ? ByteLatSum / ByteLatCount : 0, LagCount ? (double)LagSum / LagCount : 0,
+			Ticks ? 100.0 * Stalls / Ticks : 0, Ticks ? 100.0 * Rollbacks / Ticks : 0, apart, lost);
+		return apart ? 1 : 0;
+	}
+	printf("matches %lu: device 0 won %lu, device 1 won %lu, draws %lu, stopped at %lu ticks %lu, "
+		"link lost %lu, games apart %lu (and noticed %lu)\n", matches, wins[0], wins[1], draws, MaxTicks, capped,
+		lost, apart, noticed);
+	printf("link: %lu baud, latency %.1f ms + %.1f ms jitter, phase %.1f ms, drift %.2f%%, "
+		"bytes damaged %" PRIu64 " (receive errors %" PRIu64 ")\n",
+		Baud, Latency, Jitter, Phase, Drift, Damaged, MsgErrors);
+	printf("sent: %.2f bytes per tick, %.0f bytes/s per device, %.1f%% of the line\n",
+		Ticks ? (double)Sent / Ticks : 0, Sent / secs / 2, 100.0 * Sent * 10 / (Baud * secs * 2));
+	printf("byte latency: %.2f ms on average, %.2f ms at most (input delay %d ticks = %d ms)\n",
+		ByteLatCount ? ByteLatSum / ByteLatCount : 0, ByteLatMax, LINK_DELAY, LINK_DELAY * TICK_US / 1000);
+	printf("ahead of the confirmed games: %.2f ticks on average, %" PRIu64 " at most (rollback window %d)\n",
+		LagCount ? (double)LagSum / LagCount : 0, LagMax, LINK_ROLLBACK);
+	printf("ticks %" PRIu64 ", waited %" PRIu64 " (%.2f%%), wrong guesses %" PRIu64 " (%.2f%%), "
+		"ticks played again %" PRIu64 "\n", Ticks, Stalls, Ticks ? 100.0 * Stalls / Ticks : 0,
+		Rollbacks, Ticks ? 100.0 * Rollbacks / Ticks : 0, Replayed);
+	printf("%.1f s of matches simulated in %.2f s\n", SimTime, t);
+	return apart ? 1 : 0;
+}
@@ -0,0 +1,522 @@
+/*
+ *	miggl-host.c - the Mignonette Game Library API (miggl.h) for Linux
+ *
+ *	runs tri2s.c, unchanged, on the development machine: the display goes to the terminal
+ *	or to a PPM file per frame, the buttons come from a script or the keyboard, the
+ *	sound goes to a PCM file and the EEPROM (eeprom-host.c) to a file.
+ *
+ *	the sound is made by the real audio code (../miggl-audio.c): every tick runs its
+ *	do_audio_isr() while the game has the interrupt on, and the sample is what it wrote
+ *	to the timer 1 registers.  (this file defines them, see HOST_SHARED_REGS in avr/io.h.)
+ *
+ *	time is virtual, counted in ticks of the timer interrupt (50us): sleep_ms() and
+ *	swapbuffers() advance it instead of waiting, so a game runs as fast as the host can
+ *	compute it.  with -r the host waits for the wall clock to catch up, which gives
+ *	the speed of the Mignonette.  busy loops that poll the buttons cost one tick per
+ *	handlebuttons().
+ *
+ *	the game's main() is compiled as tri2s_main() (see Makefile), main() here takes the
+ *	options first:
+ *
+ *	usage: tri2s-host [-r] [-t] [-i] [-s script] [-f frames] [-p prefix] [-a file] [-e file] [-x seed]
+ *
+ *		-r			real time (default: as fast as possible)
+ *		-t			show the display in the terminal
+ *		-i			buttons from the keyboard: a, b, c, d (q quits)
+ *		-s script	buttons from a script, lines of "<frame> <buttons>", e.g. "30 C" holds C from
+ *					frame 30 on (a frame is 100ms), "31 -" lets go, "200 q" quits
+ *		-f frames	quit after that many frames
+ *		-p prefix	write every frame to prefix000000.ppm, prefix000001.ppm, ...
+ *		-a file		write the sound to file (8 bit unsigned, mono, 20000Hz: "aplay -f U8 -r 20000 file")
+ *		-e file		the EEPROM, read at the start and written at the end
+ *		-x seed		seed for nextrandom()
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <termios.h>
+#include <fcntl.h>
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+#include "mydefs.h"
+#include "miggl.h"
+#include "miggl-private.h"
+
+#define TICK_NS			50000UL		// one timer interrupt (20kHz), the sound is one sample per tick
+#define FRAME_TICKS		2000		// a frame of the script (100ms)
+#define KEY_FRAMES		2			// frames a key of the keyboard stays pressed
+
+int tri2s_main (void);
+
+/* globals for buttons */
+byte ButtonA;
+byte ButtonB;
+byte ButtonC;
+byte ButtonD;
+byte ButtonAEvent;
+byte ButtonBEvent;
+byte ButtonCEvent;
+byte ButtonDEvent;
+byte ButtonDrops;
+
+volatile uint8_t Disp[10];
+
+static uint8_t _CurColor;
+#ifdef PALETTE
+static uint8_t Palette[4] = { BLACK, RED, GREEN, YELLOW };
+#endif
+static uint8_t _buttonmask;
+static uint8_t SwapInterval = 1;
+
+static uint32_t RandomSeedA = 65537;
+static uint32_t RandomSeedB = 12345;
+
+// virtual time
+static uint64_t Ticks;				// ticks since the start
+static uint64_t FrameEnd;			// tick when the current display cycle ends
+static uint64_t Frames;				// display cycles shown (swapbuffers() calls)
+static struct timespec WallStart;
+
+// options
+static int RealTime;
+static int Terminal;
+static int Keyboard;
+static FILE* Script;
+static uint64_t MaxFrames;
+static const char* PpmPrefix;
+static FILE* Pcm;
+static const char* EepromFile;
+
+// buttons from the script or the keyboard
+static uint64_t ScriptNext;			// frame of the next script line ...
+static uint8_t ScriptMask;			// ... and its buttons
+static int ScriptQuit;				// ... or 1 if it quits
+static uint64_t KeyUntil[4];		// frame until which a key counts as pressed
+static struct termios SavedTerm;
+
+// the timer 1 registers of the audio code
+volatile uint8_t TCCR1A, TIMSK1;
+volatile uint16_t OCR1A;
+
+
+//
+// quits, after saving what has to be saved
+//
+static void quit (int status) {
+	double wall;
+	struct timespec ts;
+
+	if (Keyboard)
+		tcsetattr(0, TCSANOW, &SavedTerm);
+	if (EepromFile)
+		eeprom_save(EepromFile);
+	if (Pcm)
+		fclose(Pcm);
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	wall = (ts.tv_sec - WallStart.tv_sec) + (ts.tv_nsec - WallStart.tv_nsec) * 1e-9;
+	fprintf(stderr, "%" PRIu64 " frames, %.1f sec game time in %.3f sec (%.0fx)\n",
+		Frames, Ticks * (TICK_NS * 1e-9), wall, (wall > 0) ? Ticks * (TICK_NS * 1e-9) / wall : 0.0);
+	exit(status);
+}
+
+//
+// the sound of one tick: the audio interrupt, if it is on, and the duty cycle of the PWM it
+// leaves (0 while the compare output is off)
+//
+static void audio_tick (void) {
+	uint8_t sample = 0;
+
+	if (TIMSK1 & _BV(TOIE1))
+		do_audio_isr();
+	if (TCCR1A & _BV(COM1A1))
+		sample = OCR1A * 255 / AUDIO_TOP;
+	if (Pcm)
+		fputc(sample, Pcm);
+}
+
+//
+// the buttons pressed in the current frame
+//
+static void update_buttons (void) {
+	uint64_t frame = Ticks / FRAME_TICKS;
+	char line[64], keys[16];
+	unsigned long long n;
+	int i, c;
+
+	while (Script && (ScriptNext <= frame)) {
+		if (ScriptQuit)
+			quit(0);
+		_buttonmask = ScriptMask;
+		if (!fgets(line, sizeof(line), Script)) {
+			fclose(Script);
+			Script = NULL;
+			break;
+		}
+		if ((line[0] == '#') || (sscanf(line, "%llu %15s", &n, keys) != 2))
+			continue;
+		ScriptNext = n;
+		ScriptMask = 0;
+		ScriptQuit = (keys[0] == 'q');
+		for (i = 0; keys[i]; i++)
+			if ((keys[i] >= 'A') && (keys[i] <= 'D'))
+				ScriptMask |= 1 << (keys[i] - 'A');
+	}
+
+	if (Keyboard) {
+		while ((c = getchar()) != EOF) {
+			if (c == 'q')
+				quit(0);
+			if ((c >= 'a') && (c <= 'd'))
+				KeyUntil[c - 'a'] = frame + KEY_FRAMES;
+		}
+		clearerr(stdin);
+		_buttonmask = 0;
+		for (i = 0; i < 4; i++)
+			if (KeyUntil[i] > frame)
+				_buttonmask |= 1 << i;
+	}
+}
+
+//
+// advances the virtual time by n ticks
+//
+static void advance (uint32_t n) {
+	struct timespec ts;
+	uint64_t ns;
+
+	while (n--) {
+		audio_tick();
+		Ticks++;
+		if ((Ticks % (ROW_TICKS * 10)) == 0)	// the switches are polled once per display cycle
+			update_buttons();
+	}
+
+	if (RealTime) {
+		ns = Ticks * TICK_NS;
+		ts.tv_sec = WallStart.tv_sec + ns / 1000000000UL;
+		ts.tv_nsec = WallStart.tv_nsec + ns % 1000000000UL;
+		if (ts.tv_nsec >= 1000000000L) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000L;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+	}
+}
+
+//
+// shows the display
+//
+static void show_frame (void) {
+	static const uint8_t rgb[4][3] = { { 24, 24, 24 }, { 255, 0, 0 }, { 0, 255, 0 }, { 255, 200, 0 } };
+	static const char* ansi[4] = { "\033[40m", "\033[41m", "\033[42m", "\033[43m" };
+	char name[256];
+	FILE* f;
+	int x, y, i, j;
+#ifndef PALETTE
+	static const uint8_t Palette[4] = { BLACK, RED, GREEN, YELLOW };
+#endif
+
+	// held the way the game is played: lines from top to bottom, column 4 on the left
+	if (Terminal) {
+		printf("\033[H");
+		for (x = 0; x < XSCREEN; x++) {
+			for (y = YSCREEN - 1; y >= 0; y--)
+				printf("%s  ", ansi[Palette[readpixel(x, y)]]);
+			printf("\033[0m\n");
+		}
+		printf("frame %" PRIu64 "\n", Frames);
+		fflush(stdout);
+	}
+
+	if (PpmPrefix) {
+		snprintf(name, sizeof(name), "%s%06" PRIu64 ".ppm", PpmPrefix, Frames);
+		if (!(f = fopen(name, "wb"))) {
+			perror(name);
+			quit(2);
+		}
+		fprintf(f, "P6\n%d %d\n255\n", YSCREEN * 16, XSCREEN * 16);
+		for (x = 0; x < XSCREEN * 16; x++)
+			for (y = YSCREEN * 16 - 1; y >= 0; y--) {
+				i = Palette[readpixel(x / 16, y / 16)];
+				j = ((x % 16) == 0) || ((y % 16) == 0);		// grid lines
+				fputc(j ? 0 : rgb[i][0], f);
+				fputc(j ? 0 : rgb[i][1], f);
+				fputc(j ? 0 : rgb[i][2], f);
+			}
+		fclose(f);
+	}
+}
+
+
+/* graphics functions */
+
+//
+// waits until the display cycle has finished (the virtual time jumps there)
+//
+void swapbuffers(void)
+{
+	uint64_t frame = ROW_TICKS * 10 * SwapInterval;
+
+	if (Ticks < FrameEnd)
+		advance(FrameEnd - Ticks);
+	while (FrameEnd <= Ticks)
+		FrameEnd += frame;
+	show_frame();
+	Frames++;
+	if (MaxFrames && (Frames >= MaxFrames))
+		quit(0);
+}
+
+uint16_t frameticksleft(void)
+{
+	return (Ticks < FrameEnd) ? (uint16_t)(FrameEnd - Ticks) : 0;
+}
+
+void initswapbuffers(void)
+{
+	SwapInterval = 1;
+	FrameEnd = Ticks + ROW_TICKS * 10;
+}
+
+void swapinterval(uint8_t i)
+{
+	if (i != 0)
+		SwapInterval = i;
+}
+
+void cleardisplay(void)
+{
+	memset((void*)Disp, 0, sizeof(Disp));
+}
+
+void setcolor(uint8_t c)
+{
+	_CurColor = 0x3 & c;
+}
+
+void drawpoint(uint8_t x, uint8_t y)
+{
+	uint8_t bits;
+
+	if ((x < 7) && (y < 5)) {
+		bits = 0x40 >> x;
+		if (_CurColor & 0x1)
+			Disp[y+5] |= bits;
+		else
+			Disp[y+5] &= ~bits;
+		if (_CurColor & 0x2)
+			Disp[y] |= bits;
+		else
+			Disp[y] &= ~bits;
+	}
+}
+
+uint8_t readpixel(uint8_t x, uint8_t y)
+{
+	uint8_t bits, value = 0;
+
+	if ((x < 7) && (y < 5)) {
+		bits = 0x40 >> x;
+		if (Disp[y] & bits)
+			value |= GREEN;
+		if (Disp[y+5] & bits)
+			value |= RED;
+	}
+	return value;
+}
+
+#ifdef PALETTE
+void setpalette(uint8_t index, uint8_t color)
+{
+	Palette[index & 0x3] = color & 0x3;
+}
+
+uint8_t getpalette(uint8_t index)
+{
+	return Palette[index & 0x3];
+}
+
+void resetpalette(void)
+{
+	uint8_t i;
+
+	for (i = 0; i < 4; i++)
+		setpalette(i, i);
+}
+#endif
+
+void drawfilledrect(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2)
+{
+	uint8_t x, y, tmp;
+
+	if ((x1 < 7) && (y1 < 5) && (x2 < 7) && (y2 < 5)) {
+		if (x1 > x2) {
+			tmp = x1;
+			x1 = x2;
+			x2 = tmp;
+		}
+		if (y1 > y2) {
+			tmp = y1;
+			y1 = y2;
+			y2 = tmp;
+		}
+		for (y = y1; y <= y2; y++)
+			for (x = x1; x <= x2; x++)
+				drawpoint(x, y);
+	}
+}
+
+
+/* button functions */
+
+void button_init(void)
+{
+	ButtonA = ButtonB = ButtonC = ButtonD = 0;
+	ButtonAEvent = ButtonBEvent = ButtonCEvent = ButtonDEvent = 0;
+}
+
+void poll_buttons(void)
+{
+}
+
+//
+// same as handlebuttons() in miggl.c.  each call takes one tick, so loops waiting
+// for a button let the time go on.
+//
+void handlebuttons(void)
+{
+	advance(1);
+
+	if (!ButtonA && (_buttonmask & 0x1)) {
+		ButtonA = 1;
+		ButtonAEvent = 1;
+	} else if (!ButtonB && (_buttonmask & 0x2)) {
+		ButtonB = 1;
+		ButtonBEvent = 1;
+	} else if (!ButtonC && (_buttonmask & 0x4)) {
+		ButtonC = 1;
+		ButtonCEvent = 1;
+	} else if (!ButtonD && (_buttonmask & 0x8)) {
+		ButtonD = 1;
+		ButtonDEvent = 1;
+	} else {
+		ButtonA = (_buttonmask & 0x1) ? 1 : 0;
+		ButtonB = (_buttonmask & 0x2) ? 1 : 0;
+		ButtonC = (_buttonmask & 0x4) ? 1 : 0;
+		ButtonD = (_buttonmask & 0x8) ? 1 : 0;
+	}
+}
+
+
+/* audio functions */
+
+//
+// the audio code is in ../miggl-audio.c, this waits without spinning as the device does
+//
+void waitaudio(void)
+{
+	while (isaudioplaying())
+		advance(1);
+}
+
+
+
+/* the rest */
+
+void avrinit(void)
+{
+}
+
+void start_timer1(void)
+{
+}
+
+void sleep_us (byte usec)
+{
+	advance(((uint32_t)usec * 1000 + TICK_NS - 1) / TICK_NS);
+}
+
+void sleep_ms (uint8_t ms)
+{
+	advance((uint32_t)ms * 1000000UL / TICK_NS);
+}
+
+void sleep_sec (uint8_t sec)
+{
+	advance((uint32_t)sec * 1000000000UL / TICK_NS);
+}
+
+uint32_t nextrandom (uint32_t max) {
+	RandomSeedA = 36969 * (RandomSeedA & 65535) + (RandomSeedA >> 16);
+	RandomSeedB = 18000 * (RandomSeedB & 65535) + (RandomSeedB >> 16);
+ 	return ((RandomSeedA << 16) + RandomSeedB) % max;
+}
+
+void initmiggl (void) {
+	initswapbuffers();
+	swapinterval(10);
+	cleardisplay();
+	button_init();
+	initaudio();
+}
+
+
+int main (int argc, char** argv) {
+	struct termios t;
+	int c;
+
+	while ((c = getopt(argc, argv, "rtis:f:p:a:e:x:")) != -1) {
+		switch (c) {
+			case 'r': RealTime = 1; break;
+			case 't': Terminal = 1; break;
+			case 'i': Keyboard = 1; break;
+			case 's':
+				if (!(Script = fopen(optarg, "r"))) {
+					perror(optarg);
+					return 2;
+				}
+				break;
+			case 'f': MaxFrames = strtoull(optarg, NULL, 0); break;
+			case 'p': PpmPrefix = optarg; break;
+			case 'a':
+				if (!(Pcm = fopen(optarg, "wb"))) {
+					perror(optarg);
+					return 2;
+				}
+				break;
+			case 'e':
+				EepromFile = optarg;
+				eeprom_load(optarg);
+				break;
+			case 'x': RandomSeedB = strtoul(optarg, NULL, 0); break;
+			default:
+				fprintf(stderr, "usage: %s [-r] [-t] [-i] [-s script] [-f frames] [-p prefix] [-a file] [-e file] [-x seed]\n", argv[0]);
+				return 2;
+		}
+	}
+
+	if (Keyboard) {
+		tcgetattr(0, &SavedTerm);
+		t = SavedTerm;
+		t.c_lflag &= ~(ICANON | ECHO);
+		tcsetattr(0, TCSANOW, &t);
+		fcntl(0, F_SETFL, fcntl(0, F_GETFL) | O_NONBLOCK);
+	}
+	if (Terminal)
+		printf("\033[2J");
+	clock_gettime(CLOCK_MONOTONIC, &WallStart);
+	update_buttons();
+
+	tri2s_main();
+	quit(0);
+	return 0;
+}
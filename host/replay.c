@@ -0,0 +1,157 @@
+/*
+ *	replay.c - plays back a recorded tri2s game on the host
+ *
+ *	reads a recording (see tri2s-replay.h), e.g. the EEPROM of the Mignonette read with
+ *	"make read-replay" or a game recorded with "autoplay -o", and runs it through the
+ *	game core.  if the recording ends with the game over, the final game state is
+ *	checked against the one the device had.  a recording that stops before the game
+ *	over fails (exit 1) like one that differs, as then nothing was checked.
+ *
+ *	with -b the game is played back that many times to measure the speed of the core
+ *	on exactly the same game every time.
+ *
+ *	usage: replay [-b times] [-v] file
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "tri2s-core.h"
+#include "tri2s-replay.h"
+
+static double now (void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//
+// returns what the decoder says about the next step (see replay_decode()), feeding it
+// the bytes of the recording r of len bytes from *pos on
+//
+static uint8_t next (struct replay_coder* c, const uint8_t* r, int len, int* pos, uint8_t* input) {
+	uint8_t k;
+
+	while ((k = replay_decode(c, input)) == REPLAY_MORE) {
+		if (*pos >= len)
+			return REPLAY_CUT;
+		replay_feed(c, r[(*pos)++]);
+	}
+	return k;
+}
+
+//
+// plays back the recording r of len bytes into s.  returns the position of the
+// checksum if the recording ends with the game over, else -1.
+//
+static int play (const uint8_t* r, int len, struct tri2s_state* s, unsigned long* steps) {
+	struct replay_coder c;
+	uint32_t seed = r[2] | (r[3] << 8) | (r[4] << 16) | ((uint32_t)r[5] << 24);
+	int pos = REPLAY_HEADER;
+	uint8_t events = 0, input;
+
+	*steps = 0;
+	tri2s_init(s, seed);
+	replay_decode_begin(&c);
+	while (!(events & EV_GAMEOVER)) {
+		if (events & EV_LAND)
+			replay_land(&c);
+		if (next(&c, r, len, &pos, &input) != REPLAY_STEP)
+			return -1;
+		events = tri2s_step(s, input);
+		(*steps)++;
+	}
+	replay_land(&c);				// the game ended with a stone landing
+	return (next(&c, r, len, &pos, &input) == REPLAY_GAMEOVER) ? pos : -1;
+}
+
+//
+// prints the field, line by line (the way the device shows it turned by 90 degrees)
+//
+static void print_field (const struct tri2s_state* s) {
+	int x, y;
+	for (x = 1; x <= FIELD_LINES; x++) {
+		for (y = FIELD_WIDTH - 1; y >= 0; y--)
+			putchar((s->field[y] & FIELD_BIT(x - 1)) ? '#' : '.');
+		putchar('\n');
+	}
+}
+
+int main (int argc, char** argv) {
+	uint8_t r[REPLAY_SIZE];
+	struct tri2s_state s;
+	unsigned long repeats = 0, steps = 0, i;
+	int c, len, end, verbose = 0;
+	FILE* f;
+	double t;
+
+	while ((c = getopt(argc, argv, "b:v")) != -1) {
+		switch (c) {
+			case 'b': repeats = strtoul(optarg, NULL, 0); break;
+			case 'v': verbose = 1; break;
+			default:
+				fprintf(stderr, "usage: %s [-b times] [-v] file\n", argv[0]);
+				return 2;
+		}
+	}
+	if (optind + 1 != argc) {
+		fprintf(stderr, "usage: %s [-b times] [-v] file\n", argv[0]);
+		return 2;
+	}
+
+	if (!(f = fopen(argv[optind], "rb"))) {
+		perror(argv[optind]);
+		return 2;
+	}
+	len = fread(r, 1, sizeof(r), f);
+	fclose(f);
+	if ((len < REPLAY_HEADER) || (r[0] != 'T') || (r[1] != REPLAY_FORMAT)) {
+		fprintf(stderr, "%s: no recording%s\n", argv[optind],
+			((len >= 2) && (r[0] == 'T') && (r[1] == '2')) ? " (of the old format, T2)" : "");
+		return 2;
+	}
+	if ((r[6] != FIELD_LINES) || (r[7] != FIELD_WIDTH)) {
+		fprintf(stderr, "%s: recorded with a %u x %u field, this is built for %u x %u (FIELD_LINES, FIELD_WIDTH)\n",
+			argv[optind], r[6], r[7], FIELD_LINES, FIELD_WIDTH);
+		return 2;
+	}
+
+	end = play(r, len, &s, &steps);
+	printf("seed %" PRIu32 ", %d bytes, %lu steps, level %u, %s\n",
+		(uint32_t)(r[2] | (r[3] << 8) | (r[4] << 16) | ((uint32_t)r[5] << 24)), len, steps, s.levelcount,
+		s.over ? "game over" : "still running");
+	if (verbose)
+		print_field(&s);
+
+	if (repeats) {
+		unsigned long n;
+		t = now();
+		for (i = 0; i < repeats; i++)
+			play(r, len, &s, &n);
+		t = now() - t;
+		printf("%lu replays, %.0f steps/sec\n", repeats, repeats * steps / t);
+	}
+
+	// compare with the end of the recorded game.  without the game over in the recording
+	// there is nothing to compare, which fails as well: the replay was not checked.
+	if ((end < 0) || (end + 2 > len)) {
+		printf("recording ends before the game, the replay was not checked\n");
+		return 1;
+	} else {
+		uint16_t sum = r[end] | (r[end + 1] << 8);
+		if (!s.over || (sum != replay_checksum(&s))) {
+			printf("replay differs from the recorded game (checksum %04x, recorded %04x)\n",
+				replay_checksum(&s), sum);
+			return 1;
+		}
+		printf("replay matches the recorded game (checksum %04x)\n", sum);
+	}
+	return 0;
+}
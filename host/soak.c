@@ -0,0 +1,154 @@
+/*
+ *	soak.c - runs tri2s games headless on the host
+ *
+ *	lets the computer player (tri2s-ai.c) play games through the game core (tri2s-core.c)
+ *	as fast as possible and checks the game state after every step.  useful to find
+ *	overflows (solvedlines and levelcount are uint8_t) and to measure the speed of the core.
+ *
+ *	random input (-r) hardly ever solves a line, so it only tests the start of a game.
+ *	the player solves hundreds of lines per game, and with -l 1 every line is a level, so
+ *	levelcount wraps in the longer games.  without -r, soak fails if no game got to the
+ *	next level, as then the overflows were not tested.
+ *
+ *	the lines the game counts (totallines) are checked against the lines of the EV_LINES
+ *	events after every step.  as a level-up drops the lines a clear solves beyond it, soak
+ *	also fails without -r if no level-up came with a clear of several lines.
+ *
+ *	usage: soak [-n games] [-s seed] [-m maxsteps] [-l levellines] [-r] [-q]
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "tri2s-core.h"
+#include "tri2s-ai.h"
+
+static double now (void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//
+// random input, a button is pressed in about every 3rd frame
+//
+static uint8_t random_input (uint32_t* r) {
+	*r ^= *r << 13;
+	*r ^= *r >> 17;
+	*r ^= *r << 5;
+	switch (*r % 9) {
+		case 0: return IN_ROTATE;
+		case 1: return IN_LEFT;
+		case 2: return IN_RIGHT;
+	}
+	return 0;
+}
+
+//
+// checks what has to hold after every step, returns 0 if something is wrong
+//
+static int check_state (const struct tri2s_state* s) {
+	if (s->solvedlines >= s->difficulty->levellines + 3)
+		return 0;
+	if (s->falltimemax < 0 || s->falltimemax > FALLTIME_START)
+		return 0;
+	if (!s->over && !stone_in_bounds(s->stone, s->stonex, s->stoney))
+		return 0;
+	return 1;
+}
+
+int main (int argc, char** argv) {
+	unsigned long games = 1000, maxsteps = 10000000, game;
+	uint32_t seed = 1;
+	int c, quiet = 0, randomly = 0;
+	struct tri2s_difficulty d = Tri2sDifficulty;
+	uint64_t steps = 0, lines = 0, levels = 0, longest = 0, maxlevels = 0, multilevels = 0;
+	unsigned long wrapped = 0, broken = 0;
+	double t;
+
+	while ((c = getopt(argc, argv, "n:s:m:l:rq")) != -1) {
+		switch (c) {
+			case 'n': games = strtoul(optarg, NULL, 0); break;
+			case 's': seed = strtoul(optarg, NULL, 0); break;
+			case 'm': maxsteps = strtoul(optarg, NULL, 0); break;
+			case 'l': d.levellines = strtoul(optarg, NULL, 0); break;
+			case 'r': randomly = 1; break;
+			case 'q': quiet = 1; break;
+			default:
+				fprintf(stderr, "usage: %s [-n games] [-s seed] [-m maxsteps] [-l levellines] [-r] [-q]\n", argv[0]);
+				return 2;
+		}
+	}
+	if (d.levellines < 1) {
+		fprintf(stderr, "-l needs at least 1 line per level\n");
+		return 2;
+	}
+
+	t = now();
+	for (game = 0; game < games; game++) {
+		struct tri2s_state s;
+		struct ai_player p = { { 0, 0, 0, 0 }, 0 };
+		uint32_t r = (seed + game) * 2654435761UL | 1;
+		uint64_t n = 0, gamelevels = 0;
+		uint16_t gamelines = 0;
+		uint8_t events = 0, clearing = 0;
+
+		tri2s_init_difficulty(&s, seed + game, &d);
+		while (!(events & EV_GAMEOVER) && n < maxsteps) {
+			events = tri2s_step(&s, randomly ? random_input(&r) : ai_play(&p, &s, events));
+			n++;
+			if (events & EV_LEVELUP) {
+				gamelevels++;
+				if (s.levelcount == 0)
+					wrapped++;
+				if (clearing > 1)
+					multilevels++;
+			}
+			if (events & EV_CLEARED)
+				clearing = 0;
+			if (events & EV_LINES) {
+				clearing = __builtin_popcountll(s.lines);
+				lines += clearing;
+				gamelines += clearing;
+			}
+			// the lines of the last EV_LINES are counted when they are removed
+			if (!check_state(&s) || (s.totallines != (uint16_t)(gamelines - clearing))) {
+				broken++;
+				if (!quiet)
+					printf("game %lu (seed %lu): bad state after %" PRIu64 " steps\n",
+						game, (unsigned long)(seed + game), n);
+				break;
+			}
+		}
+		steps += n;
+		levels += gamelevels;
+		if (n > longest)
+			longest = n;
+		if (gamelevels > maxlevels)
+			maxlevels = gamelevels;
+	}
+	t = now() - t;
+
+	printf("games %lu, steps %" PRIu64 ", %.0f steps/sec, %.0f games/sec\n",
+		games, steps, steps / t, games / t);
+	printf("longest game %" PRIu64 " steps, most levels %" PRIu64 ", %" PRIu64 " lines, %" PRIu64 " levels\n",
+		longest, maxlevels, lines, levels);
+	printf("levelcount wrapped %lu times, %" PRIu64 " level-ups with several lines, bad states %lu\n",
+		wrapped, multilevels, broken);
+	if (!randomly && !levels) {
+		printf("no game got to the next level, the overflows were not tested\n");
+		return 1;
+	}
+	if (!randomly && !multilevels) {
+		printf("no level-up came with several lines, the line count was not tested\n");
+		return 1;
+	}
+	return broken ? 1 : 0;
+}
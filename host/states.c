@@ -0,0 +1,572 @@
+/*
+ *	states.c - finds every field a game of tri2s can get to, and which of them are lost
+ *
+ *	a state is the field between two stones: the stacked stones with the complete lines
+ *	removed, the hidden line included (a stone may stick into it without ending the game).
+ *	starting with the empty field, every state is followed with each of the 6 stones to
+ *	every place the stone can land in (by the rules of tri2s-core.c: moves, rotations and
+ *	falls as in tri2s_step(), game over when it lands in the hidden line), breadth first,
+ *	until no new states turn up.
+ *
+ *	then it finds out which states are lost for sure if the stones come in the worst order
+ *	(the player chooses the places, the stones are chosen against the player): a state is lost in
+ *	1 if there is a stone that can only land in a way that ends the game, lost in n if there
+ *	is a stone whose places all lead to states lost in n - 1 or less.  the rest survive any
+ *	sequence of stones.
+ *
+ *	the states are kept in a set of SHARDS hash tables, each with its own lock; a state is
+ *	a number of (FIELD_LINES + 1) * FIELD_WIDTH bits, mixed up (reversibly) so that the
+ *	first SHARD_BITS bits choose the table and only the others are stored, 4 bytes per
+ *	state.  for the second part the tables are sorted, the position in them is the number
+ *	of a state, and what is still not lost is a bitset.  the work (a depth of the search,
+ *	a round of the second part) is split into chunks that the threads take in turn.
+ *
+ *	by default the player can move as often as it likes before the stone falls a line;
+ *	with -t the moves are those of the game at that falltime (tri2s-core.h), one per frame.
+ *
+ *	usage: states [-j threads] [-t falltime] [-d depth] [-n] [-q]
+ *
+ *		-d depth	stop the search after that many stones (and skip the second part)
+ *		-n			no second part
+ *		-q			print only the benchmark (states per second, memory)
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/resource.h>
+
+#include "tri2s-core.h"
+
+#define COLUMN_BITS		(FIELD_LINES + 1)
+#define KEY_BITS		(COLUMN_BITS * FIELD_WIDTH)
+#if KEY_BITS > 40
+#error "states needs a field of at most 40 cells (hidden line included)"
+#endif
+#define KEY_MASK		(((uint64_t)1 << KEY_BITS) - 1)
+#define SHARD_BITS		8
+#define SHARDS			(1 << SHARD_BITS)
+#define VALUE_BITS		(KEY_BITS - SHARD_BITS)
+#define VALUE_MASK		(((uint64_t)1 << VALUE_BITS) - 1)
+#define MIX_MUL			0x9E3779B97F4A7C15ULL
+#define MIX_SHIFT		((KEY_BITS + 1) / 2)
+
+#define MAX_THREADS		256
+#define MAX_LANDINGS	(FIELD_WIDTH * 4 * COLUMN_BITS)
+#define CHUNK			1024		// states per piece of work
+#define STONES			6
+
+/* a hash table of the set */
+struct shard {
+	pthread_mutex_t lock;
+	uint32_t* slots;		// the stored values, 0 is a free slot ...
+	uint32_t size;			// (a power of 2)
+	uint32_t count;
+	uint8_t zero;			// ... so value 0 is kept here
+	uint32_t* sorted;		// after the search: the values in order
+	uint64_t base;			// number of the first of them
+};
+
+/* the states found at one depth (by a thread, a cache line each) */
+struct list {
+	uint64_t* keys;
+	uint64_t n, size;
+	uint64_t followed;		// states and stones followed by the thread
+} __attribute__((aligned(64)));
+
+static struct shard Shards[SHARDS];
+static uint64_t MixInverse;
+static int Threads;
+static int MovesPerLine;				// 0 for as many as it takes
+static uint8_t Stones[STONES];
+
+// the work shared by the threads
+static void (*Job)(int thread, uint64_t first, uint64_t end);
+static uint64_t JobSize;
+static uint64_t JobNext;				// next chunk (atomic)
+
+// the search
+static struct list Frontier;			// the states of the current depth
+static struct list Found[MAX_THREADS];	// the new ones of the next, per thread
+
+// the second part
+static uint64_t States;
+static uint64_t* Alive;					// states not lost yet
+static uint64_t* Dying;					// states lost in this round
+
+static double now (void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void* xrealloc (void* p, size_t size) {
+	if (!(p = realloc(p, size))) {
+		fprintf(stderr, "out of memory\n");
+		exit(2);
+	}
+	return p;
+}
+
+
+/* states */
+
+static uint64_t pack (const field_t* field) {
+	uint64_t key = 0;
+	uint8_t i;
+	for (i = 0; i < FIELD_WIDTH; i++)
+		key |= (uint64_t)field[i] << (i * COLUMN_BITS);
+	return key;
+}
+
+static void unpack (uint64_t key, field_t* field) {
+	uint8_t i;
+	for (i = 0; i < FIELD_WIDTH; i++)
+		field[i] = (key >> (i * COLUMN_BITS)) & (((uint64_t)1 << COLUMN_BITS) - 1);
+}
+
+//
+// mixes the bits of a key (reversibly, see unmix()), so that all of them
+// count for the shard and the slot
+//
+static uint64_t mix (uint64_t k) {
+	k = (k * MIX_MUL) & KEY_MASK;
+	k ^= k >> MIX_SHIFT;
+	return (k * MIX_MUL) & KEY_MASK;
+}
+
+static uint64_t unmix (uint64_t k) {
+	k = (k * MixInverse) & KEY_MASK;
+	k ^= k >> MIX_SHIFT;
+	return (k * MixInverse) & KEY_MASK;
+}
+
+
+/* the set */
+
+//
+// adds a state to the set, returns 1 if it is new
+//
+static int set_add (uint64_t key) {
+	uint64_t m = mix(key);
+	struct shard* s = &Shards[m >> VALUE_BITS];
+	uint32_t v = m & VALUE_MASK, i, j;
+	int added = 0;
+
+	pthread_mutex_lock(&s->lock);
+	if (v == 0) {
+		added = !s->zero;
+		s->zero = 1;
+	} else {
+		// keep it at most 3/4 full
+		if ((s->count + 1) * 4 > s->size * 3) {
+			uint32_t* old = s->slots, n = s->size;
+			s->size = n ? 2 * n : 1024;
+			s->slots = calloc(s->size, sizeof(uint32_t));
+			if (!s->slots) {
+				fprintf(stderr, "out of memory\n");
+				exit(2);
+			}
+			for (i = 0; i < n; i++)
+				if (old[i]) {
+					for (j = old[i] & (s->size - 1); s->slots[j]; j = (j + 1) & (s->size - 1))
+						;
+					s->slots[j] = old[i];
+				}
+			free(old);
+		}
+		for (i = v & (s->size - 1); s->slots[i]; i = (i + 1) & (s->size - 1))
+			if (s->slots[i] == v)
+				break;
+		if (!s->slots[i]) {
+			s->slots[i] = v;
+			s->count++;
+			added = 1;
+		}
+	}
+	pthread_mutex_unlock(&s->lock);
+	return added;
+}
+
+static int compare_u32 (const void* a, const void* b) {
+	uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+	return (x > y) - (x < y);
+}
+
+//
+// turns the hash tables into sorted lists, which number the states.  returns their number.
+//
+static uint64_t set_sort (void) {
+	uint64_t base = 0;
+	uint32_t i, n;
+	int k;
+
+	for (k = 0; k < SHARDS; k++) {
+		struct shard* s = &Shards[k];
+		s->sorted = xrealloc(NULL, (s->count + 1) * sizeof(uint32_t));
+		n = 0;
+		if (s->zero)
+			s->sorted[n++] = 0;
+		for (i = 0; i < s->size; i++)
+			if (s->slots[i])
+				s->sorted[n++] = s->slots[i];
+		free(s->slots);
+		s->slots = NULL;
+		qsort(s->sorted, n, sizeof(uint32_t), compare_u32);
+		s->count = n;
+		s->base = base;
+		base += n;
+	}
+	return base;
+}
+
+//
+// returns the number of a state, or -1 if it is not in the set
+//
+static int64_t set_index (uint64_t key) {
+	uint64_t m = mix(key);
+	const struct shard* s = &Shards[m >> VALUE_BITS];
+	uint32_t v = m & VALUE_MASK, lo = 0, hi = s->count;
+
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		if (s->sorted[mid] < v)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return ((lo < s->count) && (s->sorted[lo] == v)) ? (int64_t)(s->base + lo) : -1;
+}
+
+//
+// returns the state of a number
+//
+static uint64_t set_key (uint64_t index) {
+	int lo = 0, hi = SHARDS - 1;
+
+	while (lo < hi) {			// the last shard that starts at or before index
+		int mid = (lo + hi + 1) / 2;
+		if (Shards[mid].base <= index)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	return unmix(((uint64_t)lo << VALUE_BITS) | Shards[lo].sorted[index - Shards[lo].base]);
+}
+
+static uint64_t set_bytes (void) {
+	uint64_t bytes = 0;
+	int k;
+	for (k = 0; k < SHARDS; k++)
+		bytes += (Shards[k].slots ? Shards[k].size : Shards[k].count) * sizeof(uint32_t);
+	return bytes;
+}
+
+
+/* the game */
+
+//
+// finds every place a stone coming in at the spawn can land in, like ai_search_step()
+// does, but with MovesPerLine moves in every line if it is set.  the fields after the
+// landing (with the complete lines removed) go to out, each once; returns their number.
+// lost is set to 1 if the stone can land so that the game ends.
+//
+static int landings (const field_t* field, uint8_t stone, uint64_t* out, int* lost) {
+	uint8_t rot[4], cur[FIELD_WIDTH], next[FIELD_WIDTH];
+	uint8_t n, r, rr, i, moves, falling;
+	int8_t x = SPAWN_X;
+	field_t f[FIELD_WIDTH];
+	uint64_t key;
+	int count = 0, k;
+
+	*lost = 0;
+	rot[0] = stone;
+	for (n = 1; n < 4; n++) {
+		rot[n] = rotate_stone(rot[n - 1]);
+		if (rot[n] == stone)
+			break;
+	}
+	memset(cur, 0, sizeof(cur));
+	cur[SPAWN_Y] = 0x01;
+
+	do {
+		// the moves of this line, one at a time (everything reached so far moves at once)
+		for (moves = 0; !MovesPerLine || (moves < MovesPerLine); moves++) {
+			uint8_t changed = 0;
+			memcpy(next, cur, sizeof(next));
+			for (i = 0; i < FIELD_WIDTH; i++)
+				for (r = 0; r < n; r++) {
+					if (!(cur[i] & (1 << r)))
+						continue;
+					rr = (r + 1 == n) ? 0 : (r + 1);
+					if (!(next[i] & (1 << rr)) && stone_fits(field, rot[rr], x, i)) {
+						next[i] |= 1 << rr;
+						changed = 1;
+					}
+					if ((i + 1 < FIELD_WIDTH) && !(next[i + 1] & (1 << r)) && stone_fits(field, rot[r], x, i + 1)) {
+						next[i + 1] |= 1 << r;
+						changed = 1;
+					}
+					if ((i > 0) && !(next[i - 1] & (1 << r)) && stone_fits(field, rot[r], x, i - 1)) {
+						next[i - 1] |= 1 << r;
+						changed = 1;
+					}
+				}
+			memcpy(cur, next, sizeof(cur));
+			if (!changed)
+				break;
+		}
+
+		// fall or land
+		falling = 0;
+		for (i = 0; i < FIELD_WIDTH; i++) {
+			next[i] = 0;
+			for (r = 0; r < n; r++) {
+				if (!(cur[i] & (1 << r)))
+					continue;
+				if (stone_fits(field, rot[r], x + 1, i)) {
+					next[i] |= 1 << r;
+					falling = 1;
+				} else if (x <= 0) {
+					*lost = 1;					// game over
+				} else {
+					memcpy(f, field, sizeof(f));
+					field_place_stone(f, rot[r], x, i);
+					field_remove_lines(f, field_complete_lines(f));
+					key = pack(f);
+					for (k = 0; (k < count) && (out[k] != key); k++)
+						;
+					if (k == count)
+						out[count++] = key;
+				}
+			}
+		}
+		memcpy(cur, next, sizeof(cur));
+		x++;
+	} while (falling && (x <= FIELD_LINES));
+	return count;
+}
+
+
+/* threads */
+
+static void* worker_main (void* arg) {
+	int id = (int)(intptr_t)arg;
+	uint64_t chunk;
+
+	while ((chunk = __atomic_fetch_add(&JobNext, 1, __ATOMIC_RELAXED)) * CHUNK < JobSize) {
+		uint64_t end = (chunk + 1) * CHUNK;
+		Job(id, chunk * CHUNK, (end < JobSize) ? end : JobSize);
+	}
+	return NULL;
+}
+
+//
+// runs job for [0, size) in all threads, chunk by chunk
+//
+static void run (void (*job)(int, uint64_t, uint64_t), uint64_t size) {
+	pthread_t threads[MAX_THREADS];
+	int i;
+
+	Job = job;
+	JobSize = size;
+	JobNext = 0;
+	for (i = 1; i < Threads; i++)
+		if (pthread_create(&threads[i], NULL, worker_main, (void*)(intptr_t)i)) {
+			perror("pthread_create");
+			exit(2);
+		}
+	worker_main((void*)0);
+	for (i = 1; i < Threads; i++)
+		pthread_join(threads[i], NULL);
+}
+
+
+/* the search */
+
+static void list_add (struct list* l, uint64_t key) {
+	if (l->n == l->size) {
+		l->size = l->size ? 2 * l->size : 4096;
+		l->keys = xrealloc(l->keys, l->size * sizeof(uint64_t));
+	}
+	l->keys[l->n++] = key;
+}
+
+//
+// follows the states [first, end) of the frontier with every stone
+//
+static void search_job (int thread, uint64_t first, uint64_t end) {
+	uint64_t out[MAX_LANDINGS], g;
+	field_t field[FIELD_WIDTH];
+	int s, n, k, lost;
+
+	for (g = first; g < end; g++) {
+		unpack(Frontier.keys[g], field);
+		for (s = 0; s < STONES; s++) {
+			n = landings(field, Stones[s], out, &lost);
+			for (k = 0; k < n; k++)
+				if (set_add(out[k]))
+					list_add(&Found[thread], out[k]);
+		}
+	}
+	Found[thread].followed += (end - first) * STONES;
+}
+
+
+/* the second part */
+
+//
+// marks the states of [first, end) that are lost in this round: there is a stone that
+// only lands in ways that end the game or lead to states that are lost already.
+// (first is a multiple of 64, so the threads write different words)
+//
+static void lose_job (int thread, uint64_t first, uint64_t end) {
+	uint64_t out[MAX_LANDINGS], g, stones = 0;
+	field_t field[FIELD_WIDTH];
+	int s, n, k, lost;
+
+	for (g = first; g < end; g++) {
+		if (!(Alive[g / 64] & ((uint64_t)1 << (g % 64))))
+			continue;
+		unpack(set_key(g), field);
+		for (s = 0; s < STONES; s++) {
+			n = landings(field, Stones[s], out, &lost);
+			for (k = 0; k < n; k++) {
+				int64_t i = set_index(out[k]);
+				if ((i >= 0) && (Alive[i / 64] & ((uint64_t)1 << (i % 64))))
+					break;				// a way to go on
+			}
+			if (k == n)
+				break;					// this stone ends it
+		}
+		if (s < STONES)
+			Dying[g / 64] |= (uint64_t)1 << (g % 64);
+		stones += (s < STONES) ? s + 1 : s;
+	}
+	Found[thread].followed += stones;
+}
+
+static uint64_t followed (void) {
+	uint64_t n = 0;
+	int i;
+	for (i = 0; i < Threads; i++)
+		n += Found[i].followed;
+	return n;
+}
+
+static double peak_mb (void) {
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_maxrss / 1024.0;			// kB on Linux
+}
+
+int main (int argc, char** argv) {
+	int c, i, k, depth = 0, maxdepth = -1, second = 1, quiet = 0;
+	uint64_t states = 1, round, words, lost, w, start;
+	double t, tsearch, tlose = 0;
+	uint64_t searchfollowed, found;
+
+	Threads = sysconf(_SC_NPROCESSORS_ONLN);
+	while ((c = getopt(argc, argv, "j:t:d:nq")) != -1) {
+		switch (c) {
+			case 'j': Threads = atoi(optarg); break;
+			case 't': MovesPerLine = atoi(optarg); if (MovesPerLine < 1) MovesPerLine = 1; break;
+			case 'd': maxdepth = atoi(optarg); second = 0; break;
+			case 'n': second = 0; break;
+			case 'q': quiet = 1; break;
+			default:
+				fprintf(stderr, "usage: %s [-j threads] [-t falltime] [-d depth] [-n] [-q]\n", argv[0]);
+				return 2;
+		}
+	}
+	if ((Threads < 1) || (Threads > MAX_THREADS)) {
+		fprintf(stderr, "-j needs 1 to %d threads\n", MAX_THREADS);
+		return 2;
+	}
+
+	// the inverse of MIX_MUL (Newton's method, modulo 2^64 and so 2^KEY_BITS too)
+	MixInverse = MIX_MUL;
+	for (i = 0; i < 5; i++)
+		MixInverse *= 2 - MIX_MUL * MixInverse;
+	for (k = 0; k < SHARDS; k++)
+		pthread_mutex_init(&Shards[k].lock, NULL);
+	for (i = 0; i < 4; i++)
+		Stones[i] = CornerStones[i];
+	for (i = 0; i < 2; i++)
+		Stones[4 + i] = StraightStones[i];
+
+	// breadth first, from the empty field
+	t = now();
+	set_add(0);
+	list_add(&Frontier, 0);
+	while (Frontier.n && (depth != maxdepth)) {
+		run(search_job, Frontier.n);
+		Frontier.n = 0;
+		for (i = 0; i < Threads; i++) {
+			for (w = 0; w < Found[i].n; w++)
+				list_add(&Frontier, Found[i].keys[w]);
+			Found[i].n = 0;
+		}
+		depth++;
+		states += Frontier.n;
+		if (!quiet && Frontier.n)
+			printf("stones %d: %" PRIu64 " new states, %" PRIu64 " in all\n", depth, Frontier.n, states);
+	}
+	tsearch = now() - t;
+	searchfollowed = followed();
+	found = states;
+	if (!quiet)
+		printf("%" PRIu64 " states%s in %.2f sec, the set takes %.1f MB (%.1f bytes per state)\n",
+			states, Frontier.n ? " so far" : "", tsearch, set_bytes() / 1048576.0, (double)set_bytes() / states);
+
+	if (second) {
+		t = now();
+		States = set_sort();
+		words = (States + 63) / 64;
+		Alive = xrealloc(NULL, words * sizeof(uint64_t));
+		Dying = xrealloc(NULL, words * sizeof(uint64_t));
+		memset(Alive, 0xFF, words * sizeof(uint64_t));
+		if (States % 64)
+			Alive[words - 1] = ((uint64_t)1 << (States % 64)) - 1;
+		start = set_index(0);
+
+		for (round = 1; ; round++) {
+			memset(Dying, 0, words * sizeof(uint64_t));
+			run(lose_job, States);
+			for (lost = 0, w = 0; w < words; w++) {
+				lost += __builtin_popcountll(Dying[w]);
+				Alive[w] &= ~Dying[w];
+			}
+			if (!lost)
+				break;
+			states -= lost;
+			if (!quiet)
+				printf("lost in %" PRIu64 " stone%s: %" PRIu64 " states%s\n", round, (round == 1) ? "" : "s",
+					lost, (Dying[start / 64] & ((uint64_t)1 << (start % 64))) ? " (the empty field among them)" : "");
+		}
+		tlose = now() - t;
+		if (!quiet) {
+			printf("%" PRIu64 " states (%.1f%%) survive any sequence of stones, %.2f sec\n",
+				states, 100.0 * states / States, tlose);
+			if (Alive[start / 64] & ((uint64_t)1 << (start % 64)))
+				printf("the game can go on for ever, whatever stones come\n");
+			else
+				printf("the worst sequence of stones ends any game within %" PRIu64 " stones\n", round - 1);
+		}
+	}
+
+	printf("threads %d: %.0f states/sec (%.0f stones followed/sec) in the search", Threads,
+		found / tsearch, searchfollowed / tsearch);
+	if (second)
+		printf(", %.0f stones followed/sec after it", (followed() - searchfollowed) / tlose);
+	printf(", peak memory %.1f MB\n", peak_mb());
+	return 0;
+}
@@ -0,0 +1,339 @@
+/*
+ *	sweep.c - plays a lot of games with the computer player for several difficulties
+ *
+ *	the difficulty of the game (struct tri2s_difficulty, see tri2s-core.h) is how fast the
+ *	stones fall at the start, how much faster they get every level, how fast they get at
+ *	most and how many lines make a level.  this plays games for every combination of the
+ *	values given (the device's by default) with the player of tri2s-ai.c and prints, per
+ *	difficulty, how many lines the games scored and how long they lasted (as percentiles),
+ *	and how many of them got to each level.
+ *
+ *	the games run in threads, one per core by default.  they are split into chunks of
+ *	CHUNK games; every thread works through its own range of chunks from the front, and a
+ *	thread that runs out steals the back half of the range of another one.  every game has
+ *	its own seed (seed + its number within its difficulty), so the results are the same
+ *	for any number of threads.  the last line is the benchmark: games per second over all
+ *	threads, -q prints only that.
+ *
+ *	usage: sweep [-n games] [-s seed] [-m maxsteps] [-j threads] [-t falltimes] [-d steps]
+ *	             [-e mins] [-l levellines] [-q]
+ *
+ *		-n games		games per difficulty
+ *		-m maxsteps		a game is stopped after that many frames (and counted as capped)
+ *		-t, -d, -e, -l	comma separated values of falltime, fallstep, fallmin and levellines,
+ *						e.g. "-t 7,9,11 -l 10,20" plays 6 difficulties
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "tri2s-core.h"
+#include "tri2s-ai.h"
+
+#define CHUNK			16		// games per piece of work
+#define MAX_VALUES		16		// values per parameter
+#define MAX_THREADS		256
+#define SURVIVAL_LEVELS	20		// levels the survival is printed for
+
+/* how a game went */
+struct game_result {
+	uint32_t steps;				// frames it lasted
+	uint32_t lines;				// lines it solved
+	uint32_t level;				// level it got to (level-ups, levelcount wraps)
+	uint8_t capped;				// != 0 if it was stopped at maxsteps
+};
+
+/* a thread and the chunks it has still to do */
+struct worker {
+	pthread_t thread;
+	pthread_mutex_t lock;		// for next and end, other threads steal from them
+	uint64_t next;				// chunks [next, end) ...
+	uint64_t end;
+	int id;
+	uint64_t games;				// games played ...
+	uint64_t steps;
+	unsigned long steals;		// ... ranges stolen from others
+	struct ai_stats stats;		// the player's statistics of the thread
+};
+
+static struct tri2s_difficulty* Difficulties;
+static int NDifficulties;
+static unsigned long Games = 1000;		// per difficulty
+static unsigned long MaxSteps = 100000;
+static uint32_t Seed = 1;
+static struct game_result* Results;		// Games per difficulty, one after the other
+static struct worker Workers[MAX_THREADS];
+static int Threads;
+
+static double now (void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//
+// plays a game with the computer player
+//
+static void play_game (const struct tri2s_difficulty* d, uint32_t seed, struct game_result* r) {
+	struct tri2s_state s;
+	struct ai_player p = { { 0, 0, 0, 0 }, 0 };
+	uint32_t n = 0, lines = 0, levels = 0;
+	uint8_t events = 0;
+
+	tri2s_init_difficulty(&s, seed, d);
+	while (!(events & EV_GAMEOVER) && n < MaxSteps) {
+		events = tri2s_step(&s, ai_play(&p, &s, events));
+		if (events & EV_LINES)
+			lines += __builtin_popcountll(s.lines);
+		if (events & EV_LEVELUP)
+			levels++;
+		n++;
+	}
+	r->steps = n;
+	r->lines = lines;
+	r->level = levels;
+	r->capped = (n >= MaxSteps);
+}
+
+//
+// plays the games of a chunk: the games of all difficulties are numbered one after the
+// other, chunk c has the games from c * CHUNK on
+//
+static void play_chunk (struct worker* w, uint64_t chunk) {
+	uint64_t g = chunk * CHUNK, end = g + CHUNK, total = (uint64_t)NDifficulties * Games;
+
+	if (end > total)
+		end = total;
+	for (; g < end; g++) {
+		struct game_result* r = &Results[g];
+		play_game(&Difficulties[g / Games], Seed + (uint32_t)(g % Games), r);
+		w->games++;
+		w->steps += r->steps;
+	}
+}
+
+//
+// takes the next chunk of the thread's own range, returns 0 if there is none
+//
+static int take (struct worker* w, uint64_t* chunk) {
+	int ok = 0;
+
+	pthread_mutex_lock(&w->lock);
+	if (w->next < w->end) {
+		*chunk = w->next++;
+		ok = 1;
+	}
+	pthread_mutex_unlock(&w->lock);
+	return ok;
+}
+
+//
+// steals the back half of the range of another thread, starting with the next one,
+// and makes the rest of it the own range.  returns 0 if all are done.
+//
+static int steal (struct worker* w, uint64_t* chunk) {
+	int i;
+
+	for (i = 1; i < Threads; i++) {
+		struct worker* v = &Workers[(w->id + i) % Threads];
+		uint64_t lo, hi;
+
+		pthread_mutex_lock(&v->lock);
+		if (v->next >= v->end) {
+			pthread_mutex_unlock(&v->lock);
+			continue;
+		}
+		hi = v->end;
+		lo = v->end - (v->end - v->next + 1) / 2;
+		v->end = lo;
+		pthread_mutex_unlock(&v->lock);
+
+		pthread_mutex_lock(&w->lock);
+		w->next = lo + 1;
+		w->end = hi;
+		pthread_mutex_unlock(&w->lock);
+		w->steals++;
+		*chunk = lo;
+		return 1;
+	}
+	return 0;
+}
+
+static void* worker_main (void* arg) {
+	struct worker* w = arg;
+	uint64_t chunk;
+
+	while (take(w, &chunk) || steal(w, &chunk))
+		play_chunk(w, chunk);
+	w->stats = AiStats;			// the thread's own (see AI_LOCAL in tri2s-ai.h)
+	return NULL;
+}
+
+//
+// reads a comma separated list of up to MAX_VALUES numbers from lo to hi, returns how many
+// there are or 0 if it is not valid
+//
+static int parse_list (const char* s, int* values, int lo, int hi) {
+	int n = 0;
+	char* end;
+
+	do {
+		long v = strtol(s, &end, 0);
+		if ((end == s) || (v < lo) || (v > hi) || (n == MAX_VALUES))
+			return 0;
+		values[n++] = v;
+		s = end + 1;
+	} while (*end == ',');
+	return (*end == 0) ? n : 0;
+}
+
+static int compare_u32 (const void* a, const void* b) {
+	uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+	return (x > y) - (x < y);
+}
+
+//
+// returns the p-th percentile of v, which has to be sorted
+//
+static uint32_t percentile (const uint32_t* v, unsigned long n, int p) {
+	unsigned long i = (n * p) / 100;
+	return v[(i < n) ? i : n - 1];
+}
+
+//
+// prints the results of a difficulty
+//
+static void report (const struct tri2s_difficulty* d, const struct game_result* r) {
+	uint32_t* lines = malloc(Games * sizeof(uint32_t));
+	uint32_t* steps = malloc(Games * sizeof(uint32_t));
+	unsigned long reached[SURVIVAL_LEVELS + 1];
+	unsigned long i, capped = 0;
+	double sumlines = 0, sumsteps = 0;
+	int l;
+
+	if (!lines || !steps) {
+		fprintf(stderr, "out of memory\n");
+		exit(2);
+	}
+	memset(reached, 0, sizeof(reached));
+	for (i = 0; i < Games; i++) {
+		lines[i] = r[i].lines;
+		steps[i] = r[i].steps;
+		sumlines += r[i].lines;
+		sumsteps += r[i].steps;
+		capped += r[i].capped;
+		for (l = 1; (l <= SURVIVAL_LEVELS) && (l <= r[i].level); l++)
+			reached[l]++;
+	}
+	qsort(lines, Games, sizeof(uint32_t), compare_u32);
+	qsort(steps, Games, sizeof(uint32_t), compare_u32);
+
+	printf("falltime %d, fallstep %d, fallmin %d, levellines %u: %lu games (%lu capped)\n",
+		d->falltime, d->fallstep, d->fallmin, d->levellines, Games, capped);
+	printf("  lines    mean %.1f, p10 %u, p50 %u, p90 %u, p99 %u, max %u\n", sumlines / Games,
+		percentile(lines, Games, 10), percentile(lines, Games, 50), percentile(lines, Games, 90),
+		percentile(lines, Games, 99), lines[Games - 1]);
+	// a frame is 100ms
+	printf("  minutes  mean %.1f, p10 %.1f, p50 %.1f, p90 %.1f, p99 %.1f, max %.1f\n", sumsteps / Games / 600,
+		percentile(steps, Games, 10) / 600.0, percentile(steps, Games, 50) / 600.0,
+		percentile(steps, Games, 90) / 600.0, percentile(steps, Games, 99) / 600.0, steps[Games - 1] / 600.0);
+	printf("  level reached (%%)");
+	for (l = 1; (l <= SURVIVAL_LEVELS) && reached[l]; l++)
+		printf(" %d:%.1f", l, 100.0 * reached[l] / Games);
+	printf("\n");
+	free(lines);
+	free(steps);
+}
+
+int main (int argc, char** argv) {
+	int values[4][MAX_VALUES] = { { FALLTIME_START }, { FALLTIME_STEP }, { FALLTIME_MIN }, { LEVEL_LINES } };
+	int counts[4] = { 1, 1, 1, 1 };
+	int c, i, a, b, e, l, quiet = 0;
+	uint64_t chunks, steps = 0, games = 0, placements = 0;
+	unsigned long steals = 0;
+	double t;
+
+	Threads = sysconf(_SC_NPROCESSORS_ONLN);
+	while ((c = getopt(argc, argv, "n:s:m:j:t:d:e:l:q")) != -1) {
+		switch (c) {
+			case 'n': Games = strtoul(optarg, NULL, 0); break;
+			case 's': Seed = strtoul(optarg, NULL, 0); break;
+			case 'm': MaxSteps = strtoul(optarg, NULL, 0); break;
+			case 'j': Threads = atoi(optarg); break;
+			case 't': counts[0] = parse_list(optarg, values[0], 0, 127); break;
+			case 'd': counts[1] = parse_list(optarg, values[1], 0, 127); break;
+			case 'e': counts[2] = parse_list(optarg, values[2], 0, 127); break;
+			case 'l': counts[3] = parse_list(optarg, values[3], 1, 255); break;
+			case 'q': quiet = 1; break;
+			default:
+				fprintf(stderr, "usage: %s [-n games] [-s seed] [-m maxsteps] [-j threads] [-t falltimes] [-d steps] [-e mins] [-l levellines] [-q]\n", argv[0]);
+				return 2;
+		}
+	}
+	if (!counts[0] || !counts[1] || !counts[2] || !counts[3]) {
+		fprintf(stderr, "-t, -d and -e need values from 0 to 127, -l from 1 to 255, at most %d of them\n", MAX_VALUES);
+		return 2;
+	}
+	if ((Games < 1) || (Threads < 1) || (Threads > MAX_THREADS)) {
+		fprintf(stderr, "-n needs at least 1 game, -j 1 to %d threads\n", MAX_THREADS);
+		return 2;
+	}
+
+	// every combination of the values
+	Difficulties = malloc(counts[0] * counts[1] * counts[2] * counts[3] * sizeof(*Difficulties));
+	for (a = 0; a < counts[0]; a++)
+		for (b = 0; b < counts[1]; b++)
+			for (e = 0; e < counts[2]; e++)
+				for (l = 0; l < counts[3]; l++) {
+					struct tri2s_difficulty* d = &Difficulties[NDifficulties++];
+					d->falltime = values[0][a];
+					d->fallstep = values[1][b];
+					d->fallmin = values[2][e];
+					d->levellines = values[3][l];
+				}
+	Results = calloc((uint64_t)NDifficulties * Games, sizeof(*Results));
+	if (!Difficulties || !Results) {
+		fprintf(stderr, "out of memory\n");
+		return 2;
+	}
+
+	// the chunks are shared out evenly to start with
+	chunks = ((uint64_t)NDifficulties * Games + CHUNK - 1) / CHUNK;
+	t = now();
+	for (i = 0; i < Threads; i++) {
+		struct worker* w = &Workers[i];
+		w->id = i;
+		w->next = chunks * i / Threads;
+		w->end = chunks * (i + 1) / Threads;
+		pthread_mutex_init(&w->lock, NULL);
+	}
+	for (i = 0; i < Threads; i++)
+		if (pthread_create(&Workers[i].thread, NULL, worker_main, &Workers[i])) {
+			perror("pthread_create");
+			return 2;
+		}
+	for (i = 0; i < Threads; i++) {
+		pthread_join(Workers[i].thread, NULL);
+		games += Workers[i].games;
+		steps += Workers[i].steps;
+		steals += Workers[i].steals;
+		placements += Workers[i].stats.placements;
+	}
+	t = now() - t;
+
+	if (!quiet)
+		for (i = 0; i < NDifficulties; i++)
+			report(&Difficulties[i], &Results[(uint64_t)i * Games]);
+	printf("threads %d: %.1f games/sec (%.1f per thread), %.0f steps/sec, %.0f placements/sec, %lu steals, %.2f sec\n",
+		Threads, games / t, games / t / Threads, steps / t, placements / t, steals, t);
+	return 0;
+}
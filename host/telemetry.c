@@ -0,0 +1,119 @@
+/*
+ *	telemetry.c - decodes the telemetry records of a "make TELEMETRY=1" build
+ *
+ *	reads the bytes the Mignonette sent over the UART (see telemetry.h), from a file or
+ *	the serial port, e.g. "stty -F /dev/ttyUSB0 38400 raw; ./telemetry /dev/ttyUSB0",
+ *	or captured from simavr with "sim/isrprof -u file".  prints one line per record:
+ *
+ *		frame <ticks left>
+ *		stats <ISR max> <ISR mean> <least free RAM> <button presses lost> <records dropped>
+ *		game <events> <level> <solved lines>
+ *		profile <render> <input> <logic> <lines> <missed frames>
+ *		hist <frames by tenths of the frame they took, the last for longer>
+ *		search <worst ticks of a line of the demo player's search> <worst ticks in a frame>
+ *
+ *	the ISR times are in cycles (the device counts them in units of 8), the longest times
+ *	of the sections of the main loop (with PROFILE) in microseconds: the device counts them
+ *	with the display timer, whose counts per millisecond depend on its clock and come along
+ *	in the record.  bytes that don't make up a valid record are skipped, their number is
+ *	printed at the end.
+ *
+ *	usage: telemetry [file]
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "telemetry.h"
+
+//
+// prints a record
+//
+static void print_record (uint8_t type, const uint8_t* p, uint8_t len) {
+	uint8_t i;
+
+	switch (type) {
+		case T_FRAME:
+			if (len >= 2)
+				printf("frame %u\n", p[0] | (p[1] << 8));
+			break;
+		case T_STATS:
+			if (len >= 6)
+				printf("stats %u %u %u %u %u\n", p[0] * 8, p[1] * 8, p[2] | (p[3] << 8), p[4], p[5]);
+			break;
+		case T_GAME:
+			if (len >= 3)
+				printf("game 0x%02x %u %u\n", p[0], p[1], p[2]);
+			break;
+		case T_PROFILE:
+			if ((len >= 12) && (p[10] | p[11])) {
+				unsigned rate = p[10] | (p[11] << 8);		// counts per millisecond
+				printf("profile");
+				for (i = 0; i < 8; i += 2)
+					printf(" %lu", (unsigned long)(p[i] | (p[i + 1] << 8)) * 1000 / rate);
+				printf(" %u\n", p[8] | (p[9] << 8));
+			}
+			break;
+		case T_HIST:
+			printf("hist");
+			for (i = 0; i < len; i++)
+				printf(" %u", p[i]);
+			printf("\n");
+			break;
+		case T_SEARCH:
+			if (len >= 4)
+				printf("search %u %u\n", p[0] | (p[1] << 8), p[2] | (p[3] << 8));
+			break;
+		default:
+			printf("unknown %u\n", type);
+			break;
+	}
+	fflush(stdout);
+}
+
+int main (int argc, char** argv) {
+	FILE* f = stdin;
+	uint8_t buf[TELEMETRY_MAXLEN + 4], sum;
+	unsigned long records = 0, skipped = 0;
+	int c, n = 0, i;
+
+	if (argc > 2) {
+		fprintf(stderr, "usage: %s [file]\n", argv[0]);
+		return 2;
+	}
+	if ((argc == 2) && !(f = fopen(argv[1], "rb"))) {
+		perror(argv[1]);
+		return 2;
+	}
+
+	// buf holds the bytes of what may be a record, from its sync byte on
+	while ((c = getc(f)) != EOF) {
+		buf[n++] = c;
+		while (n > 0) {
+			if ((buf[0] != TELEMETRY_SYNC) || ((n >= 3) && (buf[2] > TELEMETRY_MAXLEN))) {
+				memmove(buf, buf + 1, --n);		// not a record, try from the next byte on
+				skipped++;
+				continue;
+			}
+			if ((n < 4) || (n < buf[2] + 4))
+				break;							// not complete yet
+			for (sum = 0, i = 1; i < n; i++)
+				sum += buf[i];
+			if (sum == 0) {
+				print_record(buf[1], buf + 3, buf[2]);
+				records++;
+				n = 0;
+			} else {
+				memmove(buf, buf + 1, --n);
+				skipped++;
+			}
+		}
+	}
+	fprintf(stderr, "%lu records, %lu bytes skipped\n", records, skipped);
+	return 0;
+}
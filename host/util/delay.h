@@ -0,0 +1,13 @@
+/*
+ *	util/delay.h - stand-in for the avr-libc header, for building miggl.c on the host
+ *
+ *	(see microbench.c)  the delays do not wait, the host has no use for them.
+ */
+
+#ifndef HOST_UTIL_DELAY_H
+#define HOST_UTIL_DELAY_H
+
+#define _delay_us(us)
+#define _delay_ms(ms)
+
+#endif /* HOST_UTIL_DELAY_H */
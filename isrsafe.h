@@ -0,0 +1,143 @@
+/*
+ *	isrsafe.h - sharing variables between the interrupts and the main program, without cli()
+ *
+ *	the AVR reads and writes a byte at once, but a uint16_t or a group of variables in
+ *	several instructions, and an interrupt can come in between.  and the compiler keeps
+ *	what it read in registers, and moves the writes around, unless it is told otherwise.
+ *	turning the interrupts off around every access does it, but the audio interrupt comes
+ *	every 50us and should not wait.  so each of these has one side that writes and one
+ *	that reads, every variable is written by one side only, and nobody waits:
+ *
+ *		seqcount_t		a group of variables, written by an interrupt and read by the
+ *						main program: the interrupt counts it up after writing them
+ *						(seq_publish()), the main program reads them again if it
+ *						changed meanwhile (seq_read_begin(), seq_read_retry()).
+ *						the other way round, the main program counts it up before and
+ *						after writing (seq_write_begin(), seq_write_end()), it is odd in
+ *						between, and the interrupt, which can't wait, uses the variables
+ *						only while seq_writing() is 0 and otherwise the ones it had.
+ *
+ *		struct ring_idx	the head and tail of a ring buffer of a power of 2 bytes: one side
+ *						puts bytes at the head and then moves it (ring_put()), the other
+ *						takes them from the tail and then moves that (ring_take()).
+ *
+ *		struct isr_events	up to 8 events (bits) that one side raises and the other takes:
+ *						raising toggles bits of "raised", taking toggles the same bits of
+ *						"taken", an event is pending while the two differ.  an event that
+ *						is raised again before it is taken counts once.
+ *
+ *	isr_barrier() keeps the compiler from moving memory accesses across it, it costs no
+ *	instructions.  none of this turns the interrupts off.
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#ifndef ISRSAFE_H
+#define ISRSAFE_H
+
+#include <inttypes.h>
+
+#define isr_barrier()	__asm__ __volatile__ ("" ::: "memory")
+
+
+/* sequence counters */
+
+typedef volatile uint8_t seqcount_t;
+
+// the interrupt has written the variables (the main program can't come in between)
+static inline void seq_publish (seqcount_t* s) {
+	isr_barrier();
+	(*s)++;
+}
+
+// the main program reads the variables after this ...
+static inline uint8_t seq_read_begin (const seqcount_t* s) {
+	uint8_t q = *s;
+	isr_barrier();
+	return q;
+}
+
+// ... and again, if this returns 1
+static inline uint8_t seq_read_retry (const seqcount_t* s, uint8_t q) {
+	isr_barrier();
+	return *s != q;
+}
+
+// the main program writes the variables between these ...
+static inline void seq_write_begin (seqcount_t* s) {
+	(*s)++;
+	isr_barrier();
+}
+
+static inline void seq_write_end (seqcount_t* s) {
+	isr_barrier();
+	(*s)++;
+}
+
+// ... and the interrupt leaves them alone while this is 1
+static inline uint8_t seq_writing (const seqcount_t* s) {
+	return *s & 1;
+}
+
+
+/* ring buffer indices, n is the size of the ring */
+
+struct ring_idx {
+	volatile uint8_t head;		// the next byte goes here ...
+	volatile uint8_t tail;		// ... and this one is taken next
+};
+
+#define RING_NEXT(i, n)		(((i) + 1) & ((n) - 1))
+
+// bytes in the ring
+static inline uint8_t ring_count (const struct ring_idx* r, uint8_t n) {
+	return (r->head - r->tail) & (n - 1);
+}
+
+// free space (one byte always stays empty, so a full ring can be told from an empty one)
+static inline uint8_t ring_free (const struct ring_idx* r, uint8_t n) {
+	return (r->tail - r->head - 1) & (n - 1);
+}
+
+// the bytes up to head have been written
+static inline void ring_put (struct ring_idx* r, uint8_t head) {
+	isr_barrier();
+	r->head = head;
+}
+
+// the bytes up to tail have been read
+static inline void ring_take (struct ring_idx* r, uint8_t tail) {
+	isr_barrier();
+	r->tail = tail;
+}
+
+
+/* events */
+
+struct isr_events {
+	volatile uint8_t raised;	// written by the side that raises them ...
+	volatile uint8_t taken;		// ... and this by the one that takes them
+};
+
+// the events that are raised and not yet taken
+static inline uint8_t events_pending (const struct isr_events* e) {
+	return e->raised ^ e->taken;
+}
+
+// raises events, the pending ones stay as they are
+static inline void events_raise (struct isr_events* e, uint8_t mask) {
+	uint8_t r = e->raised;
+	e->raised = r ^ (mask & ~(r ^ e->taken));
+}
+
+// takes the pending events of mask and returns them
+static inline uint8_t events_take (struct isr_events* e, uint8_t mask) {
+	uint8_t t = e->taken;
+	uint8_t p = (e->raised ^ t) & mask;
+	e->taken = t ^ p;
+	return p;
+}
+
+#endif /* ISRSAFE_H */
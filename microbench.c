@@ -0,0 +1,254 @@
+/*
+ *	microbench.c - microbenchmarks of the miggl primitives and the Tri2s game functions
+ *
+ *	times the functions a frame is built from, one at a time, so a change to one of them
+ *	can be measured on both targets.  the same source builds for two backends:
+ *
+ *		host	miggl.c and the game compiled for the development machine (host/Makefile,
+ *				"make -C host run-microbench"), prints nanoseconds per call
+ *		AVR		microbench.elf (Makefile, "make microbench.elf"), run in simavr by sim/benchrun
+ *				("make -C sim run-benchrun"), which prints cycles per call
+ *
+ *	every benchmark runs its loop twice, once with only the setup of each call (moving to
+ *	the next pixel, copying the field, ...) and once with the setup and the call.  the
+ *	difference per call is the result, so the loop and the setup are not counted.  the
+ *	host takes the fastest of BENCH_REPEAT runs, the simulator needs only one.
+ *
+ *	the output is one line "name value" per benchmark, "ns.drawpoint 1.52" on the host and
+ *	"cycles.drawpoint 40.0" from the simulator.
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#include <inttypes.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include "mydefs.h"
+#include "miggl.h"
+#include "tri2s-core.h"
+#include "tri2s-anim.h"
+#include "tri2s-text.h"
+
+#ifdef __AVR__
+#include <avr/sleep.h>
+#define BENCH_OPS		100
+#define BENCH_REPEAT	1
+#else
+#include <stdio.h>
+#include <time.h>
+#define BENCH_OPS		1000000UL
+#define BENCH_REPEAT	5
+#endif
+
+// lets the compiler neither drop nor merge the work of the loops
+#define BARRIER()	__asm__ volatile("" ::: "memory")
+
+//
+// runs a benchmark: the loop with only the setup, then with setup and call
+//
+#define BENCH(name, setup, call) do {						\
+		uint8_t r;											\
+		uint32_t i;											\
+		for (r = 0; r < BENCH_REPEAT; r++) {				\
+			bench_begin(0);									\
+			for (i = 0; i < BENCH_OPS; i++) {				\
+				setup;										\
+				BARRIER();									\
+			}												\
+			bench_end();									\
+			bench_begin(1);									\
+			for (i = 0; i < BENCH_OPS; i++) {				\
+				setup;										\
+				BARRIER();									\
+				call;										\
+				BARRIER();									\
+			}												\
+			bench_end();									\
+		}													\
+		bench_report(name);									\
+	} while (0)
+
+// from tri2s.c (built with its main() renamed, see Makefile)
+extern const struct anim_step IntroAnim[];
+extern const struct anim_step FlashAnim[];
+
+// the audio part of the timer interrupt (miggl-audio.c)
+void do_audio_isr (void);
+extern uint16_t Wdur;
+extern const uint8_t* songPtr;
+
+// two notes: the benchmark advances from the first to the second again and again
+const byte BenchSong[] PROGMEM = {
+	N_C4,N_16TH,
+	N_E4,N_16TH,
+	N_END
+};
+
+// a long noise effect with a sweep and a decay, the most work for the interrupt
+const struct sfx BenchSfx[] PROGMEM = {
+	{ SFX_HZ(5000), SFX_SWEEP(5000, 500, 400), SFX_MS(400), SFX_NOISE, 40, 4 }
+};
+
+// a field with its two bottom lines almost full, and one with its bottom line complete
+field_t Field[FIELD_WIDTH];
+field_t FullField[FIELD_WIDTH];
+field_t WorkField[FIELD_WIDTH];
+
+// where the next call goes (volatile, so both loops of a benchmark do the same work)
+volatile uint8_t PosX, PosY, PosStone;
+volatile uint8_t Sink;
+
+#ifdef __AVR__
+
+const uint16_t BenchOps = BENCH_OPS;
+
+//
+// sim/benchrun counts the cycles from the call of bench_begin() to the call of bench_end()
+// and prints them at the call of bench_report().  it reads the arguments from r24 (phase)
+// and r25:r24 (name), where avr-gcc passes them.  the bodies only keep the calls apart.
+//
+volatile uint8_t BenchPhase;
+const char* volatile BenchName;
+
+void __attribute__((noinline)) bench_begin (uint8_t phase) {
+	BenchPhase = phase;
+}
+
+void __attribute__((noinline)) bench_end (void) {
+	BenchPhase = 0xFF;
+}
+
+void __attribute__((noinline)) bench_report (const char* name) {
+	BenchName = name;
+}
+
+#else
+
+static uint8_t Phase;
+static struct timespec Start;
+static double Best[2];				// fastest run so far per phase (ns)
+
+static double now (void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+void bench_begin (uint8_t phase) {
+	Phase = phase;
+	clock_gettime(CLOCK_MONOTONIC, &Start);
+}
+
+void bench_end (void) {
+	double t = now() - (Start.tv_sec * 1e9 + Start.tv_nsec);
+	if ((Best[Phase] == 0) || (t < Best[Phase]))
+		Best[Phase] = t;
+}
+
+void bench_report (const char* name) {
+	printf("ns.%s %.2f\n", name, (Best[1] - Best[0]) / BENCH_OPS);
+	Best[0] = Best[1] = 0;
+}
+
+#endif
+
+//
+// moves to the next pixel of the screen
+//
+static void next_pixel (void) {
+	if (++PosX == XSCREEN) {
+		PosX = 0;
+		if (++PosY == YSCREEN)
+			PosY = 0;
+	}
+}
+
+//
+// moves to the next position and stone in the field, some fit and some don't
+//
+static void next_stone (void) {
+	if (++PosY == FIELD_WIDTH) {
+		PosY = 0;
+		if (++PosX == FIELD_LINES) {
+			PosX = 0;
+			PosStone = rotate_stone(PosStone);
+		}
+	}
+}
+
+//
+// fills the fields
+//
+static void init_fields (void) {
+	uint8_t i;
+
+	for (i = 0; i < FIELD_WIDTH; i++) {
+		Field[i] = (i == 1) ? FIELD_BIT(FIELD_LINES - 2) : FIELD_BIT(FIELD_LINES - 1) | FIELD_BIT(FIELD_LINES - 2);
+		FullField[i] = FIELD_BIT(FIELD_LINES - 1) | ((i & 1) ? FIELD_BIT(FIELD_LINES - 3) : 0);
+	}
+	Field[FIELD_WIDTH - 1] = 0;
+}
+
+//
+// starts the benchmark song and plays its first note to the end, so the envelope of the
+// second one is set up as in a game (see do_audio_isr())
+//
+static void init_song (void) {
+	initaudio();
+	setenvelope(128, 32, 60, 32);		// as in the game
+	playsong(BenchSong);
+	do										// the first tick takes the song
+		do_audio_isr();
+	while (songPtr == BenchSong + 2);
+}
+
+int main (void) {
+	init_fields();
+	init_song();
+	setcolor(YELLOW);
+	PosStone = UP | MIDDLE | RIGHT;
+
+	// four cycles on the AVR: sim/benchrun checks that it counts them
+	BENCH("nop4", , __asm__ volatile("nop\n\tnop\n\tnop\n\tnop"));
+	BENCH("drawpoint", next_pixel(), drawpoint(PosX, PosY));
+	BENCH("readpixel", next_pixel(), Sink = readpixel(PosX, PosY));
+	BENCH("drawfilledrect", , drawfilledrect(0, 0, XSCREEN - 1, YSCREEN - 1));
+	BENCH("cleardisplay", , cleardisplay());
+	anim_screen(IntroAnim);
+	BENCH("anim_frame", , anim_frame());
+	anim_start(FlashAnim, 0, 0);
+	BENCH("anim_flash", , anim_frame());		// every other frame recolors the screen
+	anim_stop(NULL);
+	anim_screen(NULL);
+	text_clear();
+	text_add_P(PSTR("LEVEL 12"));
+	// a column of the scrolling, from the start of the message again every 32 (it has 36)
+	BENCH("text_step", if (!(i & 31)) text_scroll(YELLOW, TEXT_OVERLAY, 1, 0), Sink = text_step());
+	BENCH("text_frame", , text_frame());			// drawn over the screen, a step every frame
+	text_stop();
+	BENCH("nextrandom", , Sink = nextrandom(6));
+	BENCH("can_move_stone", next_stone(), Sink = can_move_stone(Field, PosStone, PosX, PosY));
+	BENCH("can_rotate_stone", next_stone(), Sink = can_rotate_stone(Field, PosStone, PosX, PosY));
+	BENCH("get_complete_line", , Sink = get_complete_line(FullField));
+	BENCH("field_remove_line", memcpy(WorkField, FullField, sizeof(WorkField)), field_remove_line(WorkField, FIELD_LINES - 1));
+	BENCH("note_advance", (songPtr = BenchSong + 2, Wdur = 0), do_audio_isr());
+	// the end of the song, which goes on from its loop point in the same tick
+	loopsong(1);
+	BENCH("song_loop", (songPtr = BenchSong + 4, Wdur = 0), do_audio_isr());
+	loopsong(0);
+	stopsong();
+	// the effect alone, started again every 4096 ticks (it has 8000)
+	BENCH("sfx_tick", if (!(i & 4095)) sfx_play(BenchSfx), do_audio_isr());
+	sfx_stop();
+
+#ifdef __AVR__
+	cli();				// sleeping with the interrupts off ends the simulation
+	sleep_enable();
+	sleep_cpu();
+#endif
+	return 0;
+}
@@ -0,0 +1,937 @@
+/*
+ *	miggl-audio.c - Mignonette Game Library, the audio part: songs, sound effects and the
+ *	audio interrupt's do_audio_isr()
+ *
+ *	author(s): rolf van widenfelt (rolfvw at pizzicato dot com) (c) 2008, 2009 - Some Rights Reserved
+ *
+ *	author(s): mitch altman (c) 2008, 2009 - Some Rights Reserved
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ *
+ *	the timer and the interrupt itself are set up in miggl.c, this only needs the timer 1
+ *	registers.  so it builds on the host as well: host/miggl-host.c calls do_audio_isr()
+ *	once per tick for the sound of tri2s-host, and microbench times it.
+ *
+ *	revision history:
+ *
+ *	(see miggl.c, this was part of it)
+ *
+ */
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <avr/io.h>			/* this takes care of definitions for our specific AVR */
+#include <avr/pgmspace.h>	/* for the sound effects in flash */
+
+#include "mydefs.h"
+
+#include "miggl.h"
+#include "miggl-private.h"
+#include "isrsafe.h"
+
+#if SFX_RATE != AUDIO_RATE
+#error "SFX_RATE (miggl.h) must be AUDIO_RATE (miggl-private.h)"
+#endif
+
+
+// globals for audio here
+
+//
+// the wavetables, NoteTab and DurTab are in flash (PROGMEM), like the songs (see playsong()),
+// which leaves RAM for the stack.  a read costs the interrupt an LPM instead of an LD.
+//
+
+// sawtooth wavetable (TOP=49) (updated table from Mitch)
+static const uint8_t SawWtable[WTABSIZE] PROGMEM = {
+  0,   2,   3,   5,
+  6,   8,   9,  11,
+ 13,  14,  16,  17,
+ 19,  21,  22,  24,
+ 25,  27,  28,  30,
+ 32,  33,  35,  36,
+ 38,  40,  41,  43,
+ 44,  46,  47,  49,
+};
+
+
+// sinewave wavetable (TOP=49)
+static const uint8_t SineWtable[WTABSIZE] PROGMEM = {
+  25, 29, 34, 38,
+  42, 45, 47, 49,
+  49, 49, 47, 45,
+  42, 38, 34, 29,
+  25, 20, 15, 11,
+   7,  4,  2,  0,
+   0,  0,  2,  4,
+   7, 11, 15, 20,
+};
+
+// squarewave wavetable (TOP=49)
+static const uint8_t SquareWtable[WTABSIZE] PROGMEM = {
+  0,   0,   0,   0,
+  0,   0,   0,   0,
+  0,   0,   0,   0,
+  0,   0,   0,   0,
+ 49,  49,  49,  49,
+ 49,  49,  49,  49,
+ 49,  49,  49,  49,
+ 49,  49,  49,  49,
+};
+
+
+//
+// the audio interrupt owns the state of the song and the note (from wavPtr to EnvDelta).
+// playsong(), stopsong() and queuesong() only hand it what to play next (SongCut and
+// SongQueue below), so it never sees half of a song.
+//
+
+//const uint8_t* wavTables[];  // table of addresses of different waveform tables (SINE, SAW, TRIANGLE, SQUARE, WEIRD)
+const uint8_t* wavPtr;              // this points to the currently active waveform (in flash)
+
+uint16_t Wdur;        // duration for playing notes (these are in units of 50usec) -- initialize for 75 bpm (beats per minute)
+uint16_t Wnote_sep;   // small pause at end of each note (these are in units of 50usec)
+
+//extern const uint8_t* songTables[]; // table of addresses of different waveform tables (SINE, SAW, TRIANGLE, SQUARE, WEIRD)
+const uint8_t* songPtr;			// this points into to the current song table (in flash)
+const uint8_t* songBeginPtr;	// where the current song loops to: its begin, or its N_LOOP
+volatile uint8_t SongLoopFlag;	// if != 0, the song will be looped forever
+
+// a song to play, with where it loops to found by the main program (see song_loop())
+struct song_entry {
+	const uint8_t* begin;
+	const uint8_t* loop;
+	uint8_t looped;				// SongLoopFlag while it plays (queued songs only)
+};
+
+#define SONG_QUEUE		4		// queued songs + 1 (a power of 2)
+
+// the songs that follow the current one, put in by queuesong(), taken by the interrupt
+static struct song_entry SongNext[SONG_QUEUE];
+static struct ring_idx SongQueue;
+
+// the song playsong() starts right away, NULL for stopsong() ...
+static struct song_entry SongCut;
+static uint8_t SongCutHead;			// ... and the queue before it, up to here, is dropped
+static seqcount_t SongCutSeq;		// written between the counts
+static volatile uint8_t SongCutTaken;	// SongCutSeq when the interrupt took SongCut
+
+
+
+//volatile uint16_t StabPtr;     // song table pointer -- initialized to beginning of table
+
+volatile uint8_t CurNote;         // keeps track of note to play next time through the ISR
+
+volatile uint8_t SongPlayFlag; // song play flag is 0 when not playing a song from song table, 1 while playing a song
+
+//volatile int PWMval;           // this is the value that goes into 0CR1A (initialized to first value in wave table)
+int PWMval;           // this is the value that goes into 0CR1A (initialized to first value in wave table)
+
+// WtabCount acts as a pointer through the wavetable as if there were a continuous wavetable, rather than just 32 discreet bytes
+// WtabDelta is the amount to increment the WtabCount to get the next value from the wavetable
+// fixed point number -- the integer part is as expected, the fractional part is a number divided by 256
+//
+// XXX note: should these be volatile?  -rolf
+//
+struct fixedPtNum WtabDelta;  // with this version of firmware we're limited to values between 1.000 and 1.996 (integ part always = 1)
+struct fixedPtNum WtabCount;
+
+// WtabCount acts as a pointer through the wavetable as if there were a continuous wavetable, rather than just 32 discreet bytes
+// WtabDelta is the amount to increment the WtabCount to get the next value from the wavetable
+// fixed point number -- the integer part is as expected, the fractional part is a number divided by 256
+//
+// XXX note: should these be volatile?  -rolf
+//
+struct fixedPtNum WtabDelta;  // with this version of firmware we're limited to values between 1.000 and 1.996 (integ part always = 1)
+struct fixedPtNum WtabCount;
+
+uint8_t EnvelopeA; // represents 1/256 of the overall length
+uint8_t EnvelopeD; // represents 1/256 of the overall length
+uint8_t EnvelopeS; // the fixed level of the sustain, must be >= 0 and < 63
+uint8_t EnvelopeR; // represents 1/256 of the overall length
+
+uint16_t EnvPointStartAttack; 	// the position of the note where the attack begins
+uint16_t EnvPointStartDecay; 	// the position of the note where the decay begins
+uint16_t EnvPointStartSustain; // the position of the note where the sustain begins
+uint16_t EnvPointStartRelease; // the position of the note where the release begins
+
+struct fixedPtNum EnvValue;	// the current value of the envelope
+struct fixedPtNum EnvDelta;	// the delta of the envelope (steepness)
+
+// the wavetable and envelope set by setwavetable() and setenvelope().  every note starts
+// with them (see take_sound()), unless the main program is writing them just then.
+static struct {
+	const uint8_t* wav;
+	uint8_t a, d, s, r;
+} Sound;
+static seqcount_t SoundSeq;
+
+//
+// takes the wavetable and the envelope for the next note, if they are not being written
+//
+static inline void take_sound(void)
+{
+	if (!seq_writing(&SoundSeq)) {
+		wavPtr = Sound.wav;
+		EnvelopeA = Sound.a;
+		EnvelopeD = Sound.d;
+		EnvelopeS = Sound.s;
+		EnvelopeR = Sound.r;
+	}
+}
+
+//
+// the sound effect the audio interrupt plays (see sfx_play()).  it owns Sfx and SfxNoise,
+// the main program only hands it the next effect in SfxRequest.
+//
+static struct {
+	const struct sfx* rec;		// the record playing (in flash), NULL when there is none
+	uint16_t phase;				// goes around once per period of the wave
+	uint16_t step;				// added to the phase every tick
+	int16_t sweep;				// added to step every control step
+	uint8_t level;				// OCR1A while the wave is high
+	uint8_t ticks;				// ticks until the next control step
+	uint8_t left;				// control steps until the end of the record
+	uint8_t wave;
+	uint8_t chain;
+	uint8_t decay;
+	uint8_t decayleft;			// control steps until the level drops
+} Sfx;
+static uint16_t SfxNoise = 1;	// the noise, a 16 bit LFSR (never 0)
+
+static const struct sfx* SfxRequest;	// the effect to start, written by sfx_play() ...
+static seqcount_t SfxSeq;				// ... between the counts
+static volatile uint8_t SfxTaken;		// SfxSeq when the interrupt took SfxRequest
+volatile uint8_t SfxPlaying;			// != 0 while an effect plays
+
+//
+// the effect is over (or stopped): the song, if there is one, takes over the compare
+// output again with its next tick
+//
+static void sfx_end(void)
+{
+	Sfx.rec = NULL;
+	SfxPlaying = 0;
+	TCCR1A &= ~_BV(COM1A1);
+}
+
+//
+// starts a record of an effect, e in flash.  the phase goes on from the last one, so
+// a chain of them doesn't click.
+//
+static void sfx_start(const struct sfx* e)
+{
+	uint8_t w;
+
+	if ((e == NULL) || !pgm_read_byte(&e->length)) {
+		sfx_end();
+		return;
+	}
+	Sfx.rec = e;
+	Sfx.step = pgm_read_word(&e->step);
+	Sfx.sweep = pgm_read_word(&e->sweep);
+	Sfx.left = pgm_read_byte(&e->length);
+	w = pgm_read_byte(&e->wave);
+	Sfx.wave = w & ~SFX_CHAIN;
+	Sfx.chain = w & SFX_CHAIN;
+	Sfx.level = pgm_read_byte(&e->volume) * PWM_SCALE;
+	Sfx.decay = Sfx.decayleft = pgm_read_byte(&e->decay);
+	Sfx.ticks = SFX_CONTROL;
+	SfxPlaying = 1;
+	TCCR1A |= _BV(COM1A1);
+}
+
+//
+// every SFX_CONTROL ticks: the end of the record, the sweep and the decay
+//
+static void sfx_control(void)
+{
+	Sfx.ticks = SFX_CONTROL;
+	if (--Sfx.left == 0) {
+		if (Sfx.chain)
+			sfx_start(Sfx.rec + 1);
+		else
+			sfx_end();
+		return;
+	}
+	Sfx.step += Sfx.sweep;
+	if (Sfx.decay && (--Sfx.decayleft == 0)) {
+		Sfx.decayleft = Sfx.decay;
+		Sfx.level -= Sfx.level >> 2;
+	}
+}
+
+//
+// a tick of the effect: one add for the phase, its top bits (or the noise, which gets a
+// new bit when the phase goes around) choose between level and 0 for OCR1A.  no multiply
+// and nothing from flash; that, the pitch sweep and the decay are in sfx_control(), once
+// per SFX_CONTROL ticks.
+//
+static inline void sfx_tick(void)
+{
+	uint16_t p = Sfx.phase + Sfx.step;
+	uint8_t high;
+
+	if (Sfx.wave == SFX_NOISE) {
+		if (p < Sfx.phase)
+			SfxNoise = (SfxNoise >> 1) ^ ((SfxNoise & 1) ? 0xB400 : 0);
+		high = SfxNoise & 1;
+	} else if (Sfx.wave == SFX_PULSE) {
+		high = (p >= 0xC000);
+	} else {
+		high = (p >= 0x8000);
+	}
+	Sfx.phase = p;
+	OCR1A = high ? Sfx.level : 0;
+	if (--Sfx.ticks == 0)
+		sfx_control();
+}
+
+//
+// the song is over, and nothing follows it
+//
+static void song_stop(void)
+{
+	SongPlayFlag = 0;
+	CurNote = N_END;
+	if (Sfx.rec == NULL)
+		TCCR1A &= ~_BV(COM1A1);		// turn off audio by turning off compare
+}
+
+//
+// goes on at the end of the song: with the next one in the queue, or from the loop point
+// of this one if it loops.  the pointers were found before (see song_loop()), so this
+// is only copying them.  returns 0 if nothing follows.
+//
+static uint8_t song_follow(void)
+{
+	uint8_t t = SongQueue.tail;
+
+	if (t != SongQueue.head) {
+		songPtr = SongNext[t].begin;
+		songBeginPtr = SongNext[t].loop;
+		SongLoopFlag = SongNext[t].looped;
+		ring_take(&SongQueue, RING_NEXT(t, SONG_QUEUE));
+		return 1;
+	}
+	if (SongLoopFlag) {
+		songPtr = songBeginPtr;
+		return 1;
+	}
+	return 0;
+}
+
+//
+// sets up the next note of the song for the next tick.  N_LOOP is passed over, and at
+// N_END the next song (or the loop) follows in the same tick, so there is no gap and no
+// tick of its own for the end.  (a song with no notes after its loop point stops.)
+//
+static void next_note(void)
+{
+	uint16_t tmp;
+	uint8_t note, dur, ends = 0;
+
+	take_sound();
+	while (1) {
+		note = pgm_read_byte(songPtr++);
+		if (note == N_LOOP)
+			continue;
+		if (note != N_END)
+			break;
+		if ((++ends > 1) || !song_follow()) {
+			song_stop();
+			return;
+		}
+	}
+
+	// a rest has no pitch (and no entry in NoteTab), the speaker is off for it
+	if (note != N_REST) {
+		tmp = GETNOTEDELTA(note);
+		WtabDelta.integ = (uint8_t)((tmp >> 8) & 0xff);		// high byte
+		WtabDelta.fract = (uint8_t)(tmp & 0xff);			// low byte
+	}
+	dur = pgm_read_byte(songPtr++);
+	CurNote = note;						// set the note to play, and
+	Wdur = GETDURATION(dur);   			// its duration.
+
+	EnvPointStartAttack  = Wdur;	// calculates the positions for the envelope parts
+	EnvPointStartDecay   = EnvPointStartAttack - (Wdur / 256 * EnvelopeA);
+	EnvPointStartSustain = EnvPointStartDecay  - (Wdur / 256 * EnvelopeD);
+	EnvPointStartRelease = (Wdur / 256 * EnvelopeR);
+	EnvValue.integ = 0;
+	EnvValue.fract = 0;
+	EnvDelta.integ = 0;
+	EnvDelta.fract = 0;
+}
+
+//
+// starts the song at songPtr from the start of the wavetable
+//
+static void song_start(void)
+{
+	WtabCount.integ = 0;
+	WtabCount.fract = 0;
+	SongPlayFlag = 1;
+	next_note();
+	PWMval = pgm_read_byte(&wavPtr[0]);
+}
+
+//
+// takes the song of playsong() (or the stop of stopsong()): the songs queued before it
+// are dropped, the ones queued after it stay
+//
+static void song_cut(void)
+{
+	ring_take(&SongQueue, SongCutHead);
+	if (SongCut.begin == NULL) {
+		song_stop();
+		return;
+	}
+	songPtr = SongCut.begin;
+	songBeginPtr = SongCut.loop;
+	song_start();
+}
+
+
+//
+// audio portion of timer ISR
+//
+// (based on Mitch's ISR code from mig-testrefresh.c of 5/2/2008)
+//
+void do_audio_isr(void)
+{
+    uint8_t WtabVal1;   // two values from the wavetable between which we will interpolate
+    uint8_t WtabVal2;
+    uint16_t Wptr1;     // pointer to first value in wavetable
+    uint16_t Wptr2;     // pointer to second value in wavetable
+    uint16_t temp;
+    int16_t tmpEnv;		// temp value for envelope calculation
+
+    // a sound effect sfx_play() asked for starts now, and it plays instead of the song
+    if ((SfxSeq != SfxTaken) && !seq_writing(&SfxSeq)) {
+        SfxTaken = SfxSeq;
+        sfx_start(SfxRequest);
+    }
+    if (Sfx.rec != NULL)
+        sfx_tick();
+
+    // a song playsong() or stopsong() asked for takes over now
+    if ((SongCutSeq != SongCutTaken) && !seq_writing(&SongCutSeq)) {
+        SongCutTaken = SongCutSeq;
+        song_cut();
+    }
+
+    // The PWM value is loaded into the timer compare register at the beginning of the ISR if we are playing a song.
+    // This PWM value was calculated in the previous pass through the ISR.
+    // (the end of a song is no tick of its own: next_note() goes on with the next song, or stops)
+
+    // with nothing to play, the interrupt is turned off until playsong(), queuesong() or sfx_play()
+    // start something.  a song queued while none played starts now.
+    if (!SongPlayFlag) {
+        if (SongQueue.head != SongQueue.tail) {
+            song_follow();
+            song_start();
+        } else if (Sfx.rec == NULL)
+            TIMSK1 &= ~_BV(TOIE1);
+        return;
+    }
+
+    // if we are playing a song, then calculate the PWM value to play the next time we get into the ISR
+    if (SongPlayFlag) {          // only handle audio if we're playing a song (SongPlayFlag is set by main to start playing audio, and it is cleared by ISR when all events in active song table are completed)
+
+        // while an effect plays the song goes on without being heard
+        if (Sfx.rec == NULL) {
+            // if the Note to play is a Rest, then turn the speaker off
+            if ( CurNote == N_REST )
+                TCCR1A &= ~_BV(COM1A1);  // turn off audio by turning off compare
+            // otherwise, start playing the note by putting the PWM value in the timer compare register, and turing on the speaker
+            else {
+                TCCR1A |= _BV(COM1A1);   // make sure audio is turned on by turning on compare reg
+                OCR1A = PWMval * PWM_SCALE;  // set the PWM time to next value (that was calculated on the previous pass through the ISR)
+            }
+        }
+
+        // calculate the next PWM value (this value will be used next time we get a timer interrrupt)
+
+        // first, get the two values from the wavetable that we'll interpolating between
+        Wptr2 = WtabCount.integ + WtabDelta.integ;
+        temp = WtabCount.fract + WtabDelta.fract;
+        if ( temp >= 256) Wptr2 += 1;   // if both fractional parts add to 1 or more, get next byte in wavetable for Val2
+        if ( temp > 0) Wptr2 += 1;      // if there is a fractional part, get next byte in wavetable for Val2
+        Wptr1 = Wptr2 - 1;              // the first value is always the byte before the second value
+        if ( Wptr2 >= WTABSIZE) Wptr2 -= WTABSIZE;  // wrap around to the beginning of the wavetable if we reached the end of it
+        if ( Wptr1 >= WTABSIZE) Wptr1 -= WTABSIZE;  // wrap around to the beginning of the wavetable if we reached the end of it
+        WtabVal2 = pgm_read_byte(&wavPtr[Wptr2]);   // get the second value from the wavetable
+        WtabVal1 = pgm_read_byte(&wavPtr[Wptr1]);   // get the first value from the wavetable
+
+        // increment the Count by the Delta (fixed-point math)
+        WtabCount.integ += WtabDelta.integ;
+        temp = WtabCount.fract + WtabDelta.fract;  // we need to put this value in "temp" since "temp" is an int (16-bit value) and the fract parts of WtabCount and WtabDelta are 8-bit values
+        // if the fractional part became 1 or beyond, then increment the integ part and correct the fractional part
+        if ( temp >= 256 ) {                       // (256 is the equivalent of "1" for the fractional part)
+            WtabCount.integ += 1;
+            temp -= 256;
+        }
+        WtabCount.fract = temp;
+        // if the counter is beyond the end of the table, then wrap it around to the beginning of the table
+        if ( WtabCount.integ >= WTABSIZE) {
+            WtabCount.integ -= WTABSIZE;
+        }
+
+        // now interpolate between the two values
+        // NOTE: we are limited to WtabDelta between 1.0000 and 1.996 [ i.e. integ=1, fract=(0 to 255) ]
+        // this calculates the following:
+        //     if WtabVal2>WtabVal1:   PWMval = WtabVal1 + [(WtabVal2 - WtabVal1) * WtabCount]
+        //     if WtabVal2<=WtabVal1:  PWMval = WtabVal1 - [(WtabVal1 - WtabVal2) * WtabCount]
+        if (WtabVal2 > WtabVal1)
+            temp = (WtabVal2 - WtabVal1) * WtabCount.fract;
+        else
+            temp = (WtabVal1 - WtabVal2) * WtabCount.fract;
+        // round up if the fractional part of the result is 128 (80 hex) or more (i.e., "0.5" or more)
+        if ( (temp & 0x00ff) < 0x0080 )
+            temp = temp / 256;
+        else
+            temp = (temp / 256) + 1;
+        // update PWMval
+        if (WtabVal2 > WtabVal1)
+            PWMval = WtabVal1 + temp;
+        else
+            PWMval = WtabVal1 - temp;
+        if (PWMval < 0) PWMval = 0;    // PWM should never go below zero if the above math is good, but I put this check here just in case
+
+
+		/// next step is calculating the envelope, based on the note duration count
+		/// at special points of interest, we calculate the delta
+		//  inbetween these points, we modifiy the envelope value, setting it or by adding or substracting the delta
+		//Disp[9] = 0x00; // XXX Debug
+		if (Wdur == EnvPointStartAttack) {
+			// At the beginning, when starting the note, at the turnpoint before attack...
+			// we calculate the delta for the phase using fixed point math
+			tmpEnv = 64 * 256 / (EnvPointStartAttack - EnvPointStartDecay);
+			EnvDelta.integ = tmpEnv / 256;
+			EnvDelta.fract = tmpEnv - (EnvDelta.integ * 256);
+			//Disp[9] = 0x40; // XXX Debug
+		} else if (Wdur > EnvPointStartDecay) {
+			// During Attack we add the delta to the value (fixed-point math)
+			tmpEnv = EnvValue.fract + EnvDelta.fract;
+			EnvValue.integ = EnvValue.integ + EnvDelta.integ;
+			if (tmpEnv >= 256) {
+				EnvValue.integ += 1;
+				EnvValue.fract = tmpEnv - 256;
+			} else
+				EnvValue.fract = tmpEnv;
+			//Disp[9] = 0x20; // XXX Debug
+		} else if (Wdur == EnvPointStartDecay) {
+			// At the turnpoint inbetween Attack and Decay, we calculate the next delta
+			tmpEnv = ((64 - EnvelopeS) * 256) / (EnvPointStartDecay - EnvPointStartSustain);
+			EnvDelta.integ = tmpEnv / 256;
+			EnvDelta.fract = tmpEnv - (EnvDelta.integ * 256);
+			//Disp[9] = 0x10; // XXX Debug
+		} else if (Wdur > EnvPointStartSustain) {
+			// During decay, we substract the delta from the value (fixed-point math)
+			tmpEnv = EnvValue.fract - EnvDelta.fract;
+			EnvValue.integ = EnvValue.integ - EnvDelta.integ;
+			if (tmpEnv < 0) {
+				EnvValue.integ -= 1;
+				EnvValue.fract = tmpEnv + 256;
+			} else
+				EnvValue.fract = tmpEnv;
+			//Disp[9] = 0x08; // XXX Debug
+		} else if (Wdur > EnvPointStartRelease) {
+			// From the turnpoint Decay to Sustain, and during Sustain, we just set the envelopes
+			// value to the Sustain value
+			EnvValue.integ = EnvelopeS;
+			EnvValue.fract = 0;
+			//Disp[9] = 0x04; // XXX Debug
+		} else if (Wdur == EnvPointStartRelease) {
+			// At the turnpoint from Sustain to Release, we calculate the next delta
+			tmpEnv = (EnvelopeS * 256) / EnvPointStartRelease;
+			EnvDelta.integ = tmpEnv / 256;
+			EnvDelta.fract = tmpEnv - (EnvDelta.integ * 256);
+			//Disp[9] = 0x02; // XXX Debug
+		} else {
+			// During releases, we substract the delta from the value  (fixed-point math)
+			tmpEnv = EnvValue.fract - EnvDelta.fract;
+			EnvValue.integ = EnvValue.integ - EnvDelta.integ;
+			if (tmpEnv < 0) {
+				EnvValue.integ -= 1;
+				EnvValue.fract = tmpEnv + 256;
+			} else
+				EnvValue.fract = tmpEnv;
+			//Disp[9] = 0x01; // XXX Debug
+		}
+		// the result is rounded ...
+		if ((EnvValue.fract & 0x00FF) < 0x0080)
+				temp = EnvValue.integ;
+			else
+				temp = EnvValue.integ + 1;
+
+		// now we have the two parts that make out our sound - the PWMval, which contains the current "sample"
+		// of our selected waveform, and temp, which contains the current value for our envelope.
+		// The last step we need to do is to mix them.
+		// NOTE: we use 64 steps of resolution in the envelope, since /64 is just bitshifting, which is consideratebly
+		// faster that dividing through any "non-computer-friendly" value.
+		PWMval = ((PWMval * temp) / 64) & 0xFF;
+
+
+        // Wdur keeps track of the number of times through the ISR that we play a note (i.e., the duration of the sound)
+        // If the duration is completed for playing this note (i.e., Wdur < 0), then we'll add a short pause after it to separate it from the next note
+        if (Wdur > 0)                  // if the duration count is still above 0, then decrement it
+            Wdur--;
+        else {                         // else we have finished playing this note from the wavetable
+            // start a slight pause after the note (to distinguish it from the note to follow)
+            //if (Wnote_sep > 0) {                      // we'll keep playing no sound until we've gone through the ISR NOTE_SEP times, making a pause after playing the previously played note
+            //    Wnote_sep--;
+                //Disp[8] = 0x40;                     // XXX debug: turn on one pixel
+                //DDRB &= ~_BV(1);                      // turn off SPKR (OC1A) port
+            //}
+            // if we're done with note separation pause, then set up the next note to play for the next time through the ISR
+            //else {
+                //Wnote_sep = NOTE_SEP;                 // reset note separation value
+              	//DDRB |= _BV(1);                       // turn SPKR (OC1A) port back on
+                //Disp[8] = 0x00;                     // XXX debug: turn off the one pixel
+
+				// next time through the ISR we'll start playing the next note in the song table
+				// (or in the next song, see next_note())
+				next_note();
+           // }
+        }
+    }
+}
+
+
+// a simple API for making sounds.
+
+void initaudio(void)
+{
+	// default wavetable (WT_SAWTOOTH)
+	Sound.wav = SawWtable;
+	wavPtr = SawWtable;
+
+	// default tempo
+	//XXX
+	SongLoopFlag = 0;
+	SongPlayFlag = 0;
+	PWMval = pgm_read_byte(&wavPtr[0]);	// initialize to first entry of table
+
+	Sound.a = 0; 	// these envelope settings should produce the same sound as the miggl-version
+	Sound.d = 0; 	// without envelope
+	Sound.s = 63;
+	Sound.r = 0;
+	take_sound();
+}
+
+
+//
+// sets tempo for playnote function.
+// the default tempo is 72 beats per minute.
+//
+void settempo(byte bpm)
+{
+	// XXX NYI !!
+}
+
+
+//
+// wavetables are just arrays of samples that produce waveforms.
+// from the API all tables are just referenced by named constants.
+// WT_SAWTOOTH is the default.  it takes effect with the next note.
+//
+void setwavetable(byte wtable)
+{
+	const uint8_t* wav = NULL;
+
+	if (wtable == WT_SINE) {
+		wav = SineWtable;
+	} else if (wtable == WT_SAWTOOTH) {
+		wav = SawWtable;
+	} else if (wtable == WT_SQUARE) {
+		wav = SquareWtable;
+	}
+	if (wav != NULL) {
+		seq_write_begin(&SoundSeq);
+		Sound.wav = wav;
+		seq_write_end(&SoundSeq);
+	}
+}
+
+
+//
+// play a tone with pitch in Hz, and dur in ms.
+// the current wavetable is used.
+//
+void playsound(int pitch, int dur)
+{
+	// XXX NYI !!
+}
+
+
+// play a tone with pitch "note" (uses predefined constants like C4 for middle C) and
+// duration dur (predefined constants like N_QUARTER, etc.)
+// the current wavetable is used.
+//
+// XXX NYI !!
+void playnote(byte note, byte dur)
+{}
+
+
+//
+// sets the song loop flag. If 0, the song will not be looped, if != 0, the song will be played
+// on and on and on ... In case the song is currently looped and the flag is set to 0, the song
+// will be finished.  (a song from the queue brings its own flag, see queuesong().)
+//
+void loopsong(uint8_t flag)
+{
+	SongLoopFlag = flag;
+}
+
+//
+// R2Nx - this converts a ratio (e.g. 1.000) into a standard note (e.g. a frequency),
+// where "x" is the octave number (e.g. for middle C, x = 4).
+//
+// this is used to build the "note table" needed by the audio code.
+// the deltas were tuned at a 20khz sample rate, R2N_RATE keeps the pitch at others.
+//
+#define R2N_RATE		(20000.0 / AUDIO_RATE)
+
+#define R2N3(ratio)		(uint16_t)(ratio*64.0*R2N_RATE+0.5)
+
+//
+// convert ratio into "frequency" for audio code in ISR
+//
+#define R2N4(ratio)		(uint16_t)(ratio*128.0*R2N_RATE+0.5)
+
+//
+// octave higher than above (saves typing below)
+//
+#define R2N5(ratio)		(uint16_t)(ratio*256.0*R2N_RATE+0.5)
+
+//
+// table of "frequencies" for standard piano notes
+//
+// this table converts standard piano notes (e.g. N_C4) into 8.8 fixed point deltas
+//	used in the wavetable synthesis code.
+//
+// note: currently, to make the math simpler, notes are transposed a bit.
+//		for example, C5 is about 625 Hz when it really should be 523.251 Hz.  (off by about 3 half steps)
+//		but, the final pitches should be relatively accurate because they are based on ratios
+//
+// also see GETNOTEDELTA() macro which references NoteTab.
+//
+const uint16_t NoteTab[] PROGMEM = {
+R2N3(1.000),	// N_C3 - C3 (1 octave below middle C)
+R2N3(1.059),	// N_CS3
+R2N3(1.122),	// N_D3
+R2N3(1.189),	// N_DS3
+R2N3(1.260),	// N_E3
+R2N3(1.335),	// N_F3
+R2N3(1.414),	// N_FS3
+R2N3(1.498),	// N_G3
+R2N3(1.587),	// N_GS3
+R2N3(1.682),	// N_A3	- A3 (220 Hz)
+R2N3(1.782),	// N_AS3
+R2N3(1.888),	// N_B3
+
+R2N4(1.000),	// N_C4 - C4 (middle C)
+R2N4(1.059),	// N_CS4
+R2N4(1.122),	// N_D4
+R2N4(1.189),	// N_DS4
+R2N4(1.260),	// N_E4
+R2N4(1.335),	// N_F4
+R2N4(1.414),	// N_FS4
+R2N4(1.498),	// N_G4
+R2N4(1.587),	// N_GS4
+R2N4(1.682),	// N_A4	- A4 (440 Hz)
+R2N4(1.782),	// N_AS4
+R2N4(1.888),	// N_B4
+
+R2N5(1.000),	// N_C5	- C5 (1 octave above middle C)
+R2N5(1.059),	// N_CS5
+R2N5(1.122),	// N_D5
+R2N5(1.189),	// N_DS5
+R2N5(1.260),	// N_E5
+R2N5(1.335),	// N_F5
+R2N5(1.414),	// N_FS5
+R2N5(1.498),	// N_G5
+R2N5(1.587),	// N_GS5
+R2N5(1.682),	// N_A5	- A5 (880 Hz)
+R2N5(1.782),	// N_AS5
+R2N5(1.888),	// N_B5
+R2N5(2.000),	// N_C6	- C6 (2 octaves above middle C)
+};
+
+
+//
+// this table converts duration values (1..48) into the
+// actual number of ticks used by the audio code.
+// the table is loaded for a specific tempo (e.g. 75 bpm - beats [aka quarter note] per minute).
+//
+// design note:
+//	by using 48 values, instead of a power of two like 16, we can represent triplets.
+//	a quarter note (1 beat) is 12, an eighth note is 6, and an 8th triplet is 4.
+//
+//
+// note: remember to subtract 1 before indexing this table with a standard duration (1..48)
+//
+// XXX need to fill in ALL entries in this table!
+//	(just did the common ones, all the 0s are placeholders)
+//
+// also see GETDURATION() macro which references DurTab.
+//
+const uint16_t DurTab[48] PROGMEM = {
+0,0,TEMPOBEAT/4,TEMPOBEAT/3,0,TEMPOBEAT/2,
+0,0,0,0,0,TEMPOBEAT,
+0,0,0,0,0,0,
+0,0,0,0,0,TEMPOBEAT*2,
+
+0,0,0,0,0,0,
+0,0,0,0,0,TEMPOBEAT*3,
+0,0,0,0,0,0,
+0,0,0,0,0,TEMPOBEAT*4,
+};
+
+
+//
+// returns where a song loops to: after its N_LOOP, or its begin
+//
+static const uint8_t* song_loop(const uint8_t* song)
+{
+	const uint8_t* p = song;
+
+	while (pgm_read_byte(p) != N_END) {
+		if (pgm_read_byte(p) == N_LOOP)
+			return p + 1;
+		p += 2;
+	}
+	return song;
+}
+
+//
+// hands a song (or NULL, nothing) to the audio interrupt, to cut in with its next tick
+//
+static void song_request(const uint8_t* song)
+{
+	seq_write_begin(&SongCutSeq);
+	SongCut.begin = song;
+	SongCut.loop = song ? song_loop(song) : NULL;
+	SongCutHead = SongQueue.head;
+	seq_write_end(&SongCutSeq);
+	TIMSK1 |= _BV(TOIE1);
+}
+
+
+//
+// play a song, that is, a sequence of notes and durations.
+// this is passed an array of bytes in flash (PROGMEM), which is filled with note/duration
+// pairs, and must end with the byte N_END.  a looping song (see loopsong()) starts over
+// from its N_LOOP, if it has one, so the notes before it are a lead-in.
+//
+// the audio interrupt takes the song with its next tick, the song that is playing
+// stops there and the songs queued before are dropped.
+//
+void playsong(const byte *songtable)
+{
+	if (songtable == NULL) {		// error check
+		return;
+	}
+	song_request(songtable);
+}
+
+
+//
+// stops the song and drops the queue
+//
+void stopsong(void)
+{
+	song_request(NULL);
+}
+
+
+//
+// queues a song to follow the current one (or the ones queued before it) without a gap,
+// looped if loop != 0.  if no song plays it starts right away.  returns 0 if the queue
+// is full: SONG_QUEUE - 1 songs, three, wait behind the current one.
+//
+uint8_t queuesong(const byte *songtable, uint8_t loop)
+{
+	uint8_t h = SongQueue.head;
+
+	if ((songtable == NULL) || !ring_free(&SongQueue, SONG_QUEUE))
+		return 0;
+	SongNext[h].begin = songtable;
+	SongNext[h].loop = song_loop(songtable);
+	SongNext[h].looped = loop;
+	ring_put(&SongQueue, RING_NEXT(h, SONG_QUEUE));
+	TIMSK1 |= _BV(TOIE1);			// it starts the song if none plays
+	return 1;
+}
+
+
+//
+// this returns 1 if audio is playing (or about to), 0 otherwise.
+//
+byte isaudioplaying(void)
+{
+	if ((SongCutSeq != SongCutTaken) && (SongCut.begin != NULL))
+		return 1;
+	return SongPlayFlag || (SongQueue.head != SongQueue.tail);
+}
+
+
+// sets the envelope parameters for the sound generator.
+//
+// a, d and r together must be smaller that 256, since the represent each a 1/256th of the note length
+// if the sum is smaller, the rest will be used for the sustain
+// s must be >= 0 and < 64
+//
+// if a note is currently played, these settings will take effect when the next note starts.
+//
+void setenvelope (uint8_t a, uint8_t d, uint8_t s, uint8_t r) {
+	if ((a + d + r < 256) && (d < 64)) {
+		seq_write_begin(&SoundSeq);
+		Sound.a = a;
+		Sound.d = d;
+		Sound.s = s;
+		Sound.r = r;
+		seq_write_end(&SoundSeq);
+	}
+}
+
+
+//
+// plays a sound effect over the song, e points to its first record in flash (see
+// struct sfx in miggl.h).  the song goes on unheard while the effect plays.  an effect
+// that is playing stops; the audio interrupt takes e with its next tick.
+//
+// the effect costs the interrupt one 16 bit add, a compare or two and the write of
+// OCR1A per tick, the noise a shift and an xor more when its phase goes around.  once
+// per SFX_CONTROL ticks another add, the decay (a shift and a subtract) and the end of
+// the record.  only the start of a record reads flash, and none of it multiplies.
+// (host/microbench times it as sfx_tick, sim/isrprof -w sfx in the simulator.)
+//
+void sfx_play(const struct sfx* e)
+{
+	seq_write_begin(&SfxSeq);
+	SfxRequest = e;
+	seq_write_end(&SfxSeq);
+	TIMSK1 |= _BV(TOIE1);			// it turns itself off again if there is nothing
+}
+
+//
+// stops the effect, the song is heard again
+//
+void sfx_stop(void)
+{
+	sfx_play(NULL);
+}
+
+//
+// returns 1 while an effect plays (or is about to), 0 otherwise
+//
+uint8_t sfx_playing(void)
+{
+	if (SfxSeq != SfxTaken)
+		return SfxRequest != NULL;
+	return SfxPlaying;
+}
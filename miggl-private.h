@@ -46,7 +46,44 @@
 // this is the size of all wave tables (in bytes) - seriously, don't change this!
 #define WTABSIZE 32
 
-#define TEMPOCONST 		1200000						// 20,000Hz * 60 sec
+/* clock-related defs, all computed from F_CPU (miggl.h) */
+
+// the audio sample rate: timer1 counts at F_CPU/8 and overflows (the audio interrupt)
+// every AUDIO_TOP + 1 counts.  it is the same at every clock, so a faster clock leaves
+// more of its cycles to the game.
+#define AUDIO_RATE		20000UL
+#define AUDIO_TOP		(F_CPU / 8 / AUDIO_RATE - 1)		// ICR1: 49 at 8MHz, 99 at 16MHz
+
+// the wave tables go from 0 to 49, for the 50 counts of the PWM at 8MHz
+#define PWM_SCALE		((AUDIO_TOP + 1) / 50)
+
+#if (F_CPU / 8) % AUDIO_RATE
+#error "F_CPU / 8 must be a multiple of AUDIO_RATE"
+#endif
+#if PWM_SCALE < 1
+#error "F_CPU is too slow for the audio, it needs at least 8MHz"
+#endif
+
+// the display shows a row for 1ms: timer2 counts ROW_COUNTS (at most 256) per row, at
+// F_CPU/DISPLAY_PRESCALE, so a count is 8us at 8MHz, 4us at 16MHz and 6.4us at 20MHz
+// (the prescaler grows with the clock).  DISPLAY_CS are its clock select bits.
+#define ROW_RATE		1000UL
+#if F_CPU / 64 / ROW_RATE <= 256
+#define DISPLAY_PRESCALE	64
+#define DISPLAY_CS		_BV(CS22)
+#elif F_CPU / 128 / ROW_RATE <= 256
+#define DISPLAY_PRESCALE	128
+#define DISPLAY_CS		(_BV(CS22) | _BV(CS20))
+#else
+#define DISPLAY_PRESCALE	256
+#define DISPLAY_CS		(_BV(CS22) | _BV(CS21))
+#endif
+#define ROW_COUNTS		(F_CPU / DISPLAY_PRESCALE / ROW_RATE)
+
+// the audio samples (50us) of a row, the unit of frameticksleft()
+#define ROW_TICKS		(AUDIO_RATE / ROW_RATE)
+
+#define TEMPOCONST 		(AUDIO_RATE * 60)			// audio samples per minute
 
 #define DEFAULTTEMPO	120.0						// default tempo in BPM (usually 75.0)
 
@@ -62,9 +99,9 @@ struct fixedPtNum {
 };
 
 
-// XXX fix.. these should be hidden (static) inside miggl.c
-extern uint16_t NoteTab[];
-extern uint16_t DurTab[];
+// XXX fix.. these should be hidden (static) inside miggl-audio.c.  they are in flash.
+extern const uint16_t NoteTab[] PROGMEM;
+extern const uint16_t DurTab[] PROGMEM;
 
 
 //
@@ -73,9 +110,12 @@ extern uint16_t DurTab[];
 //
 // note: we use MIN_NOTE constant here to save bytes in NoteTab table.
 //
-#define GETNOTEDELTA(note)		(NoteTab[note-MIN_NOTE])
+#define GETNOTEDELTA(note)		pgm_read_word(&NoteTab[note-MIN_NOTE])
 
 //
 // convert standard duration constants (e.g. N_QUARTER) into actual ticks used by audio code
 //
-#define GETDURATION(dur)		(DurTab[dur-1])
+#define GETDURATION(dur)		pgm_read_word(&DurTab[dur-1])
+
+// the audio part of the timer 1 interrupt (miggl-audio.c), the interrupt is in miggl.c
+void do_audio_isr(void);
@@ -13,6 +13,8 @@
  *	hardware setup:
  *		- Mignonette v2.0 PROTOTYPE
  *
+ *	the songs, the sound effects and do_audio_isr() are in miggl-audio.c.
+ *
  *	TODO:
  *
  *	- clean up initialization.. there should be one function miggl_init() or something like that.
@@ -23,11 +25,11 @@
  *	- really need to get rid of 48 entry duration table
  *		(use another counter and only re-calculate the 1/48 entry when tempo changes)
  *
- *	- could move wavetables into program memory (to save RAM)
- *
  *	- (as of may 17) do_audio_isr takes about 40-44% of the ISR's full duty cycle.
  *		the display part takes an additional 12-14%.
- *		tuning opportunity!
+ *		tuning opportunity!  (sim/isrprof measures it in simavr)
+ *		the display has its own, slower timer now, and the audio interrupt only runs
+ *		while a song or a sound effect plays.
  *
  *
  *	revision history:
@@ -122,8 +124,9 @@
 
 #include "miggl.h"
 #include "miggl-private.h"
+#include "isrsafe.h"
 
-// for _delay_us() macro  (note: this gets F_CPU define from miggl.h)
+// for _delay_us() macro  (note: this gets F_CPU define from the Makefile or miggl.h)
 #include <util/delay.h>
 
 
@@ -147,118 +150,47 @@ byte ButtonAEvent;
 byte ButtonBEvent;
 byte ButtonCEvent;
 byte ButtonDEvent;
-
-
-// globals for audio here
-
-// sawtooth wavetable (TOP=49) (updated table from Mitch)
-static uint8_t SawWtable[WTABSIZE] = {
-  0,   2,   3,   5,
-  6,   8,   9,  11,
- 13,  14,  16,  17,
- 19,  21,  22,  24,
- 25,  27,  28,  30,
- 32,  33,  35,  36,
- 38,  40,  41,  43,
- 44,  46,  47,  49,
-};
-
-
-// sinewave wavetable (TOP=49)
-static uint8_t SineWtable[WTABSIZE] = {
-  25, 29, 34, 38,
-  42, 45, 47, 49,
-  49, 49, 47, 45,
-  42, 38, 34, 29,
-  25, 20, 15, 11,
-   7,  4,  2,  0,
-   0,  0,  2,  4,
-   7, 11, 15, 20,
-};
-
-// squarewave wavetable (TOP=49)
-static uint8_t SquareWtable[WTABSIZE] = {
-  0,   0,   0,   0,
-  0,   0,   0,   0,
-  0,   0,   0,   0,
-  0,   0,   0,   0,
- 49,  49,  49,  49,
- 49,  49,  49,  49,
- 49,  49,  49,  49,
- 49,  49,  49,  49,
-};
+byte ButtonDrops;		// presses that came and went between two calls of handlebuttons()
 
 
 // globals for display/refresh here:
 
-static volatile uint8_t Rcount = 20;
+#ifdef TELEMETRY
+static volatile uint8_t IsrTimeMax;		// longest timer interrupt since isrtime() (8 cycle units)
+static volatile uint16_t IsrTimeAvg;	// average, times 16
+static seqcount_t IsrTimeSeq;			// counted up by the audio interrupt after it wrote them
+static struct isr_events IsrTimeReset;	// raised by isrtime(), the interrupt clears IsrTimeMax
+#endif
+
+#ifdef PROFILE
+static volatile uint16_t ProfRows;		// display interrupts so far, the time base of prof_now()
+static uint32_t ProfStart[PROF_SCOPES];	// prof_now() at prof_start()
+static uint32_t FrameStart;				// prof_now() at the end of the last swapbuffers()
+struct prof_scope ProfScope[PROF_SCOPES];
+uint16_t FrameHist[FRAME_BINS];
+uint16_t FrameMissed;
+#endif
 
 
 volatile uint8_t Disp[10];		// the display buffer (7 x 5 pixels ==> 10 rows of 7 pixels each, right-justified)
 
+#ifdef PALETTE
+// with PALETTE the display buffer holds palette indices (0 - 3, in the bits of the colors),
+// the interrupt shows them as the colors of the palette.  bit i of PalGreen and PalRed
+// is set if index i lights up the green or red LED.
+static uint8_t Palette[4] = { BLACK, RED, GREEN, YELLOW };
+static volatile uint8_t PalGreen = 0x0C;
+static volatile uint8_t PalRed = 0x0A;
+#endif
+
 volatile uint8_t		CurRow;		// next display buffer row (of 5) to display
 
-volatile uint8_t 	SwapRelease;	// flag (1 bit)
+static struct isr_events SwapRelease;	// SWAP_RELEASE is raised at the end of a display cycle
 volatile uint8_t	SwapCounter;
-uint8_t				SwapInterval;
-
+volatile uint8_t	SwapInterval;
+static seqcount_t	DispSeq;		// counted up by the display interrupt after every row (CurRow, SwapCounter, ProfRows)
 
-// globals for audio here
-
-//const uint8_t* wavTables[];  // table of addresses of different waveform tables (SINE, SAW, TRIANGLE, SQUARE, WEIRD)
-uint8_t* wavPtr;                    // this points to the currently active waveform
-
-uint16_t Wdur;        // duration for playing notes (these are in units of 50usec) -- initialize for 75 bpm (beats per minute)
-uint16_t Wnote_sep;   // small pause at end of each note (these are in units of 50usec)
-
-uint16_t DurTab[];    // table of durations for notes to play (48 durations)
-
-//extern const uint8_t* songTables[]; // table of addresses of different waveform tables (SINE, SAW, TRIANGLE, SQUARE, WEIRD)
-uint8_t* songPtr;				// this points into to the current song table
-uint8_t* songBeginPtr;			// this points to the begin of the current song table
-uint8_t  SongLoopFlag;			// if != 0, the song will be looped forever
-
-
-
-//volatile uint16_t StabPtr;     // song table pointer -- initialized to beginning of table
-
-volatile uint8_t CurNote;         // keeps track of note to play next time through the ISR
-
-volatile uint8_t SongPlayFlag; // song play flag is 0 when not playing a song from song table, 1 while playing a song
-
-//volatile int PWMval;           // this is the value that goes into 0CR1A (initialized to first value in wave table)
-int PWMval;           // this is the value that goes into 0CR1A (initialized to first value in wave table)
-
-// WtabCount acts as a pointer through the wavetable as if there were a continuous wavetable, rather than just 32 discreet bytes
-// WtabDelta is the amount to increment the WtabCount to get the next value from the wavetable
-// fixed point number -- the integer part is as expected, the fractional part is a number divided by 256
-//
-// XXX note: should these be volatile?  -rolf
-//
-struct fixedPtNum WtabDelta;  // with this version of firmware we're limited to values between 1.000 and 1.996 (integ part always = 1)
-struct fixedPtNum WtabCount;
-
-// WtabCount acts as a pointer through the wavetable as if there were a continuous wavetable, rather than just 32 discreet bytes
-// WtabDelta is the amount to increment the WtabCount to get the next value from the wavetable
-// fixed point number -- the integer part is as expected, the fractional part is a number divided by 256
-//
-// XXX note: should these be volatile?  -rolf
-//
-struct fixedPtNum WtabDelta;  // with this version of firmware we're limited to values between 1.000 and 1.996 (integ part always = 1)
-struct fixedPtNum WtabCount;
-
-volatile uint8_t EnvelopeA; // represents 1/256 of the overall length
-volatile uint8_t EnvelopeD; // represents 1/256 of the overall length
-volatile uint8_t EnvelopeS; // the fixed level of the sustain, must be >= 0 and < 63
-volatile uint8_t EnvelopeR; // represents 1/256 of the overall length
-
-volatile uint16_t EnvPointStartAttack; 	// the position of the note where the attack begins
-volatile uint16_t EnvPointStartDecay; 	// the position of the note where the decay begins
-volatile uint16_t EnvPointStartSustain; // the position of the note where the sustain begins
-volatile uint16_t EnvPointStartRelease; // the position of the note where the release begins
-
-struct fixedPtNum EnvValue;	// the current value of the envelope
-struct fixedPtNum EnvDelta;	// the delta of the envelope (steepness)
+#define SWAP_RELEASE	0x01
 
 //
 // Random number generator functions
@@ -283,223 +215,13 @@ void initrandom (void) {
 		RandomSeedB += (*addr);
 }
 
-
-//
-// audio portion of timer ISR
-//
-// (based on Mitch's ISR code from mig-testrefresh.c of 5/2/2008)
-//
-void do_audio_isr(void)
-{
-    uint8_t WtabVal1;   // two values from the wavetable between which we will interpolate
-    uint8_t WtabVal2;
-    uint16_t Wptr1;     // pointer to first value in wavetable
-    uint16_t Wptr2;     // pointer to second value in wavetable
-    uint16_t temp;
-    int16_t tmpEnv;		// temp value for envelope calculation
-
-    // The PWM value is loaded into the timer compare register at the beginning of the ISR if we are playing a song.
-    // This PWM value was calculated in the previous pass through the ISR.
-
-    // turn off audio if we have played the last note in the song table in the last pass through the ISR
-    if ( CurNote == N_END ) {                  // if we reached the end of the song table
-
-    	if ((SongLoopFlag != 0) && (songBeginPtr != NULL)) { // if the want to loop the song,
-			playsong(songBeginPtr);							 // restart it.
-			return;
-		} // if not, ...
-
-        SongPlayFlag = 0;                 // stop playing song when reach end of song table
-        TCCR1A &= ~_BV(COM1A1);           // turn off audio by turning off compare
-        //CurNote = 0;
-    }
-
-    // if we are playing a song, then calculate the PWM value to play the next time we get into the ISR
-    if (SongPlayFlag) {          // only handle audio if we're playing a song (SongPlayFlag is set by main to start playing audio, and it is cleared by ISR when all events in active song table are completed)
-
-        // if the Note to play is a Rest, then turn the speaker off
-        if ( CurNote == N_REST )
-            TCCR1A &= ~_BV(COM1A1);  // turn off audio by turning off compare
-        // otherwise, start playing the note by putting the PWM value in the timer compare register, and turing on the speaker
-        else {
-            TCCR1A |= _BV(COM1A1);   // make sure audio is turned on by turning on compare reg
-            OCR1A = PWMval;          // set the PWM time to next value (that was calculated on the previous pass through the ISR)
-        }
-
-        // calculate the next PWM value (this value will be used next time we get a timer interrrupt)
-
-        // first, get the two values from the wavetable that we'll interpolating between
-        Wptr2 = WtabCount.integ + WtabDelta.integ;
-        temp = WtabCount.fract + WtabDelta.fract;
-        if ( temp >= 256) Wptr2 += 1;   // if both fractional parts add to 1 or more, get next byte in wavetable for Val2
-        if ( temp > 0) Wptr2 += 1;      // if there is a fractional part, get next byte in wavetable for Val2
-        Wptr1 = Wptr2 - 1;              // the first value is always the byte before the second value
-        if ( Wptr2 >= WTABSIZE) Wptr2 -= WTABSIZE;  // wrap around to the beginning of the wavetable if we reached the end of it
-        if ( Wptr1 >= WTABSIZE) Wptr1 -= WTABSIZE;  // wrap around to the beginning of the wavetable if we reached the end of it
-        WtabVal2 = wavPtr[Wptr2];       // get the second value from the wavetable
-        WtabVal1 = wavPtr[Wptr1];       // get the first value from the wavetable
-
-        // increment the Count by the Delta (fixed-point math)
-        WtabCount.integ += WtabDelta.integ;
-        temp = WtabCount.fract + WtabDelta.fract;  // we need to put this value in "temp" since "temp" is an int (16-bit value) and the fract parts of WtabCount and WtabDelta are 8-bit values
-        // if the fractional part became 1 or beyond, then increment the integ part and correct the fractional part
-        if ( temp >= 256 ) {                       // (256 is the equivalent of "1" for the fractional part)
-            WtabCount.integ += 1;
-            temp -= 256;
-        }
-        WtabCount.fract = temp;
-        // if the counter is beyond the end of the table, then wrap it around to the beginning of the table
-        if ( WtabCount.integ >= WTABSIZE) {
-            WtabCount.integ -= WTABSIZE;
-        }
-
-        // now interpolate between the two values
-        // NOTE: we are limited to WtabDelta between 1.0000 and 1.996 [ i.e. integ=1, fract=(0 to 255) ]
-        // this calculates the following:
-        //     if WtabVal2>WtabVal1:   PWMval = WtabVal1 + [(WtabVal2 - WtabVal1) * WtabCount]
-        //     if WtabVal2<=WtabVal1:  PWMval = WtabVal1 - [(WtabVal1 - WtabVal2) * WtabCount]
-        if (WtabVal2 > WtabVal1)
-            temp = (WtabVal2 - WtabVal1) * WtabCount.fract;
-        else
-            temp = (WtabVal1 - WtabVal2) * WtabCount.fract;
-        // round up if the fractional part of the result is 128 (80 hex) or more (i.e., "0.5" or more)
-        if ( (temp & 0x00ff) < 0x0080 )
-            temp = temp / 256;
-        else
-            temp = (temp / 256) + 1;
-        // update PWMval
-        if (WtabVal2 > WtabVal1)
-            PWMval = WtabVal1 + temp;
-        else
-            PWMval = WtabVal1 - temp;
-        if (PWMval < 0) PWMval = 0;    // PWM should never go below zero if the above math is good, but I put this check here just in case
-
-
-		/// next step is calculating the envelope, based on the note duration count
-		/// at special points of interest, we calculate the delta
-		//  inbetween these points, we modifiy the envelope value, setting it or by adding or substracting the delta
-		//Disp[9] = 0x00; // XXX Debug
-		if (Wdur == EnvPointStartAttack) {
-			// At the beginning, when starting the note, at the turnpoint before attack...
-			// we calculate the delta for the phase using fixed point math
-			tmpEnv = 64 * 256 / (EnvPointStartAttack - EnvPointStartDecay);
-			EnvDelta.integ = tmpEnv / 256;
-			EnvDelta.fract = tmpEnv - (EnvDelta.integ * 256);
-			//Disp[9] = 0x40; // XXX Debug
-		} else if (Wdur > EnvPointStartDecay) {
-			// During Attack we add the delta to the value (fixed-point math)
-			tmpEnv = EnvValue.fract + EnvDelta.fract;
-			EnvValue.integ = EnvValue.integ + EnvDelta.integ;
-			if (tmpEnv >= 256) {
-				EnvValue.integ += 1;
-				EnvValue.fract = tmpEnv - 256;
-			} else
-				EnvValue.fract = tmpEnv;
-			//Disp[9] = 0x20; // XXX Debug
-		} else if (Wdur == EnvPointStartDecay) {
-			// At the turnpoint inbetween Attack and Decay, we calculate the next delta
-			tmpEnv = ((64 - EnvelopeS) * 256) / (EnvPointStartDecay - EnvPointStartSustain);
-			EnvDelta.integ = tmpEnv / 256;
-			EnvDelta.fract = tmpEnv - (EnvDelta.integ * 256);
-			//Disp[9] = 0x10; // XXX Debug
-		} else if (Wdur > EnvPointStartSustain) {
-			// During decay, we substract the delta from the value (fixed-point math)
-			tmpEnv = EnvValue.fract - EnvDelta.fract;
-			EnvValue.integ = EnvValue.integ - EnvDelta.integ;
-			if (tmpEnv < 0) {
-				EnvValue.integ -= 1;
-				EnvValue.fract = tmpEnv + 256;
-			} else
-				EnvValue.fract = tmpEnv;
-			//Disp[9] = 0x08; // XXX Debug
-		} else if (Wdur > EnvPointStartRelease) {
-			// From the turnpoint Decay to Sustain, and during Sustain, we just set the envelopes
-			// value to the Sustain value
-			EnvValue.integ = EnvelopeS;
-			EnvValue.fract = 0;
-			//Disp[9] = 0x04; // XXX Debug
-		} else if (Wdur == EnvPointStartRelease) {
-			// At the turnpoint from Sustain to Release, we calculate the next delta
-			tmpEnv = (EnvelopeS * 256) / EnvPointStartRelease;
-			EnvDelta.integ = tmpEnv / 256;
-			EnvDelta.fract = tmpEnv - (EnvDelta.integ * 256);
-			//Disp[9] = 0x02; // XXX Debug
-		} else {
-			// During releases, we substract the delta from the value  (fixed-point math)
-			tmpEnv = EnvValue.fract - EnvDelta.fract;
-			EnvValue.integ = EnvValue.integ - EnvDelta.integ;
-			if (tmpEnv < 0) {
-				EnvValue.integ -= 1;
-				EnvValue.fract = tmpEnv + 256;
-			} else
-				EnvValue.fract = tmpEnv;
-			//Disp[9] = 0x01; // XXX Debug
-		}
-		// the result is rounded ...
-		if ((EnvValue.fract & 0x00FF) < 0x0080)
-				temp = EnvValue.integ;
-			else
-				temp = EnvValue.integ + 1;
-
-		// now we have the two parts that make out our sound - the PWMval, which contains the current "sample"
-		// of our selected waveform, and temp, which contains the current value for our envelope.
-		// The last step we need to do is to mix them.
-		// NOTE: we use 64 steps of resolution in the envelope, since /64 is just bitshifting, which is consideratebly
-		// faster that dividing through any "non-computer-friendly" value.
-		PWMval = ((PWMval * temp) / 64) & 0xFF;
-
-
-        // Wdur keeps track of the number of times through the ISR that we play a note (i.e., the duration of the sound)
-        // If the duration is completed for playing this note (i.e., Wdur < 0), then we'll add a short pause after it to separate it from the next note
-        if (Wdur > 0)                  // if the duration count is still above 0, then decrement it
-            Wdur--;
-        else {                         // else we have finished playing this note from the wavetable
-            // start a slight pause after the note (to distinguish it from the note to follow)
-            //if (Wnote_sep > 0) {                      // we'll keep playing no sound until we've gone through the ISR NOTE_SEP times, making a pause after playing the previously played note
-            //    Wnote_sep--;
-                //Disp[8] = 0x40;                     // XXX debug: turn on one pixel
-                //DDRB &= ~_BV(1);                      // turn off SPKR (OC1A) port
-            //}
-            // if we're done with note separation pause, then set up the next note to play for the next time through the ISR
-            //else {
-            	uint16_t tmp;
-				uint8_t note, dur;
-
-                //Wnote_sep = NOTE_SEP;                 // reset note separation value
-              	//DDRB |= _BV(1);                       // turn SPKR (OC1A) port back on
-                //Disp[8] = 0x00;                     // XXX debug: turn off the one pixel
-
-				// next time through the ISR we'll start playing the next note in the song table
-
-				// note: this code is repeated inside playsong() - must match!!
-				note = *songPtr++;
-				tmp = GETNOTEDELTA(note);
-				WtabDelta.integ = (uint8_t)((tmp >> 8) & 0xff);		// high byte
-				WtabDelta.fract = (uint8_t)(tmp & 0xff);			// low byte
-				dur = *songPtr++;
-				CurNote = note;						// set 1st note to play, and
-				Wdur = GETDURATION(dur);   			// its duration.
-
-				EnvPointStartAttack  = Wdur;	// calculates the positions for the envelope parts
-				EnvPointStartDecay   = EnvPointStartAttack - (Wdur / 256 * EnvelopeA);
-				EnvPointStartSustain = EnvPointStartDecay  - (Wdur / 256 * EnvelopeD);
-				EnvPointStartRelease = (Wdur / 256 * EnvelopeR);
-				EnvValue.integ = 0;
-				EnvValue.fract = 0;
-				EnvDelta.integ = 0;
-				EnvDelta.fract = 0;
-           // }
-        }
-    }
-}
-
 //
 // internal switch status
 // note: bits 0-3 contain most recent switch status (1=pressed, 0=not pressed)
 //
-static uint8_t _buttonmask = 0x0;
+static volatile uint8_t _buttonmask = 0x0;
 
-static uint8_t _buttoneventmask = 0x0;
+static struct isr_events _buttonevents;		// a bit is raised when its switch is pressed
 
 //
 //	switch polling algorithm:
@@ -562,7 +284,7 @@ poll_switches()
 		mask |= 0x8;
 	}
 
-	_buttoneventmask |= ~_buttonmask & mask;		// an event is when previous bit is 0, and new bit is 1
+	events_raise(&_buttonevents, ~_buttonmask & mask);		// an event is when previous bit is 0, and new bit is 1
 
 	_buttonmask = mask;
 
@@ -576,171 +298,349 @@ poll_switches()
 }
 
 
+//
+// the audio interrupt, at the sample rate (AUDIO_RATE, 20khz).  it only runs while a song or an
+// effect plays: playsong() and sfx_play() turn it on, do_audio_isr() off when there is nothing to play.
+//
 ISR(TIMER1_OVF_vect)
 {
-
-	// first, handle audio
 	do_audio_isr();
 
+#ifdef TELEMETRY
+	// the timer has counted (in 8 cycle steps) since the overflow that started us
+	uint8_t t = TCNT1;
+	if (events_take(&IsrTimeReset, 1))
+		IsrTimeMax = 0;
+	if (t > IsrTimeMax)
+		IsrTimeMax = t;
+	IsrTimeAvg += t - (IsrTimeAvg >> 4);
+	seq_publish(&IsrTimeSeq);
+#endif
+}
 
-	// next, handle the display
 
-	if (--Rcount == 0) {		// do we display a new row this time?  (only every 20 or so)
-		Rcount = 20;
+#ifdef PALETTE
+//
+// returns the LEDs of a row of the display (0 - 4 green, 5 - 9 red) for the indices in
+// the display buffer: the pixels of each index, if the palette lights the LED for it.
+//
+static inline uint8_t palette_row(uint8_t row)
+{
+	uint8_t g, r, sel, bits = 0;
 
-		//
-		// we display green columns (5) followed by the red columns (5).
-		// each will stay on for "Rcount" ticks (20 ticks is about 1ms).
-		//
-		switch (CurRow) {
-			case 0:
-				output_low(RC5);
-				poll_switches();
-				//PORTD = Disp[0] | 0x80;
-				if (Disp[0] & 0x1) {
-					PORTD = Disp[0] | 0x80;
-				} else {
-					PORTD = Disp[0];
-				}
-				output_high(GC1);
-				break;
-
-			case 1:
-				output_low(GC1);
-				//PORTD = Disp[1] | 0x80;
-				if (Disp[1] & 0x1) {
-					PORTD = Disp[1] | 0x80;
-				} else {
-					PORTD = Disp[1];
-				}
-				output_high(GC2);
-				break;
-
-			case 2:
-				output_low(GC2);
-				//PORTD = Disp[2] | 0x80;
-				if (Disp[2] & 0x1) {
-					PORTD = Disp[2] | 0x80;
-				} else {
-					PORTD = Disp[2];
-				}
-				output_high(GC3);
-				break;
-
-			case 3:
-				output_low(GC3);
-				//PORTD = Disp[3] | 0x80;
-				if (Disp[3] & 0x1) {
-					PORTD = Disp[3] | 0x80;
-				} else {
-					PORTD = Disp[3];
-				}
-				output_high(GC4);
-				break;
-
-			case 4:
-				output_low(GC4);
-				//PORTD = Disp[4] | 0x80;
-				if (Disp[4] & 0x1) {
-					PORTD = Disp[4] | 0x80;
-				} else {
-					PORTD = Disp[4];
-				}
-				output_high(GC5);
-				break;
-
-			case 5:
-				output_low(GC5);
-				//PORTD = Disp[5] | 0x80;
-				if (Disp[5] & 0x1) {
-					PORTD = Disp[5] | 0x80;
-				} else {
-					PORTD = Disp[5];
-				}
-				output_high(RC1);
-				break;
-
-			case 6:
-				output_low(RC1);
-				//PORTD = Disp[6] | 0x80;
-				if (Disp[6] & 0x1) {
-					PORTD = Disp[6] | 0x80;
-				} else {
-					PORTD = Disp[6];
-				}
-				output_high(RC2);
-				break;
-
-			case 7:
-				output_low(RC2);
-				//PORTD = Disp[7] | 0x80;
-				if (Disp[7] & 0x1) {
-					PORTD = Disp[7] | 0x80;
-				} else {
-					PORTD = Disp[7];
-				}
-				output_high(RC3);
-				break;
-
-			case 8:
-				output_low(RC3);
-				//PORTD = Disp[8] | 0x80;
-				if (Disp[8] & 0x1) {
-					PORTD = Disp[8] | 0x80;
-				} else {
-					PORTD = Disp[8];
-				}
-				output_high(RC4);
-				break;
-
-			case 9:
-				output_low(RC4);
-				//PORTD = Disp[9] | 0x80;
-				if (Disp[9] & 0x1) {
-					PORTD = Disp[9] | 0x80;
-				} else {
-					PORTD = Disp[9];
-				}
-				output_high(RC5);
-				break;
+	if (row < 5) {
+		sel = PalGreen;
+	} else {
+		sel = PalRed;
+		row -= 5;
+	}
+	g = Disp[row];
+	r = Disp[row+5];
+	if (sel & 0x1)
+		bits |= ~(g | r);		// index 0 (BLACK)
+	if (sel & 0x2)
+		bits |= r & ~g;			// index 1 (RED)
+	if (sel & 0x4)
+		bits |= g & ~r;			// index 2 (GREEN)
+	if (sel & 0x8)
+		bits |= g & r;			// index 3 (YELLOW)
+	return bits & 0x7F;
+}
+#endif
 
-		}	// switch
 
+//
+// the display interrupt, one row each time (1khz, see start_timer2()).  it is slower
+// than the audio and only runs when a row is due, and the audio may interrupt it while
+// it reads the switches, so the audio samples come on time.
+// note: so may the UART's (uart.c, with LINK or TELEMETRY), one interrupt at a time.
+//	they all run on top of this one's stack, see stack.isr in perf-budget.sh.
+//
+ISR(TIMER2_COMPA_vect)
+{
+#ifdef PALETTE
+	uint8_t bits = palette_row(CurRow);
+#else
+	uint8_t bits = Disp[CurRow];
+#endif
 
-		CurRow++;
-		if (CurRow >= 10) {
-			CurRow = 0;
-			if (--SwapCounter == 0) {			// we count down display cycles...
-				SwapCounter = SwapInterval;
-				SwapRelease = 1;				// now mark the end of the display cycle
+	//
+	// we display green columns (5) followed by the red columns (5).
+	// each will stay on until the next interrupt (1ms).
+	//
+	switch (CurRow) {
+		case 0:
+			output_low(RC5);
+			// the switches take a while, so the audio interrupt (or the UART's) may come in meanwhile
+			// (this one must not, it is turned off until they are read).  nothing else
+			// touches PORTD, DDRC, SWCOM and GC1-GC4, so the sequence on the pins stays.
+			TIMSK2 &= ~_BV(OCIE2A);
+			sei();
+			poll_switches();
+			cli();
+			TIMSK2 |= _BV(OCIE2A);
+			//PORTD = bits | 0x80;
+			if (bits & 0x1) {
+				PORTD = bits | 0x80;
+			} else {
+				PORTD = bits;
+			}
+			output_high(GC1);
+			break;
+
+		case 1:
+			output_low(GC1);
+			//PORTD = bits | 0x80;
+			if (bits & 0x1) {
+				PORTD = bits | 0x80;
+			} else {
+				PORTD = bits;
+			}
+			output_high(GC2);
+			break;
+
+		case 2:
+			output_low(GC2);
+			//PORTD = bits | 0x80;
+			if (bits & 0x1) {
+				PORTD = bits | 0x80;
+			} else {
+				PORTD = bits;
+			}
+			output_high(GC3);
+			break;
+
+		case 3:
+			output_low(GC3);
+			//PORTD = bits | 0x80;
+			if (bits & 0x1) {
+				PORTD = bits | 0x80;
+			} else {
+				PORTD = bits;
+			}
+			output_high(GC4);
+			break;
+
+		case 4:
+			output_low(GC4);
+			//PORTD = bits | 0x80;
+			if (bits & 0x1) {
+				PORTD = bits | 0x80;
+			} else {
+				PORTD = bits;
+			}
+			output_high(GC5);
+			break;
+
+		case 5:
+			output_low(GC5);
+			//PORTD = bits | 0x80;
+			if (bits & 0x1) {
+				PORTD = bits | 0x80;
+			} else {
+				PORTD = bits;
+			}
+			output_high(RC1);
+			break;
+
+		case 6:
+			output_low(RC1);
+			//PORTD = bits | 0x80;
+			if (bits & 0x1) {
+				PORTD = bits | 0x80;
+			} else {
+				PORTD = bits;
+			}
+			output_high(RC2);
+			break;
+
+		case 7:
+			output_low(RC2);
+			//PORTD = bits | 0x80;
+			if (bits & 0x1) {
+				PORTD = bits | 0x80;
+			} else {
+				PORTD = bits;
+			}
+			output_high(RC3);
+			break;
+
+		case 8:
+			output_low(RC3);
+			//PORTD = bits | 0x80;
+			if (bits & 0x1) {
+				PORTD = bits | 0x80;
+			} else {
+				PORTD = bits;
 			}
+			output_high(RC4);
+			break;
+
+		case 9:
+			output_low(RC4);
+			//PORTD = bits | 0x80;
+			if (bits & 0x1) {
+				PORTD = bits | 0x80;
+			} else {
+				PORTD = bits;
+			}
+			output_high(RC5);
+			break;
+
+	}	// switch
+
+
+	CurRow++;
+	if (CurRow >= 10) {
+		CurRow = 0;
+		if (--SwapCounter == 0) {			// we count down display cycles...
+			SwapCounter = SwapInterval;
+			events_raise(&SwapRelease, SWAP_RELEASE);	// now mark the end of the display cycle
 		}
+	}
+#ifdef PROFILE
+	ProfRows++;
+#endif
+	seq_publish(&DispSeq);
+}
+
+#ifdef TELEMETRY
+//
+// returns the longest and the average time of the audio interrupt, in units of 8 cycles,
+// from the overflow to the end of its work.  the longest is that since the last call.
+// (while no song plays it does not run, and the average stays.)
+//
+// the interrupt clears the longest when it runs next, so one that comes between
+// reading and asking for that is not counted.
+//
+void isrtime(uint8_t* max, uint8_t* mean)
+{
+	uint8_t q, idle;
+
+	idle = events_pending(&IsrTimeReset);	// it has not run since the last call
+	do {
+		q = seq_read_begin(&IsrTimeSeq);
+		*max = IsrTimeMax;
+		*mean = IsrTimeAvg >> 4;
+	} while (seq_read_retry(&IsrTimeSeq, q));
+	if (idle)
+		*max = 0;
+	events_raise(&IsrTimeReset, 1);
+}
+#endif
 
+#ifdef PROFILE
+//
+// returns the time in display timer counts (F_CPU/DISPLAY_PRESCALE, 8us at 8MHz but 4us
+// at 16MHz, see prof_counts_ms()): the display interrupts so far times the counts between
+// them, plus the count since the last one.  it wraps after 65536 interrupts (65s),
+// prof_elapsed() takes care of that.
+//
+uint32_t prof_now(void)
+{
+	uint16_t rows;
+	uint8_t count, matched, q;
+
+	do {
+		q = seq_read_begin(&DispSeq);
+		rows = ProfRows;
+		count = TCNT2;
+		matched = TIFR2 & _BV(OCF2A);
+	} while (seq_read_retry(&DispSeq, q));
+	if (matched && (count < ROW_COUNTS / 2)) {
+		rows++;				// the timer matched, but its interrupt has not run yet
 	}
+	return (uint32_t)rows * ROW_COUNTS + count;
 }
 
+//
+// returns the counts of prof_now() per millisecond, to turn its times into microseconds
+//
+uint16_t prof_counts_ms(void)
+{
+	return ROW_COUNTS;
+}
 
 //
+// returns the time from start to now (both from prof_now()), up to 65s
 //
-//	here, we start timer in "fast PWM" mode 14 (see waveform generation, pg 132 of atmega88 doc).
+static uint32_t prof_elapsed(uint32_t start, uint32_t now)
+{
+	if (now < start) {
+		now += 65536UL * ROW_COUNTS;
+	}
+	return now - start;
+}
+
 //
+// starts and stops timing a section of the main loop, use PROF_START() and PROF_STOP()
+// (miggl.h), which are nothing unless built with PROFILE
 //
-void start_timer1(void)
+void prof_start(uint8_t scope)
 {
+	ProfStart[scope] = prof_now();
+}
 
-#if EIGHT_MHZ == 1
-	// initialize ICR1, which sets the "TOP" value for the counter to interrupt and start over
-	// note: value of 50-1 ==> 20khz (assumes 8mhz clock, prescaled by 1/8)
-	ICR1 = 50-1;
-	OCR1A = 25;
+void prof_stop(uint8_t scope)
+{
+	uint32_t t = prof_elapsed(ProfStart[scope], prof_now());
+	struct prof_scope* p = &ProfScope[scope];
+
+	p->last = (t > 0xFFFF) ? 0xFFFF : t;
+	if (p->last > p->max) {
+		p->max = p->last;
+	}
+}
+
+//
+// clears the longest times of the sections, the frame time histogram and the missed frames
+//
+void prof_reset(void)
+{
+	uint8_t i;
+
+	for (i = 0; i < PROF_SCOPES; i++) {
+		ProfScope[i].max = 0;
+	}
+	for (i = 0; i < FRAME_BINS; i++) {
+		FrameHist[i] = 0;
+	}
+	FrameMissed = 0;
+}
+
+//
+// counts the time the main program took for a frame, from the end of the last
+// swapbuffers() to now, in the histogram: bin i for i tenths of the frame, the last one
+// for a frame that took longer than it has.  when the display cycle is over already,
+// the frame missed its deadline.
+//
+static void prof_frame(void)
+{
+	uint32_t tenth = (uint32_t)SwapInterval * ROW_COUNTS;		// a display cycle is 10 rows
+	uint32_t t = prof_elapsed(FrameStart, prof_now());
+	uint8_t bin;
+
+	if (events_pending(&SwapRelease)) {
+		FrameMissed++;
+	}
+	bin = (t >= tenth * (FRAME_BINS - 1)) ? FRAME_BINS - 1 : t / tenth;
+	FrameHist[bin]++;
+}
 #endif
 
-#if SIXTEEN_MHZ == 1
+
+//
+//
+//	here, we start timer in "fast PWM" mode 14 (see waveform generation, pg 132 of atmega88 doc).
+//
+//
+void start_timer1(void)
+{
+
 	// initialize ICR1, which sets the "TOP" value for the counter to interrupt and start over
-	// note: value of 100-1 ==> 20khz (assumes 16mhz clock, prescaled by 1/8)
-	ICR1 = 100-1;
-	OCR1A = 50;		// XXX why is this set?  unused?
-#endif
+	// note: AUDIO_TOP ==> 20khz at any clock, prescaled by 1/8 (see miggl-private.h)
+	ICR1 = AUDIO_TOP;
+	OCR1A = (AUDIO_TOP + 1) / 2;		// XXX why is this set?  unused?
 
 	//
 	// start timer:
@@ -752,11 +652,26 @@ void start_timer1(void)
 
 	TCCR1B = _BV(WGM13) | _BV(WGM12) | _BV(CS11);
 
-	TIMSK1 |= _BV(TOIE1);		// enable timer1 overflow interrupt
+	// the overflow interrupt (the audio samples) is enabled by playsong()
 
 }
 
 
+//
+//	timer2 runs the display: clear timer on compare match (CTC) mode, so the compare
+//	match interrupt comes every ROW_COUNTS counts (1ms, see miggl-private.h), once per row.
+//
+void start_timer2(void)
+{
+	OCR2A = ROW_COUNTS - 1;
+	TCCR2A = _BV(WGM21);						// CTC mode
+
+	TCCR2B = DISPLAY_CS;						// prescaler system clock/DISPLAY_PRESCALE
+
+	TIMSK2 |= _BV(OCIE2A);		// enable timer2 compare match A interrupt
+}
+
+
 /*
  *
  *	low level init needed for AVR.
@@ -770,6 +685,7 @@ void avrinit(void)
 	UCSR0B &= ~_BV(TXEN0);	// disable Tx function in USART0
 							// note: this is off by default, but the bootloader code, which
 							//	may precede this initialization, turns it on.
+							//	(uart_init() turns it back on for telemetry, see uart.c)
 
 	// note: these MUST be in sync with actual hardware!  (also see iodefs.h)
 
@@ -848,8 +764,11 @@ void poll_buttons(void)
 //
 void handlebuttons(void)
 {
+	uint8_t mask = _buttonmask;			// the interrupt may change it meanwhile, read it once
 
 #ifdef NOTDEF	/* XXX fix later! */
+	uint8_t events = events_pending(&_buttonevents);
+
 	ButtonA = (_buttonmask & 0x1) ? 1 : 0;
 
 	ButtonB = (_buttonmask & 0x2) ? 1 : 0;
@@ -858,41 +777,46 @@ void handlebuttons(void)
 
 	ButtonD = (_buttonmask & 0x8) ? 1 : 0;
 
-	ButtonAEvent = (_buttoneventmask & 0x1) ? 1 : 0;
+	ButtonAEvent = (events & 0x1) ? 1 : 0;
 
-	ButtonBEvent = (_buttoneventmask & 0x2) ? 1 : 0;
+	ButtonBEvent = (events & 0x2) ? 1 : 0;
 
-	ButtonCEvent = (_buttoneventmask & 0x4) ? 1 : 0;
+	ButtonCEvent = (events & 0x4) ? 1 : 0;
 
-	ButtonDEvent = (_buttoneventmask & 0x8) ? 1 : 0;
+	ButtonDEvent = (events & 0x8) ? 1 : 0;
 
-	// XXX still need to copy _buttoneventmask to "Event" vars
+	// XXX still need to copy _buttonevents to "Event" vars
 
 #else
-	// XXX this scheme doesn't need _buttoneventmask!
+	// XXX this scheme doesn't need _buttonevents!
+	// (except to count the presses it can't see: pressed and let go again since the last call)
+	uint8_t events = events_take(&_buttonevents, 0xF);
 
-	if (!ButtonA && (_buttonmask & 0x1)) {
+	if (events & ~mask)
+		ButtonDrops++;
+
+	if (!ButtonA && (mask & 0x1)) {
 
 		ButtonA = 1;
 
 		// action
 		ButtonAEvent = 1;
 
-	} else if (!ButtonB && (_buttonmask & 0x2)) {
+	} else if (!ButtonB && (mask & 0x2)) {
 
 		ButtonB = 1;
 
 		// action
 		ButtonBEvent = 1;
 
-	} else if (!ButtonC && (_buttonmask & 0x4)) {
+	} else if (!ButtonC && (mask & 0x4)) {
 
 		ButtonC = 1;
 
 		// action
 		ButtonCEvent = 1;
 
-	} else if (!ButtonD && (_buttonmask & 0x8)) {
+	} else if (!ButtonD && (mask & 0x8)) {
 
 		ButtonD = 1;
 
@@ -902,13 +826,13 @@ void handlebuttons(void)
 	} else {
 		//poll_buttons();
 
-		ButtonA = (_buttonmask & 0x1) ? 1 : 0;
+		ButtonA = (mask & 0x1) ? 1 : 0;
 
-		ButtonB = (_buttonmask & 0x2) ? 1 : 0;
+		ButtonB = (mask & 0x2) ? 1 : 0;
 
-		ButtonC = (_buttonmask & 0x4) ? 1 : 0;
+		ButtonC = (mask & 0x4) ? 1 : 0;
 
-		ButtonD = (_buttonmask & 0x8) ? 1 : 0;
+		ButtonD = (mask & 0x8) ? 1 : 0;
 	}
 #endif
 }
@@ -920,16 +844,46 @@ void handlebuttons(void)
  */
 void swapbuffers(void)
 {
-	while (!SwapRelease) {		// spin until this flag is set
+#ifdef PROFILE
+	prof_frame();
+#endif
+	while (!events_take(&SwapRelease, SWAP_RELEASE)) {		// spin until the cycle has ended
 		NOP();
 	}
-	NOP();
-	SwapRelease = 0;			// clear flag (for next time)
+#ifdef PROFILE
+	FrameStart = prof_now();
+#endif
+}
+
+//
+// returns the number of timer ticks (50us each) until the current display cycle ends
+// and swapbuffers() returns, or 0 if it has ended already.
+//
+// note: the row and the timer are read together (see DispSeq), but the timer may have
+//	matched and the interrupt not run yet, so this is an estimate (off by one row at worst).
+//
+uint16_t frameticksleft(void)
+{
+	uint16_t rows;
+	uint8_t row, counter, count, ticks, q;
+
+	do {
+		if (events_pending(&SwapRelease)) {
+			return 0;
+		}
+		q = seq_read_begin(&DispSeq);
+		row = CurRow;
+		counter = SwapCounter;
+		count = TCNT2;
+	} while (seq_read_retry(&DispSeq, q));
+	rows = (10 - row) + (counter - 1) * 10;		// rows to display until the cycle ends
+	ticks = ((ROW_COUNTS - count) * (uint16_t)(256 * ROW_TICKS / ROW_COUNTS)) >> 8;	// until the next row
+	return (rows - 1) * ROW_TICKS + ticks;
 }
 
 void initswapbuffers(void)
 {
-	SwapRelease = 0;
+	events_take(&SwapRelease, SWAP_RELEASE);
 	SwapInterval = 1;
 	SwapCounter = 1;
 }
@@ -1028,6 +982,55 @@ uint8_t readpixel(uint8_t x, uint8_t y)
 }
 
 
+#ifdef PALETTE
+//
+// sets the color the pixels of a palette index are shown in (right away, whatever is
+// on the display).  all pixels drawn with setcolor(index) change at once.
+//
+void setpalette(uint8_t index, uint8_t color)
+{
+	uint8_t bit;
+
+	index &= 0x3;
+	color &= 0x3;
+	Palette[index] = color;
+	bit = 1 << index;
+	if (color & GREEN) {
+		PalGreen |= bit;
+	} else {
+		PalGreen &= ~bit;
+	}
+	if (color & RED) {
+		PalRed |= bit;
+	} else {
+		PalRed &= ~bit;
+	}
+}
+
+
+//
+// returns the color of a palette index
+//
+uint8_t getpalette(uint8_t index)
+{
+	return Palette[index & 0x3];
+}
+
+
+//
+// shows every index as the color of the same number again
+//
+void resetpalette(void)
+{
+	uint8_t i;
+
+	for (i = 0; i < 4; i++) {
+		setpalette(i, i);
+	}
+}
+#endif
+
+
 
 //
 //	draw a filled rectangle from (x1 y1) to (x2 y2)
@@ -1069,263 +1072,19 @@ void drawfilledrect(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2)
 }
 
 
-// a simple API for making sounds.
-
-void initaudio(void)
-{
-	// default wavetable (WT_SAWTOOTH)
-	wavPtr = SawWtable;
-
-	// default tempo
-	//XXX
-	SongLoopFlag = 0;
-	SongPlayFlag = 0;
-	PWMval = wavPtr[0];					// initialize to first entry of table
-
-	EnvelopeA = 0; 	// these envelope settings should produce the same sound as the miggl-version
-	EnvelopeD = 0; 	// without envelope
-	EnvelopeS = 63;
-	EnvelopeR = 0;
-}
-
-
-//
-// sets tempo for playnote function.
-// the default tempo is 72 beats per minute.
-//
-void settempo(byte bpm)
-{
-	// XXX NYI !!
-}
-
-
-//
-// wavetables are just arrays of samples that produce waveforms.
-// from the API all tables are just referenced by named constants.
-// WT_SAWTOOTH is the default.
-//
-void setwavetable(byte wtable)
-{
-	if (wtable == WT_SINE) {
-		wavPtr = SineWtable;
-	} else if (wtable == WT_SAWTOOTH) {
-		wavPtr = SawWtable;
-	} else if (wtable == WT_SQUARE) {
-		wavPtr = SquareWtable;
-	}
-}
-
-
-//
-// play a tone with pitch in Hz, and dur in ms.
-// the current wavetable is used.
-//
-void playsound(int pitch, int dur)
-{
-	// XXX NYI !!
-}
-
-
-// play a tone with pitch "note" (uses predefined constants like C4 for middle C) and
-// duration dur (predefined constants like N_QUARTER, etc.)
-// the current wavetable is used.
-//
-// XXX NYI !!
-void playnote(byte note, byte dur)
-{}
-
-
-//
-// sets the song loop flag. If 0, the song will not be looped, if != 0, the song will be played
-// on and on and on ... In case the song is currently looped and the flag is set to 0, the song
-// will be finished.
-//
-void loopsong(uint8_t flag)
-{
-	SongLoopFlag = flag;
-}
-
-//
-// R2Nx - this converts a ratio (e.g. 1.000) into a standard note (e.g. a frequency),
-// where "x" is the octave number (e.g. for middle C, x = 4).
-//
-// this is used to build the "note table" needed by the audio code.
-//
-#define R2N3(ratio)		(uint16_t)(ratio*64.0+0.5)
-
-//
-// convert ratio into "frequency" for audio code in ISR
-//
-#define R2N4(ratio)		(uint16_t)(ratio*128.0+0.5)
-
-//
-// octave higher than above (saves typing below)
-//
-#define R2N5(ratio)		(uint16_t)(ratio*256.0+0.5)
-
-//
-// table of "frequencies" for standard piano notes
-//
-// this table converts standard piano notes (e.g. N_C4) into 8.8 fixed point deltas
-//	used in the wavetable synthesis code.
-//
-// note: currently, to make the math simpler, notes are transposed a bit.
-//		for example, C5 is about 625 Hz when it really should be 523.251 Hz.  (off by about 3 half steps)
-//		but, the final pitches should be relatively accurate because they are based on ratios
-//
-// also see GETNOTEDELTA() macro which references NoteTab.
-//
-uint16_t NoteTab[] = {
-R2N3(1.000),	// N_C3 - C3 (1 octave below middle C)
-R2N3(1.059),	// N_CS3
-R2N3(1.122),	// N_D3
-R2N3(1.189),	// N_DS3
-R2N3(1.260),	// N_E3
-R2N3(1.335),	// N_F3
-R2N3(1.414),	// N_FS3
-R2N3(1.498),	// N_G3
-R2N3(1.587),	// N_GS3
-R2N3(1.682),	// N_A3	- A3 (220 Hz)
-R2N3(1.782),	// N_AS3
-R2N3(1.888),	// N_B3
-
-R2N4(1.000),	// N_C4 - C4 (middle C)
-R2N4(1.059),	// N_CS4
-R2N4(1.122),	// N_D4
-R2N4(1.189),	// N_DS4
-R2N4(1.260),	// N_E4
-R2N4(1.335),	// N_F4
-R2N4(1.414),	// N_FS4
-R2N4(1.498),	// N_G4
-R2N4(1.587),	// N_GS4
-R2N4(1.682),	// N_A4	- A4 (440 Hz)
-R2N4(1.782),	// N_AS4
-R2N4(1.888),	// N_B4
-
-R2N5(1.000),	// N_C5	- C5 (1 octave above middle C)
-R2N5(1.059),	// N_CS5
-R2N5(1.122),	// N_D5
-R2N5(1.189),	// N_DS5
-R2N5(1.260),	// N_E5
-R2N5(1.335),	// N_F5
-R2N5(1.414),	// N_FS5
-R2N5(1.498),	// N_G5
-R2N5(1.587),	// N_GS5
-R2N5(1.682),	// N_A5	- A5 (880 Hz)
-R2N5(1.782),	// N_AS5
-R2N5(1.888),	// N_B5
-R2N5(2.000),	// N_C6	- C6 (2 octaves above middle C)
-};
-
-
-//
-// this table converts duration values (1..48) into the
-// actual number of ticks used by the audio code.
-// the table is loaded for a specific tempo (e.g. 75 bpm - beats [aka quarter note] per minute).
-//
-// design note:
-//	by using 48 values, instead of a power of two like 16, we can represent triplets.
-//	a quarter note (1 beat) is 12, an eighth note is 6, and an 8th triplet is 4.
-//
-//
-// note: remember to subtract 1 before indexing this table with a standard duration (1..48)
-//
-// XXX need to fill in ALL entries in this table!
-//	(just did the common ones, all the 0s are placeholders)
-//
-// also see GETDURATION() macro which references DurTab.
-//
-uint16_t DurTab[48] = {
-0,0,TEMPOBEAT/4,TEMPOBEAT/3,0,TEMPOBEAT/2,
-0,0,0,0,0,TEMPOBEAT,
-0,0,0,0,0,0,
-0,0,0,0,0,TEMPOBEAT*2,
-
-0,0,0,0,0,0,
-0,0,0,0,0,TEMPOBEAT*3,
-0,0,0,0,0,0,
-0,0,0,0,0,TEMPOBEAT*4,
-};
-
-
-//
-// play a song, that is, a sequence of notes and durations.
-// this is passed an array of bytes, which is filled with note/duration pairs,
-// and must end with the byte N_END.
-//
-// XXX do we correctly handle the case where this is called when a song is currently playing?
-//
-void playsong(byte *songtable)
-{
-	uint16_t tmp;
-	uint8_t note, dur;
-
-	if (songtable == NULL) {		// error check
-		return;
-	}
-
-	SongPlayFlag = 0;				// just in case a song is currently playing
-
-	songPtr = songtable;			// set pointer to the song table array
-
-	note = *songPtr++;
-	if (note != N_END) {
-
-		// note: this code is repeated inside ISR - must match!!
-		tmp = GETNOTEDELTA(note);
-		WtabDelta.integ = (uint8_t)((tmp >> 8) & 0xff);		// high byte
-		WtabDelta.fract = (uint8_t)(tmp & 0xff);			// low byte
-		dur = *songPtr++;
-		CurNote = note;						// set 1st note to play, and
-		Wdur = GETDURATION(dur);   			// its duration.
-
-		WtabCount.integ = 0;				// we will start playing from start of current wavetable
-		WtabCount.fract = 0;
-		PWMval = wavPtr[0];					// initialize to first entry of table
-		SongPlayFlag = 1;					// start playing song
-	}
-}
-
-
-//
-// this returns 1 if audio is playing, 0 otherwise.
-//
-byte isaudioplaying(void)
-{
-	return SongPlayFlag;
-}
-
-
 //
 // this waits until audio (e.g. note or song) is finished, then returns.
+// (host/miggl-host.c has its own, which lets the time go on meanwhile.)
 //
 void waitaudio(void)
 {
-	while (SongPlayFlag) {
+	while (isaudioplaying()) {
 		NOP();
 	}
 
 	return;
 }
 
-
-// sets the envelope parameters for the sound generator.
-//
-// a, d and r together must be smaller that 256, since the represent each a 1/256th of the note length
-// if the sum is smaller, the rest will be used for the sustain
-// s must be >= 0 and < 64
-//
-// if a note is currently played, these settings will take effect when the next note starts.
-//
-void setenvelope (uint8_t a, uint8_t d, uint8_t s, uint8_t r) {
-	if ((a + d + r < 256) && (d < 64)) {
-		EnvelopeA = a;
-		EnvelopeD = d;
-		EnvelopeS = s;
-		EnvelopeR = r;
-	}
-}
-
 //
 // crude delay of 1 to 255 us -> Move this into the miggl-Lib?
 //
@@ -1365,7 +1124,8 @@ void initmiggl (void) {
 	initswapbuffers();
 	swapinterval(10);		// note: display refresh is 100hz (lower number speeds up game)
 	cleardisplay();
-	start_timer1();			// this starts display refresh and audio processing
+	start_timer1();			// this starts audio processing (the interrupt runs while a song plays)
+	start_timer2();			// and this the display refresh
 	button_init();
 	initaudio();			// XXX eventually, we remove this!
 }
@@ -44,20 +44,14 @@
  *
  */
 
+#ifndef MIGGL_H
+#define MIGGL_H
 
-/* make one of these 1 and the other 0 */
-/* this chooses 8MHz internal oscillator or 16MHz external resonator */
-#define EIGHT_MHZ 1
-#define SIXTEEN_MHZ	0
-
-/* define F_CPU according to above */
-
-//#if EIGHT_MHZ == 1
+/* the clock: 8MHz internal oscillator, or e.g. a 16MHz external resonator with
+   "make F_CPU=16000000".  the timers, the notes and the delays are computed from it
+   (see miggl-private.h) */
+#ifndef F_CPU
 #define F_CPU 8000000UL
-//#endif
-
-#if SIXTEEN_MHZ == 1
-//#define F_CPU 16000000UL
 #endif
 
 
@@ -74,6 +68,7 @@
 
 /* notes (incomplete!) */
 #define N_END	0
+#define N_LOOP	1		// (no duration) a looping song starts over from here, see playsong()
 #define N_REST	255
 
 #define N_C3	28		// C3 (1 octave below middle C)
@@ -145,6 +140,7 @@ extern byte ButtonAEvent;
 extern byte ButtonBEvent;
 extern byte ButtonCEvent;
 extern byte ButtonDEvent;
+extern byte ButtonDrops;		// presses handlebuttons() missed (counts up and wraps)
 
 
 extern volatile uint8_t Disp[];		// XXX probably shouldn't access this!
@@ -155,12 +151,20 @@ extern volatile uint8_t Disp[];		// XXX probably shouldn't access this!
 void swapbuffers(void);
 void initswapbuffers(void);
 void swapinterval(uint8_t i);
+uint16_t frameticksleft(void);
 void cleardisplay(void);
 void setcolor(uint8_t c);
 void drawpoint(uint8_t x, uint8_t y);
 uint8_t readpixel(uint8_t x, uint8_t y);
 void drawfilledrect(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2);
 
+/* indexed colors (make PALETTE=1): the colors drawn are indices into the palette */
+#ifdef PALETTE
+void setpalette(uint8_t index, uint8_t color);
+uint8_t getpalette(uint8_t index);
+void resetpalette(void);
+#endif
+
 
 /* button functions */
 
@@ -175,7 +179,9 @@ void initaudio(void);
 void settempo(byte bpm);
 void setwavetable(byte wtable);
 void playnote(byte note, byte dur);
-void playsong(byte *songtable);
+void playsong(const byte *songtable);		// the song is in flash (PROGMEM)
+void stopsong(void);
+uint8_t queuesong(const byte *songtable, uint8_t loop);	// plays after the current song, 0 if the queue is full (3 songs)
 void loopsong(uint8_t flag);
 byte isaudioplaying(void);		// returns 1 if audio is playing, 0 otherwise
 void waitaudio(void);			// waits until audio (e.g. note or song) is finished
@@ -183,9 +189,71 @@ void waitaudio(void);			// waits until audio (e.g. note or song) is finished
 void setenvelope (uint8_t a, uint8_t d, uint8_t s, uint8_t r);
 
 
+/* sound effects - played over the song, see sfx_play() in miggl-audio.c */
+
+#define SFX_RATE		20000UL		// audio ticks per second (AUDIO_RATE)
+#define SFX_CONTROL		32			// audio ticks per control step (1.6ms)
+
+#define SFX_HZ(f)		((uint16_t)((f) * 65536UL / SFX_RATE))			// step of a pitch in Hz
+#define SFX_MS(ms)		((uint8_t)((ms) * SFX_RATE / 1000 / SFX_CONTROL))	// control steps of ms
+#define SFX_SWEEP(from, to, ms)	((int16_t)(((int32_t)SFX_HZ(to) - (int32_t)SFX_HZ(from)) / SFX_MS(ms)))
+
+/* waves of an effect */
+#define SFX_SQUARE		0
+#define SFX_PULSE		1			// high a quarter of the period
+#define SFX_NOISE		2			// a random bit per period
+#define SFX_CHAIN		0x80		// or'ed to the wave: the next record plays after this one
+
+struct sfx {
+	uint16_t step;			// added to the phase every audio tick, SFX_HZ()
+	int16_t sweep;			// added to step every control step, SFX_SWEEP()
+	uint8_t length;			// control steps, SFX_MS()
+	uint8_t wave;			// SFX_SQUARE, SFX_PULSE or SFX_NOISE, maybe with SFX_CHAIN
+	uint8_t volume;			// 0 - 49
+	uint8_t decay;			// control steps until the volume drops by a quarter, 0 keeps it
+};
+
+void sfx_play(const struct sfx* e);	// e is in flash (PROGMEM)
+void sfx_stop(void);
+uint8_t sfx_playing(void);
+
+
 /* XXX stuff that probably shouldn't be here... */
 void avrinit(void);
 void start_timer1(void);
+void start_timer2(void);
+#ifdef TELEMETRY
+void isrtime(uint8_t* max, uint8_t* mean);	// timer interrupt time, see miggl.c
+#endif
+
+
+/* frame profiling (make PROFILE=1), see miggl.c */
+
+#ifdef PROFILE
+#define PROF_SCOPES		4		// sections of the main loop that can be timed
+#define FRAME_BINS		11		// frame time histogram: tenths of the frame, then longer
+
+struct prof_scope {
+	uint16_t last;		// time of the last run in prof_now() counts, 65535 for longer
+	uint16_t max;		// longest since prof_reset()
+};
+
+extern struct prof_scope ProfScope[];
+extern uint16_t FrameHist[];	// frames by the time the main program took for them
+extern uint16_t FrameMissed;	// frames that took longer than the display cycle
+
+uint32_t prof_now(void);		// display timer counts, the clock's F_CPU/DISPLAY_PRESCALE
+uint16_t prof_counts_ms(void);	// prof_now() counts per millisecond
+void prof_start(uint8_t scope);
+void prof_stop(uint8_t scope);
+void prof_reset(void);
+
+#define PROF_START(s)	prof_start(s)
+#define PROF_STOP(s)	prof_stop(s)
+#else
+#define PROF_START(s)
+#define PROF_STOP(s)
+#endif
 
 
 /* sleep functions */
@@ -198,4 +266,4 @@ uint32_t nextrandom (uint32_t max);
 
 void initmiggl (void);
 
-
+#endif /* MIGGL_H */
@@ -0,0 +1,152 @@
+#!/bin/sh
+#
+# perf-budget.sh - flash, RAM and cycle budget of tri2s.elf (see "make perf-budget")
+#
+# reports the section sizes, the largest symbols, the static stack use per function
+# (from the .su files of -fstack-usage) and the cycles simulated by sim/isrprof, then
+# compares them to the baseline file.  a value more than its tolerance above its
+# baseline is a regression, and so is flash above 16 KB or .data + .bss above 1 KB.
+# a value without a baseline, or a baseline without a value, fails as well, so the
+# check can't pass by measuring nothing.
+#
+# the baseline has lines of "name value tolerance", the tolerance in percent.  with -u
+# it is replaced by the current values, which keep their tolerances (threshold percent
+# for new ones).  sim/isrprof has to build and run: without simavr the cycles can only
+# be left out with -n, and then they are reported as NOT CHECKED.
+#
+# usage: perf-budget.sh [-u] [-n] file.elf baseline threshold
+#
+# Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+#	(attribution, non-commercial, share-alike)
+# 	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+#
+
+FLASH_SIZE=16384
+RAM_SIZE=1024
+
+update=0
+nosim=0
+while [ $# -gt 0 ]; do
+	case $1 in
+		-u) update=1 ;;
+		-n) nosim=1 ;;
+		*) break ;;
+	esac
+	shift
+done
+if [ $# -ne 3 ]; then
+	echo "usage: $0 [-u] [-n] file.elf baseline threshold" >&2
+	exit 2
+fi
+if [ $update -eq 1 ] && [ $nosim -eq 1 ]; then
+	echo "the baseline needs the cycles too, not with -n" >&2
+	exit 2
+fi
+elf=$1
+baseline=$2
+threshold=$3
+current=${baseline%.txt}.new
+
+: > $current
+
+# sections
+avr-size -A $elf | awk '
+	$1 == ".text" { text = $2 }
+	$1 == ".data" { data = $2 }
+	$1 == ".bss"  { bss = $2 }
+	END {
+		printf "bytes.flash %d\nbytes.data %d\nbytes.bss %d\nbytes.ram %d\n", text + data, data, bss, data + bss
+	}' >> $current
+
+echo "largest symbols (bytes):"
+avr-nm -S --size-sort $elf | tail -15 | awk '
+	function hex(s,   i, n) {
+		n = 0
+		for (i = 1; i <= length(s); i++)
+			n = n * 16 + index("0123456789abcdef", tolower(substr(s, i, 1))) - 1
+		return n
+	}
+	{ printf "  %-28s %6d  %s\n", $4, hex($2), $3 }'
+
+# static stack use, per function (of the game, not of microbench.elf)
+su=$(ls *.su 2> /dev/null | grep -v -e '^microbench\.su$' -e '^tri2s-bench\.su$')
+if [ -n "$su" ]; then
+	echo "stack per function (bytes):"
+	cat $su | awk -F '\t' '{ n = split($1, f, ":"); print $2, f[n], $3 }' | sort -rn | head -10 |
+		awk '{ printf "  %-28s %6d  %s\n", $2, $1, $3 }'
+	# the display interrupt (7) lets one of the others in while it reads the switches: the
+	# audio (13) or the UART's (18 RX, 19 UDRE).  they don't let anything in themselves.
+	cat $su | awk -F '\t' '
+		{ if ($2 > max) max = $2 }
+		$1 ~ /:__vector_7$/ { display = $2 }
+		$1 ~ /:__vector_(13|18|19)$/ { if ($2 > nested) nested = $2 }
+		END { printf "stack.max %d\nstack.isr %d\n", max, display + nested }' >> $current
+else
+	echo "no .su files, stack use not checked (build with -fstack-usage)" >&2
+fi
+
+# simulated cycles
+if [ $nosim -eq 1 ]; then
+	echo "*** -n: no simulator, the CYCLES ARE NOT CHECKED ***" >&2
+elif ! make -s -C sim isrprof > /dev/null 2>&1; then
+	echo "sim/isrprof does not build (simavr missing?), \"make perf-budget PERF_SIM=0\" leaves the cycles out" >&2
+	exit 1
+elif ! sim/isrprof -b -w lineclear $elf >> $current; then
+	echo "sim/isrprof failed, the cycles can't be checked" >&2
+	exit 1
+fi
+
+echo "budget (baseline $baseline, default tolerance $threshold%):"
+[ -f $baseline ] || : > $baseline
+if [ $update -eq 1 ]; then
+	awk -v t=$threshold '
+		FNR == NR { if ($1 !~ /^#/ && NF >= 2) tol[$1] = (NF >= 3) ? $3 : t; next }
+		{ printf "%s %d %d\n", $1, $2, ($1 in tol) ? tol[$1] : t }' $baseline $current > $current.tol
+	grep '^#' $baseline > $baseline.tmp
+	cat $current.tol >> $baseline.tmp
+	mv $baseline.tmp $baseline
+	rm -f $current.tol
+	awk '!/^#/ { printf "  %-24s %10d %5d%%\n", $1, $2, $3 }' $baseline
+	echo "baseline updated"
+	exit 0
+fi
+awk -v t=$threshold -v flash=$FLASH_SIZE -v ram=$RAM_SIZE -v nosim=$nosim '
+	FNR == NR {
+		if ($1 !~ /^#/ && NF >= 2) {
+			base[$1] = $2
+			tol[$1] = (NF >= 3) ? $3 : t
+		}
+		next
+	}
+	{
+		seen[$1] = 1
+		status = "ok"
+		if (!($1 in base)) {
+			status = "NO BASELINE"
+			failed = 1
+		} else if ($2 > base[$1] * (100 + tol[$1]) / 100) {
+			status = "REGRESSION"
+			failed = 1
+		}
+		if (($1 == "bytes.flash" && $2 > flash) || ($1 == "bytes.ram" && $2 > ram)) {
+			status = "OVER BUDGET"
+			failed = 1
+		}
+		printf "  %-24s %10d %10s  %s\n", $1, $2, ($1 in base) ? base[$1] " +" tol[$1] "%" : "-", status
+	}
+	END {
+		for (name in base) {
+			if (name in seen)
+				continue
+			if (nosim && name ~ /^(cycles|permille)\.|^bytes\.stack\.peak$/)
+				status = "NOT CHECKED"
+			else {
+				status = "MISSING"
+				failed = 1
+			}
+			printf "  %-24s %10s %10s  %s\n", name, "-", base[name] " +" tol[name] "%", status
+		}
+		if (failed)
+			print "values without a baseline: run \"make perf-baseline\" on a build you checked and commit perf-budget.txt"
+		exit failed
+	}' $baseline $current
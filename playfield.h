@@ -0,0 +1,204 @@
+/*
+ *	playfield.h - Tri2s playfield representation
+ *
+ *	the playfield is stored column by column: one field_t per column, one bit per line.
+ *	bit 0 is the hidden line above the top of the field (where new stones appear),
+ *	bit 1 is line 0 (top) and bit FIELD_LINES is the bottom line.
+ *
+ *	with this layout a line is complete when its bit is set in every column, so
+ *	line detection, line clearing and collision tests work on whole columns
+ *	instead of single cells.
+ *
+ *	the field size is set at compile time (e.g. -DFIELD_LINES=16) and is independent
+ *	of the display; tri2s.c shows the part of the field the stone is in (see viewport).
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#ifndef PLAYFIELD_H
+#define PLAYFIELD_H
+
+#include <inttypes.h>
+
+/* field size (lines are counted top to bottom, columns are the stone's y) */
+#ifndef FIELD_LINES
+#define FIELD_LINES	7
+#endif
+#ifndef FIELD_WIDTH
+#define FIELD_WIDTH	5
+#endif
+
+#if (FIELD_LINES < 3) || (FIELD_LINES > 63)
+#error "FIELD_LINES must be between 3 and 63"
+#endif
+#if (FIELD_WIDTH < 3) || (FIELD_WIDTH > 32)
+#error "FIELD_WIDTH must be between 3 and 32"
+#endif
+
+/* one column of the field, wide enough for FIELD_LINES plus the hidden line */
+#if FIELD_LINES < 8
+typedef uint8_t field_t;
+#elif FIELD_LINES < 16
+typedef uint16_t field_t;
+#elif FIELD_LINES < 32
+typedef uint32_t field_t;
+#else
+typedef uint64_t field_t;
+#endif
+
+// the bit of a line (line 0 is the top line)
+#define FIELD_BIT(line)		((field_t)0x02 << (line))
+
+// all visible lines (everything but the hidden line)
+#define FIELD_LINEMASK		((field_t)(((field_t)0x02 << (FIELD_LINES - 1)) * 2 - 2))
+
+// where new stones appear
+#define SPAWN_X		0
+#define SPAWN_Y		(FIELD_WIDTH / 2)
+
+// the parts a stone is made of
+#define UP 		0x01
+#define LEFT 	0x02
+#define MIDDLE  0x04
+#define RIGHT 	0x08
+#define DOWN 	0x10
+
+
+//
+// clears a field
+//
+static inline void field_clear (field_t* field) {
+	uint8_t i;
+	for (i = 0; i < FIELD_WIDTH; i++)
+		field[i] = 0;
+}
+
+//
+// returns the middle column of a stone at line x: the center plus its UP and DOWN parts
+//
+static inline field_t stone_column (uint8_t stone, uint8_t x) {
+	field_t c = (field_t)1 << x;
+	if ((stone & UP) && (x > 0))
+		c |= (field_t)1 << (x - 1);
+	if ((stone & DOWN) && (x < FIELD_LINES))
+		c |= (field_t)1 << (x + 1);
+	return c;
+}
+
+//
+// tests whether a stone at (x y) stays within the field bounds,
+// returns 1 if it does or 0 otherwise
+//
+static inline uint8_t stone_in_bounds (uint8_t stone, int8_t x, int8_t y) {
+	if (((stone & LEFT) ? (y + 1) : y) > FIELD_WIDTH - 1)
+		return 0;
+	if (((stone & RIGHT) ? (y - 1) : y) < 0)
+		return 0;
+	if (((stone & DOWN) ? (x + 1) : x) > FIELD_LINES)
+		return 0;
+	return 1;
+}
+
+//
+// checks if a stone at (x y) overlaps the field, returns 1 if it does or 0 otherwise
+// note: the stone has to be within bounds (see stone_in_bounds())
+//
+static inline uint8_t stone_overlaps (const field_t* field, uint8_t stone, uint8_t x, uint8_t y) {
+	field_t bit = (field_t)1 << x;
+	if (field[y] & stone_column(stone, x))
+		return 1;
+	if ((stone & LEFT) && (field[y + 1] & bit))
+		return 1;
+	if ((stone & RIGHT) && (field[y - 1] & bit))
+		return 1;
+	return 0;
+}
+
+//
+// tests whether a stone fits at (x y), returns 1 if it does or 0 otherwise
+//
+static inline uint8_t stone_fits (const field_t* field, uint8_t stone, int8_t x, int8_t y) {
+	return (stone_in_bounds(stone, x, y) && !stone_overlaps(field, stone, x, y)) ? 1 : 0;
+}
+
+//
+// draws a stone into the field
+//
+static inline void field_place_stone (field_t* field, uint8_t stone, uint8_t x, uint8_t y) {
+	field_t bit = (field_t)1 << x;
+	field[y] |= stone_column(stone, x);
+	if ((stone & LEFT) && (y + 1 < FIELD_WIDTH))
+		field[y + 1] |= bit;
+	if ((stone & RIGHT) && (y > 0))
+		field[y - 1] |= bit;
+}
+
+//
+// returns a mask with the bits of all complete lines
+//
+static inline field_t field_complete_lines (const field_t* field) {
+	field_t m = FIELD_LINEMASK;
+	uint8_t i;
+	for (i = 0; i < FIELD_WIDTH; i++)
+		m &= field[i];
+	return m;
+}
+
+//
+// finds the next complete line in the field, starting out from the bottom
+// returns the index of the line or -1 if there is none
+//
+static inline int8_t field_complete_line (const field_t* field) {
+	field_t m = field_complete_lines(field);
+	int8_t line = -1;
+	while (m > 1) {		// index of the highest bit is the bottom-most line
+		m >>= 1;
+		line++;
+	}
+	return line;
+}
+
+//
+// removes a line from the field and drops everything above it one line down
+//
+static inline void field_remove_line (field_t* field, int8_t line) {
+	field_t mask_upper = FIELD_BIT(line) - 1;			// hidden line to line - 1
+	field_t mask_lower = ~((FIELD_BIT(line) << 1) - 1);	// everything below line
+	uint8_t i;
+	for (i = 0; i < FIELD_WIDTH; i++)
+		field[i] = ((field[i] & mask_upper) << 1) | (field[i] & mask_lower);
+}
+
+//
+// removes all lines of a mask (as returned by field_complete_lines())
+//
+static inline void field_remove_lines (field_t* field, field_t lines) {
+	int8_t line = 0;
+	lines >>= 1;
+	while (lines) {			// top to bottom, so the lines below keep their index
+		if (lines & 1)
+			field_remove_line(field, line);
+		lines >>= 1;
+		line++;
+	}
+}
+
+//
+// pushes everything up one line and fills the bottom line but for the column hole
+// (a garbage line of the versus game).  returns 1 if something got pushed into the
+// hidden line, or 0 otherwise
+//
+static inline uint8_t field_raise (field_t* field, uint8_t hole) {
+	uint8_t i, over = 0;
+	for (i = 0; i < FIELD_WIDTH; i++) {
+		field[i] >>= 1;
+		if (i != hole)
+			field[i] |= FIELD_BIT(FIELD_LINES - 1);
+		over |= field[i] & 1;
+	}
+	return over;
+}
+
+#endif /* PLAYFIELD_H */
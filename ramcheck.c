@@ -0,0 +1,54 @@
+/*
+ *	ramcheck.c - how close the stack came to the variables
+ *
+ *	(see ramcheck.h)
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#include <inttypes.h>
+#include <avr/io.h>
+#include "ramcheck.h"
+
+extern uint8_t __heap_start;		// end of the variables (from the linker)
+
+void ram_paint (void) __attribute__((naked, used, section(".init1")));
+
+//
+// paints the RAM from the end of the variables to RAMEND.  this runs in .init1, before
+// the stack and r1 are set up, so it is written in assembler and uses no stack.
+//
+void ram_paint (void) {
+	__asm__ volatile (
+		"	ldi r30, lo8(__heap_start)\n"
+		"	ldi r31, hi8(__heap_start)\n"
+		"	ldi r24, %0\n"
+		"	ldi r25, hi8(%1)\n"
+		"1:	st Z+, r24\n"
+		"	cpi r30, lo8(%1)\n"
+		"	cpc r31, r25\n"
+		"	brlo 1b\n"
+		:: "i" (RAM_PAINT), "i" (RAMEND + 1)
+	);
+}
+
+//
+// returns the bytes between the end of the variables and the stack right now
+// (SP points to the next free byte)
+//
+uint16_t ram_free (void) {
+	return SP + 1 - (uint16_t)&__heap_start;
+}
+
+//
+// returns the least free RAM since the reset, including the interrupts.  it counts
+// the paint above the variables, which takes about 6 cycles per free byte.
+//
+uint16_t ram_free_min (void) {
+	const uint8_t* p = &__heap_start;
+	while ((p <= (const uint8_t*)RAMEND) && (*p == RAM_PAINT))
+		p++;
+	return p - &__heap_start;
+}
@@ -0,0 +1,28 @@
+/*
+ *	ramcheck.h - how close the stack came to the variables
+ *
+ *	at reset, before the variables are set up, all of the RAM above them (the heap, which
+ *	is unused, and the stack) is painted with RAM_PAINT.  the stack, of the main program
+ *	and of the interrupts alike, overwrites the paint as it grows down, so the paint left
+ *	above the variables is the least free RAM there ever was.  ram_free_min() counts it.
+ *
+ *	a byte of the stack that happens to be RAM_PAINT looks free, so the result can be a
+ *	few bytes too optimistic.  for the static picture see the .su files of -fstack-usage
+ *	("make perf-budget" shows them), for the peak in the simulator "sim/isrprof -b".
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#ifndef RAMCHECK_H
+#define RAMCHECK_H
+
+#include <inttypes.h>
+
+#define RAM_PAINT	0xC5
+
+uint16_t ram_free (void);
+uint16_t ram_free_min (void);
+
+#endif /* RAMCHECK_H */
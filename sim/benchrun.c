@@ -0,0 +1,132 @@
+/*
+ *	benchrun.c - runs the microbenchmarks of microbench.elf in simavr
+ *
+ *	the firmware (../microbench.c, built by "make microbench.elf") times nothing itself:
+ *	it calls bench_begin(phase) before and bench_end() after each loop of a benchmark, and
+ *	bench_report(name) at its end.  this counts the cycles from one call to the other and
+ *	prints the cycles per call of the benchmark, the loop with the call (phase 1) minus the
+ *	loop without it (phase 0), divided by BenchOps.  the arguments are read from the
+ *	registers at the calls (avr-gcc passes them in r24, r25:r24 for a pointer).
+ *
+ *	the output is one line "cycles.name value" per benchmark, like the host's "ns.name value".
+ *	the firmware ends by sleeping with the interrupts off; if it doesn't within the
+ *	-m cycles (default 100000000) something is wrong.  so is a "nop4" benchmark (four NOPs)
+ *	that does not come out at 4 cycles, or none at all: the calls were not seen right.
+ *
+ *	usage: benchrun [-m cycles] file.elf
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "symbols.h"
+
+#define MCU			"atmega168"
+#define FREQUENCY	8000000UL
+#define CALIBRATE	"nop4"		// the benchmark of four NOPs
+
+static struct symbol Begin = { "bench_begin" };
+static struct symbol End = { "bench_end" };
+static struct symbol Report = { "bench_report" };
+static struct symbol Ops = { "BenchOps" };
+
+static struct symbol* Symbols[] = { &Begin, &End, &Report, &Ops, NULL };
+
+
+//
+// returns the argument of the function just called (r25:r24)
+//
+static uint16_t read_arg (avr_t* avr) {
+	return avr->data[24] | (avr->data[25] << 8);
+}
+
+//
+// copies a string from the SRAM of the firmware
+//
+static void read_string (avr_t* avr, uint16_t addr, char* s, size_t n) {
+	size_t i;
+	for (i = 0; (i < n - 1) && (addr + i <= avr->ramend) && avr->data[addr + i]; i++)
+		s[i] = avr->data[addr + i];
+	s[i] = 0;
+}
+
+int main (int argc, char** argv) {
+	elf_firmware_t f;
+	avr_t* avr;
+	int c, state, phase = 0, n = 0, calibrated = 0;
+	uint64_t max = 100000000ULL, start = 0, cycles[2] = { 0, 0 };
+	uint16_t ops;
+	char name[64];
+	double per;
+
+	while ((c = getopt(argc, argv, "m:")) != -1) {
+		switch (c) {
+			case 'm': max = strtoull(optarg, NULL, 0); break;
+			default:
+				fprintf(stderr, "usage: %s [-m cycles] file.elf\n", argv[0]);
+				return 2;
+		}
+	}
+	if (optind + 1 != argc) {
+		fprintf(stderr, "usage: %s [-m cycles] file.elf\n", argv[0]);
+		return 2;
+	}
+	if (!read_symbols(argv[optind], Symbols, NULL))
+		return 2;
+
+	if (elf_read_firmware(argv[optind], &f)) {
+		fprintf(stderr, "%s: can't load\n", argv[optind]);
+		return 2;
+	}
+	if (!(avr = avr_make_mcu_by_name(MCU))) {
+		fprintf(stderr, "simavr does not know the %s\n", MCU);
+		return 2;
+	}
+	avr_init(avr);
+	avr->frequency = FREQUENCY;
+	avr_load_firmware(avr, &f);
+
+	for (;;) {
+		state = avr_run(avr);
+		if (state == cpu_Done)
+			break;
+		if ((state == cpu_Crashed) || (avr->cycle >= max)) {
+			fprintf(stderr, "the firmware stopped at pc %04x after %d benchmarks\n", avr->pc, n);
+			return 1;
+		}
+
+		if (avr->pc == Begin.addr) {
+			phase = avr->data[24] ? 1 : 0;
+			start = avr->cycle;
+		} else if (avr->pc == End.addr) {
+			cycles[phase] = avr->cycle - start;
+		} else if (avr->pc == Report.addr) {
+			ops = avr->data[DATA(Ops)] | (avr->data[DATA(Ops) + 1] << 8);
+			read_string(avr, read_arg(avr), name, sizeof(name));
+			per = ((double)cycles[1] - (double)cycles[0]) / ops;
+			if (!strcmp(name, CALIBRATE)) {
+				if ((per < 3.5) || (per > 4.5)) {
+					fprintf(stderr, "error: %s took %.1f cycles instead of 4, the calls are not seen right\n", name, per);
+					return 1;
+				}
+				calibrated = 1;
+			}
+			printf("cycles.%s %.1f\n", name, per);
+			n++;
+		}
+	}
+	if (!calibrated) {
+		fprintf(stderr, "error: no %s benchmark, the cycles are not checked\n", CALIBRATE);
+		return 1;
+	}
+	return 0;
+}
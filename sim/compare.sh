@@ -0,0 +1,55 @@
+#!/bin/sh
+#
+# compare.sh - the timer interrupts of two revisions of the firmware, one after the other
+#
+# checks both revisions out into a temporary directory (git worktree), builds tri2s.elf
+# and sim/isrprof of each and runs isrprof with the same workload on both.  each revision
+# is measured with its own isrprof, as the interrupts it looks for change with the
+# firmware.  e.g. what the last commit did to a silent screen:
+#
+#	sh sim/compare.sh HEAD~1 HEAD silent
+#
+# with ISRPROF set, that isrprof measures both instead, for what an older one doesn't
+# measure yet (as long as both revisions have the same interrupt vectors).  e.g. the
+# audio jitter of a change against the revision it is based on:
+#
+#	make -C sim isrprof && ISRPROF=$PWD/sim/isrprof sh sim/compare.sh <base> <change> song
+#
+# needs avr-gcc, simavr and libelf, like "make -C sim run-isrprof".
+#
+# usage: compare.sh rev1 rev2 [workload [ms]]
+#
+# Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+#	(attribution, non-commercial, share-alike)
+# 	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+#
+
+if [ $# -lt 2 ] || [ $# -gt 4 ]; then
+	echo "usage: $0 rev1 rev2 [workload [ms]]" >&2
+	exit 2
+fi
+workload=${3:-song}
+ms=${4:-2000}
+
+dir=$(mktemp -d) || exit 2
+trap 'git worktree remove --force "$dir/1" 2> /dev/null; git worktree remove --force "$dir/2" 2> /dev/null; rm -rf "$dir"' EXIT
+
+n=1
+for rev in "$1" "$2"; do
+	if ! git worktree add --detach "$dir/$n" "$rev" > /dev/null 2>&1; then
+		echo "$rev: no such revision" >&2
+		exit 2
+	fi
+	if ! make -s -C "$dir/$n" tri2s.elf > /dev/null; then
+		echo "$rev: tri2s.elf does not build" >&2
+		exit 1
+	fi
+	isrprof=${ISRPROF:-$dir/$n/sim/isrprof}
+	if [ -z "$ISRPROF" ] && ! make -s -C "$dir/$n/sim" isrprof > /dev/null; then
+		echo "$rev: sim/isrprof does not build" >&2
+		exit 1
+	fi
+	echo "== $rev ($(git log -1 --format=%s "$rev"))"
+	"$isrprof" -w "$workload" -t "$ms" "$dir/$n/tri2s.elf" || exit 1
+	n=2
+done
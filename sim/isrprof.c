@@ -0,0 +1,533 @@
+/*
+ *	isrprof.c - measures the timer interrupts of tri2s.elf in simavr
+ *
+ *	runs the firmware built by the Makefile in the simulator, instruction by instruction,
+ *	and counts the cycles of every timer interrupt, from its first instruction to the
+ *	RETI: the audio (TIMER1_OVF_vect, 20khz while a song or an effect plays) and the display
+ *	(TIMER2_COMPA_vect, 1khz), whose poll_switches() is counted on its own.  an audio
+ *	interrupt that comes in while the display interrupt reads the switches counts as audio
+ *	and not as switches.  so may the UART's (with LINK or TELEMETRY): they count for the
+ *	duty cycle only, and outside of the display interrupt as the main program.  the result is
+ *	the minimum, mean, 99th percentile and maximum per interrupt and part, and the share of
+ *	all cycles they take (the duty cycle; miggl.c quotes 40-44% for the audio and 12-14%
+ *	for the display, from when both ran in the 20khz interrupt).
+ *
+ *	workloads (-w):
+ *		silent		no song playing (SongPlayFlag cleared after the start)
+ *		song		the intro song, as after switching on
+ *		envelope	as song, but only the interrupts at a turn point of the envelope count
+ *					(Wdur at EnvPointStartAttack, ...Decay, ...Sustain or ...Release)
+ *		lineclear	a game is started with A, the bottom line of the field is filled
+ *					again and again so the next stone completes it
+ *		sfx			as lineclear, but the song of the game is stopped whenever the line is
+ *					filled, and only the audio interrupts without a song count: those of
+ *					the sound effects of the game (landing, lines, ...) alone
+ *
+ *	the 4 cycles to answer the interrupt and the JMP in the vector table are not counted.
+ *
+ *	the jitter of the audio samples is how much later than the earliest one an audio
+ *	interrupt starts, measured on the grid of the timer (SAMPLE_CYCLES): the new sample is
+ *	written to OCR1A at the start of do_audio_isr(), any delay is heard.
+ *	with -w envelope and -w sfx the duty cycle is that of the counted interrupts only.
+ *
+ *	the audio interrupts while a sound effect plays (SfxPlaying before or after them, so the
+ *	one that starts the effect is in) are listed once more on their own, counted or not: the
+ *	cost of an audio tick with an effect, with the song (-w lineclear) or without (-w sfx).
+ *
+ *	the addresses come from the symbol table of the ELF file, so it needs the symbols
+ *	(the Makefile keeps them, -g).  if poll_switches() got inlined into the interrupt its
+ *	share is counted as display, and a warning says so.
+ *
+ *	with -b the output is for "make perf-budget": lines of "name value", with the cycles of the
+ *	interrupts (all of them, the longest display interrupt and the audio ticks with an effect), the time from reset to the intro screen (the first swapbuffers()), and the work
+ *	of the main program per game frame (from one tri2s_step() to the next, without the time
+ *	spent waiting in swapbuffers() and sleep_ms() or in the interrupt).  the frames are only
+ *	there with -w lineclear and -w sfx, where a game is played.  if the firmware paints its free RAM
+ *	(../ramcheck.c), the deepest the stack got since the reset is there too.
+ *
+ *	with -u the bytes the firmware sends over the UART are written to a file, for the
+ *	telemetry of a "make TELEMETRY=1" build (see ../telemetry.h and host/telemetry).
+ *
+ *	-f is the clock the firmware was built for ("make F_CPU=..."), 8000000 by default.
+ *
+ *	before it prints anything it checks that the run makes sense, and fails if not: a display
+ *	interrupt every row (ROW_RATE), no more audio interrupts than AUDIO_RATE allows, audio
+ *	interrupts with a song and game frames with a game.  a failed check means the interrupts,
+ *	their RETI or the button were not seen right, and the numbers would be wrong.
+ *
+ *	usage: isrprof [-w workload] [-t ms] [-l lines] [-c columns] [-b] [-u file] [-f hz] file.elf
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "sim_io.h"
+#include "avr_ioport.h"
+#include "avr_uart.h"
+#include "symbols.h"
+
+#define MCU			"atmega168"
+#define BOOT_MS		300			// time to get to the intro screen, not measured
+#define PRESS_MS	300			// how long a button is held
+#define REFILL_MS	200			// lineclear: how often the bottom line is filled
+#define RAM_PAINT	0xC5		// see ../ramcheck.h
+#define SAMPLE_CYCLES	(Frequency / 20000)		// cycles between audio interrupts (AUDIO_RATE)
+#define ROW_RATE	1000		// display interrupts per second (see ../miggl-private.h)
+
+enum { W_SILENT, W_SONG, W_ENVELOPE, W_LINECLEAR, W_SFX };
+enum { P_TOTAL, P_AUDIO, P_DISPLAY, P_SWITCHES, PARTS };
+
+static const char* Workloads[] = { "silent", "song", "envelope", "lineclear", "sfx", NULL };
+static const char* Parts[PARTS] = { "total", "audio", "display", "switches" };
+
+static struct symbol AudioVector = { "__vector_13" };		// TIMER1_OVF_vect
+static struct symbol DisplayVector = { "__vector_7" };	// TIMER2_COMPA_vect
+static struct symbol UartRxVector = { "__vector_18" };	// USART_RX_vect
+static struct symbol UartTxVector = { "__vector_19" };	// USART_UDRE_vect
+static struct symbol Switches = { "poll_switches" };
+static struct symbol SongPlayFlag = { "SongPlayFlag" };
+static struct symbol SongLoopFlag = { "SongLoopFlag" };
+static struct symbol SfxPlaying = { "SfxPlaying" };
+static struct symbol Wdur = { "Wdur" };
+static struct symbol EnvPoints[4] = {
+	{ "EnvPointStartAttack" }, { "EnvPointStartDecay" }, { "EnvPointStartSustain" }, { "EnvPointStartRelease" }
+};
+static struct symbol Game = { "Game" };
+static struct symbol Swap = { "swapbuffers" };
+static struct symbol Sleep = { "sleep_ms" };
+static struct symbol Step = { "tri2s_step" };
+static struct symbol HeapStart = { "__heap_start" };	// end of the variables
+static struct symbol Paint = { "ram_paint" };			// paints the free RAM (ramcheck.c)
+
+static struct symbol* Symbols[] = {
+	&AudioVector, &DisplayVector, &Switches, &SongPlayFlag, &SongLoopFlag, &Wdur,
+	&EnvPoints[0], &EnvPoints[1], &EnvPoints[2], &EnvPoints[3], &Game,
+	&Swap, &Sleep, &Step, &HeapStart, &Paint, &UartRxVector, &UartTxVector, &SfxPlaying, NULL
+};
+
+// symbols that may be missing (inlined, no UART or a firmware without sound effects)
+static struct symbol* Optional[] = { &Switches, &Sleep, &HeapStart, &Paint, &UartRxVector, &UartTxVector, &SfxPlaying, NULL };
+
+/* cycles of the measured interrupts, per part */
+struct samples {
+	uint32_t* cycles;
+	size_t n, max;
+};
+
+static struct samples Samples[PARTS];
+static struct samples Frames;			// work of the main program per game frame
+static struct samples Jitter;			// start of the audio interrupts, on the timer's grid
+static struct samples SfxTicks;			// audio interrupts while a sound effect plays
+static FILE* Uart;						// -u: the UART output goes here
+static unsigned long Frequency = 8000000UL;		// -f: the F_CPU the firmware was built for
+
+
+static uint16_t read_word (avr_t* avr, const struct symbol* s) {
+	return avr->data[DATA(*s)] | (avr->data[DATA(*s) + 1] << 8);
+}
+
+static uint16_t read_sp (avr_t* avr) {
+	return avr->data[R_SPL] | (avr->data[R_SPH] << 8);
+}
+
+// returns 1 while the firmware plays a sound effect
+static int sfx_playing (avr_t* avr) {
+	return SfxPlaying.addr && avr->data[DATA(SfxPlaying)];
+}
+
+//
+// returns 1 if the interrupt about to run is at a turn point of the envelope
+//
+static int at_turn_point (avr_t* avr) {
+	uint16_t w = read_word(avr, &Wdur);
+	int i;
+
+	if (!avr->data[DATA(SongPlayFlag)])
+		return 0;
+	for (i = 0; i < 4; i++)
+		if (w == read_word(avr, &EnvPoints[i]))
+			return 1;
+	return 0;
+}
+
+//
+// returns 1 if the interrupt about to run counts for the workload
+//
+static int counted (avr_t* avr, int workload, int isr) {
+	if (workload == W_ENVELOPE)
+		return (isr == P_AUDIO) && at_turn_point(avr);
+	if ((workload == W_SFX) && (isr == P_AUDIO))
+		return !avr->data[DATA(SongPlayFlag)];
+	return 1;
+}
+
+static void add_sample (struct samples* s, uint32_t cycles) {
+	if (s->n == s->max) {
+		s->max = s->max ? 2 * s->max : 65536;
+		s->cycles = realloc(s->cycles, s->max * sizeof(*s->cycles));
+	}
+	s->cycles[s->n++] = cycles;
+}
+
+static int compare (const void* a, const void* b) {
+	uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+	return (x > y) - (x < y);
+}
+
+static double mean (const struct samples* s) {
+	uint64_t sum = 0;
+	size_t i;
+	for (i = 0; i < s->n; i++)
+		sum += s->cycles[i];
+	return (double)sum / s->n;
+}
+
+//
+// adds the start of an audio interrupt to the jitter: where it is on the timer's grid,
+// from the first one on.  SAMPLE_CYCLES / 2 is added so early ones don't wrap around,
+// jitter_spread() takes the earliest one as 0.
+//
+static void add_jitter (uint64_t cycle) {
+	static uint64_t first;
+
+	if (!Jitter.n)
+		first = cycle;
+	add_sample(&Jitter, (cycle - first + SAMPLE_CYCLES / 2) % SAMPLE_CYCLES);
+}
+
+//
+// sorts the jitter samples and makes them relative to the earliest start
+//
+static void jitter_spread (void) {
+	size_t i;
+
+	qsort(Jitter.cycles, Jitter.n, sizeof(*Jitter.cycles), compare);
+	for (i = Jitter.n; i-- > 0; )
+		Jitter.cycles[i] -= Jitter.cycles[0];
+}
+
+//
+// returns 1 if pc is the start of one of the interrupts that may come in while the display
+// interrupt reads the switches
+//
+static int nests (uint32_t pc) {
+	return (pc == AudioVector.addr) || (UartRxVector.addr && (pc == UartRxVector.addr)) ||
+		(UartTxVector.addr && (pc == UartTxVector.addr));
+}
+
+//
+// holds a button (0 = A ... 3 = D) down or lets it go: the switches are read on PC1 - PC4
+//
+static void button (avr_t* avr, int b, int down) {
+	avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('C'), 1 + b), down);
+}
+
+//
+// fills the bottom line of the game's field (field_t is the smallest type that holds lines + 1 bits)
+//
+static void fill_bottom_line (avr_t* avr, int lines, int columns) {
+	int bytes = (lines < 8) ? 1 : (lines < 16) ? 2 : (lines < 32) ? 4 : 8;
+	int bit = lines;					// FIELD_BIT(lines - 1)
+	int i;
+
+	for (i = 0; i < columns; i++)
+		avr->data[DATA(Game) + i * bytes + bit / 8] |= 1 << (bit % 8);
+}
+
+//
+// checks the run of a workload over ms milliseconds that saw the given numbers of audio and
+// display interrupts and game frames, returns 0 (and says why) if it can't be measured right
+//
+static int check_run (int workload, unsigned long ms, unsigned long audio, unsigned long display, size_t frames) {
+	unsigned long rows = ms * ROW_RATE / 1000;
+
+	if ((display + rows / 50 + 2 < rows) || (display > rows + rows / 50 + 2)) {
+		fprintf(stderr, "error: %lu display interrupts in %lu ms, not about %lu: the interrupts or their RETI are not seen\n",
+			display, ms, rows);
+		return 0;
+	}
+	if (audio > ms * 20 + 2) {
+		fprintf(stderr, "error: %lu audio interrupts in %lu ms, more than the timer makes\n", audio, ms);
+		return 0;
+	}
+	if ((workload != W_SILENT) && !audio) {
+		fprintf(stderr, "error: no audio interrupts, although a song should play\n");
+		return 0;
+	}
+	if (((workload == W_LINECLEAR) || (workload == W_SFX)) && !frames) {
+		fprintf(stderr, "error: no game frames, the game did not start (the A button not seen?)\n");
+		return 0;
+	}
+	return 1;
+}
+
+//
+// writes a byte the firmware sent over the UART
+//
+static void uart_output (struct avr_irq_t* irq, uint32_t value, void* param) {
+	fputc(value, Uart);
+}
+
+int main (int argc, char** argv) {
+	elf_firmware_t f;
+	avr_t* avr;
+	int c, i, workload = W_SONG, lines = 7, columns = 5, budget = 0;
+	unsigned long ms = 2000;
+	uint64_t start, end, next, isrcycles = 0, partcycles[PARTS] = { 0 }, boot = 0, work = 0;
+	uint32_t part[PARTS], nestcycles = 0;
+	uint16_t isrsp = 0, callsp = 0, nestsp = 0;
+	int inisr = 0, isr = P_AUDIO, incall = P_DISPLAY, counts = 0, sawswitches = 0, stepped = 0;
+	int nested = 0, nestcounts = 0, sfx = 0, nestsfx = 0;
+	unsigned long seen[PARTS] = { 0 };		// interrupts, counted or not
+	size_t n;
+
+	while ((c = getopt(argc, argv, "w:t:l:c:bu:f:")) != -1) {
+		switch (c) {
+			case 'w':
+				for (workload = 0; Workloads[workload] && strcmp(Workloads[workload], optarg); workload++)
+					;
+				if (!Workloads[workload]) {
+					fprintf(stderr, "workloads: silent, song, envelope, lineclear, sfx\n");
+					return 2;
+				}
+				break;
+			case 't': ms = strtoul(optarg, NULL, 0); break;
+			case 'l': lines = atoi(optarg); break;
+			case 'c': columns = atoi(optarg); break;
+			case 'b': budget = 1; break;
+			case 'f': Frequency = strtoul(optarg, NULL, 0); break;
+			case 'u':
+				if (!(Uart = fopen(optarg, "wb"))) {
+					perror(optarg);
+					return 2;
+				}
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-w workload] [-t ms] [-l lines] [-c columns] [-b] [-u file] [-f hz] file.elf\n", argv[0]);
+				return 2;
+		}
+	}
+	if (optind + 1 != argc) {
+		fprintf(stderr, "usage: %s [-w workload] [-t ms] [-l lines] [-c columns] [-b] [-u file] [-f hz] file.elf\n", argv[0]);
+		return 2;
+	}
+	if (!read_symbols(argv[optind], Symbols, Optional))
+		return 2;
+	if (!Switches.addr)
+		fprintf(stderr, "warning: no poll_switches (inlined?), the switches count as display\n");
+
+	if (elf_read_firmware(argv[optind], &f)) {
+		fprintf(stderr, "%s: can't load\n", argv[optind]);
+		return 2;
+	}
+	if (!(avr = avr_make_mcu_by_name(MCU))) {
+		fprintf(stderr, "simavr does not know the %s\n", MCU);
+		return 2;
+	}
+	avr_init(avr);
+	avr->frequency = Frequency;
+	avr_load_firmware(avr, &f);
+	if (Uart) {
+		uint32_t flags = 0;
+		avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+		flags &= ~AVR_UART_FLAG_STDIO;					// not to the console as well
+		avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+		avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUTPUT), uart_output, NULL);
+	}
+
+	// get to the intro screen
+	while (avr->cycle < Frequency / 1000 * BOOT_MS) {
+		avr_run(avr);
+		if (!boot && (avr->pc == Swap.addr))
+			boot = avr->cycle;
+	}
+	if ((workload == W_SILENT) || (workload == W_SFX)) {
+		avr->data[DATA(SongLoopFlag)] = 0;
+		avr->data[DATA(SongPlayFlag)] = 0;
+	}
+	if ((workload == W_LINECLEAR) || (workload == W_SFX))
+		button(avr, 0, 1);
+
+	start = avr->cycle;
+	end = start + Frequency / 1000 * ms;
+	next = start + Frequency / 1000 * PRESS_MS;
+	while (avr->cycle < end) {
+		uint32_t pc = avr->pc;
+		uint64_t before = avr->cycle;
+		int state = avr_run(avr);
+		uint32_t dc = avr->cycle - before;
+
+		if ((state == cpu_Done) || (state == cpu_Crashed)) {
+			fprintf(stderr, "the firmware stopped at pc %04x\n", avr->pc);
+			return 1;
+		}
+
+		// the instruction just run took dc cycles, it belongs to the part we were in
+		if (nested) {
+			nestcycles += dc;
+		} else if (inisr) {
+			part[incall] += dc;
+			part[P_TOTAL] += dc;
+		} else if (!in_symbol(&Swap, pc) && !in_symbol(&Sleep, pc))
+			work += dc;
+
+		if (!inisr && (avr->pc == Step.addr)) {			// the next game frame
+			if (stepped)
+				add_sample(&Frames, work);
+			stepped = 1;
+			work = 0;
+		}
+
+		if (avr->pc == AudioVector.addr)
+			add_jitter(avr->cycle);
+
+		if (nested) {
+			if (read_sp(avr) > nestsp) {				// RETI of the audio interrupt
+				nested = 0;
+				if ((nestsfx == 2) || (nestsfx && sfx_playing(avr)))
+					add_sample(&SfxTicks, nestcycles);
+				if (nestcounts) {
+					add_sample(&Samples[P_TOTAL], nestcycles);
+					add_sample(&Samples[P_AUDIO], nestcycles);
+					partcycles[P_TOTAL] += nestcycles;
+					partcycles[P_AUDIO] += nestcycles;
+				}
+				isrcycles += nestcycles;
+			}
+		} else if (inisr && (isr == P_DISPLAY) && nests(avr->pc)) {	// nested in the display
+			nested = 1;
+			nestsp = read_sp(avr);
+			nestcycles = 0;
+			nestcounts = 0;
+			nestsfx = 0;
+			if (avr->pc == AudioVector.addr) {
+				seen[P_AUDIO]++;
+				nestcounts = counted(avr, workload, P_AUDIO);
+				nestsfx = 1 + sfx_playing(avr);		// 1: audio, 2: with an effect
+			}
+		} else if (!inisr && ((avr->pc == AudioVector.addr) || (avr->pc == DisplayVector.addr))) {	// an interrupt starts
+			inisr = 1;
+			isrsp = read_sp(avr);
+			isr = incall = (avr->pc == AudioVector.addr) ? P_AUDIO : P_DISPLAY;
+			seen[isr]++;
+			memset(part, 0, sizeof(part));
+			counts = counted(avr, workload, isr);
+			sfx = (isr == P_AUDIO) && sfx_playing(avr);
+		} else if (inisr && (incall == P_DISPLAY) && Switches.addr && (avr->pc == Switches.addr)) {
+			incall = P_SWITCHES;
+			callsp = read_sp(avr);
+			sawswitches = 1;
+		} else if (inisr && (incall == P_SWITCHES) && (read_sp(avr) > callsp)) {
+			incall = P_DISPLAY;							// back from the call
+		} else if (inisr && (read_sp(avr) > isrsp)) {	// RETI
+			inisr = 0;
+			if ((isr == P_AUDIO) && (sfx || sfx_playing(avr)))
+				add_sample(&SfxTicks, part[P_TOTAL]);
+			if (counts)
+				for (i = 0; i < PARTS; i++) {
+					if ((i == P_TOTAL) || (i == isr) || ((i == P_SWITCHES) && (isr == P_DISPLAY))) {
+						add_sample(&Samples[i], part[i]);
+						partcycles[i] += part[i];
+					}
+				}
+			isrcycles += part[P_TOTAL];
+		}
+
+		if (avr->cycle >= next) {
+			if ((workload == W_LINECLEAR) || (workload == W_SFX)) {
+				button(avr, 0, 0);
+				fill_bottom_line(avr, lines, columns);
+			}
+			if (workload == W_SFX) {
+				avr->data[DATA(SongLoopFlag)] = 0;
+				avr->data[DATA(SongPlayFlag)] = 0;
+			}
+			next += Frequency / 1000 * REFILL_MS;
+		}
+	}
+
+	if (Switches.addr && !sawswitches)
+		fprintf(stderr, "warning: poll_switches was never called from the interrupt (inlined?)\n");
+	if (!check_run(workload, ms, seen[P_AUDIO], seen[P_DISPLAY], Frames.n))
+		return 1;
+
+	n = Samples[P_TOTAL].n;
+	if (budget) {
+		struct samples* s = &Samples[P_TOTAL];
+		if (n == 0)
+			return 1;
+		qsort(s->cycles, n, sizeof(*s->cycles), compare);
+		printf("cycles.boot %" PRIu64 "\n", boot);
+		printf("cycles.isr.mean %.0f\n", mean(s));
+		printf("cycles.isr.p99 %" PRIu32 "\n", s->cycles[n * 99 / 100]);
+		printf("cycles.isr.max %" PRIu32 "\n", s->cycles[n - 1]);
+		printf("permille.isr.duty %.0f\n", 1000.0 * isrcycles / (end - start));
+		if (Jitter.n) {
+			jitter_spread();
+			printf("cycles.audio.jitter.p99 %" PRIu32 "\n", Jitter.cycles[Jitter.n * 99 / 100]);
+			printf("cycles.audio.jitter.max %" PRIu32 "\n", Jitter.cycles[Jitter.n - 1]);
+		}
+		if (Samples[P_DISPLAY].n) {
+			s = &Samples[P_DISPLAY];
+			qsort(s->cycles, s->n, sizeof(*s->cycles), compare);
+			printf("cycles.display.max %" PRIu32 "\n", s->cycles[s->n - 1]);
+		}
+		if (SfxTicks.n) {
+			qsort(SfxTicks.cycles, SfxTicks.n, sizeof(*SfxTicks.cycles), compare);
+			printf("cycles.audio.sfx.p99 %" PRIu32 "\n", SfxTicks.cycles[SfxTicks.n * 99 / 100]);
+			printf("cycles.audio.sfx.max %" PRIu32 "\n", SfxTicks.cycles[SfxTicks.n - 1]);
+		}
+		if (Frames.n) {
+			qsort(Frames.cycles, Frames.n, sizeof(*Frames.cycles), compare);
+			printf("cycles.frame.mean %.0f\n", mean(&Frames));
+			printf("cycles.frame.max %" PRIu32 "\n", Frames.cycles[Frames.n - 1]);
+		}
+		if (Paint.addr && HeapStart.addr) {
+			uint32_t p = DATA(HeapStart);
+			while ((p <= avr->ramend) && (avr->data[p] == RAM_PAINT))
+				p++;
+			printf("bytes.stack.peak %" PRIu32 "\n", avr->ramend + 1 - p);
+		}
+		return 0;
+	}
+	printf("workload %s: %zu interrupts in %lu ms, interrupt duty cycle %.1f%%\n",
+		Workloads[workload], n, ms, 100.0 * isrcycles / (end - start));
+	if (n == 0)
+		return 1;
+	printf("%-10s %8s %8s %8s %8s %8s\n", "cycles", "min", "mean", "p99", "max", "duty");
+	for (i = 0; i < PARTS; i++) {
+		struct samples* s = &Samples[i];
+		if (s->n == 0) {
+			printf("%-10s %8s\n", Parts[i], "-");		// e.g. no audio interrupt while silent
+			continue;
+		}
+		qsort(s->cycles, s->n, sizeof(*s->cycles), compare);
+		printf("%-10s %8" PRIu32 " %8.1f %8" PRIu32 " %8" PRIu32 " %7.1f%%\n", Parts[i],
+			s->cycles[0], (double)partcycles[i] / s->n, s->cycles[s->n * 99 / 100], s->cycles[s->n - 1],
+			100.0 * partcycles[i] / (end - start));
+	}
+	if (Jitter.n) {
+		jitter_spread();
+		printf("audio sample jitter: p99 %" PRIu32 ", max %" PRIu32 " cycles (of %lu per sample)\n",
+			Jitter.cycles[Jitter.n * 99 / 100], Jitter.cycles[Jitter.n - 1], SAMPLE_CYCLES);
+	}
+	if (SfxTicks.n) {
+		qsort(SfxTicks.cycles, SfxTicks.n, sizeof(*SfxTicks.cycles), compare);
+		printf("audio with a sound effect: %zu interrupts, mean %.1f, p99 %" PRIu32 ", max %" PRIu32
+			" cycles (of %lu per sample)\n", SfxTicks.n, mean(&SfxTicks),
+			SfxTicks.cycles[SfxTicks.n * 99 / 100], SfxTicks.cycles[SfxTicks.n - 1], SAMPLE_CYCLES);
+	} else if ((workload == W_SFX) && SfxPlaying.addr) {
+		fprintf(stderr, "no audio interrupt with a sound effect\n");
+		return 1;
+	}
+	return 0;
+}
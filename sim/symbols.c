@@ -0,0 +1,71 @@
+/*
+ *	symbols.c - the symbols of the firmware, for the simulator tools
+ *
+ *	(see symbols.h)
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <gelf.h>
+
+#include "symbols.h"
+
+
+//
+// looks up the symbols (a list ending with NULL) in the ELF file, returns 0 if one of them
+// is missing, unless it is in the list of optional ones (that may be inlined, say)
+//
+int read_symbols (const char* file, struct symbol** symbols, struct symbol** optional) {
+	Elf* elf;
+	Elf_Scn* scn = NULL;
+	GElf_Shdr shdr;
+	GElf_Sym sym;
+	Elf_Data* data;
+	int fd, i, j;
+
+	elf_version(EV_CURRENT);
+	if ((fd = open(file, O_RDONLY)) < 0 || !(elf = elf_begin(fd, ELF_C_READ, NULL))) {
+		perror(file);
+		return 0;
+	}
+	while ((scn = elf_nextscn(elf, scn))) {
+		gelf_getshdr(scn, &shdr);
+		if (shdr.sh_type != SHT_SYMTAB)
+			continue;
+		data = elf_getdata(scn, NULL);
+		for (i = 0; i < shdr.sh_size / shdr.sh_entsize; i++) {
+			gelf_getsym(data, i, &sym);
+			for (j = 0; symbols[j]; j++)
+				if (!strcmp(elf_strptr(elf, shdr.sh_link, sym.st_name), symbols[j]->name)) {
+					symbols[j]->addr = sym.st_value;
+					symbols[j]->size = sym.st_size;
+				}
+		}
+	}
+	elf_end(elf);
+	close(fd);
+
+	for (j = 0; symbols[j]; j++) {
+		for (i = 0; optional && optional[i] && (optional[i] != symbols[j]); i++)
+			;
+		if (!symbols[j]->addr && !(optional && optional[i])) {
+			fprintf(stderr, "%s: no symbol %s\n", file, symbols[j]->name);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+//
+// returns 1 if pc is in the function s
+//
+int in_symbol (const struct symbol* s, uint32_t pc) {
+	return s->addr && (pc >= s->addr) && (pc < s->addr + s->size);
+}
@@ -0,0 +1,29 @@
+/*
+ *	symbols.h - the symbols of the firmware, for the simulator tools
+ *
+ *	(moved here from isrprof.c)  the tools find functions and variables of the firmware by
+ *	name in the symbol table of the ELF file, so it has to keep them (the Makefile does, -g).
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#ifndef SIM_SYMBOLS_H
+#define SIM_SYMBOLS_H
+
+#include <inttypes.h>
+
+#define DATA(sym)	((sym).addr - 0x800000)	// SRAM symbols are at 0x800000 in the ELF file
+
+/* a symbol of the firmware */
+struct symbol {
+	const char* name;
+	uint32_t addr;
+	uint32_t size;
+};
+
+int read_symbols (const char* file, struct symbol** symbols, struct symbol** optional);
+int in_symbol (const struct symbol* s, uint32_t pc);
+
+#endif /* SIM_SYMBOLS_H */
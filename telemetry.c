@@ -0,0 +1,137 @@
+/*
+ *	telemetry.c - records about the running game, sent over the UART
+ *
+ *	(see telemetry.h)  a record costs about 150 cycles of the main program, and
+ *	about 30 cycles of interrupt per byte while it is sent.
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <avr/io.h>
+#include "mydefs.h"
+#include "miggl.h"
+#include "uart.h"
+#include "ramcheck.h"
+#include "telemetry.h"
+
+static uint8_t Dropped;			// records that did not fit into the ring
+static uint8_t Frames;			// frames until the next T_STATS
+static uint16_t SearchSent[2];	// the search times of the last T_SEARCH
+
+
+void telemetry_init (void) {
+	uart_init();
+	Dropped = 0;
+	Frames = STATS_FRAMES;
+	SearchSent[0] = SearchSent[1] = 0;
+}
+
+//
+// sends a record, returns 0 if it was dropped
+//
+uint8_t telemetry_send (uint8_t type, const uint8_t* payload, uint8_t len) {
+	uint8_t buf[TELEMETRY_MAXLEN + 4];
+	uint8_t i, sum;
+
+	buf[0] = TELEMETRY_SYNC;
+	buf[1] = type;
+	buf[2] = len;
+	sum = type + len;
+	for (i = 0; i < len; i++) {
+		buf[3 + i] = payload[i];
+		sum += payload[i];
+	}
+	buf[3 + len] = -sum;
+	if (!uart_write(buf, len + 4)) {
+		Dropped++;
+		return 0;
+	}
+	return 1;
+}
+
+#ifdef PROFILE
+//
+// sends the longest times of the sections of the main loop and the frame time histogram
+// since the last time, then starts over
+//
+static void telemetry_profile (void) {
+	uint8_t p[TELEMETRY_MAXLEN];
+	uint16_t rate = prof_counts_ms();
+	uint8_t i;
+
+	for (i = 0; i < PROF_SCOPES; i++) {
+		p[2 * i] = ProfScope[i].max;
+		p[2 * i + 1] = ProfScope[i].max >> 8;
+	}
+	p[2 * PROF_SCOPES] = FrameMissed;
+	p[2 * PROF_SCOPES + 1] = FrameMissed >> 8;
+	p[2 * PROF_SCOPES + 2] = rate;
+	p[2 * PROF_SCOPES + 3] = rate >> 8;
+	telemetry_send(T_PROFILE, p, 2 * PROF_SCOPES + 4);
+
+	for (i = 0; i < FRAME_BINS; i++)
+		p[i] = (FrameHist[i] > 0xFF) ? 0xFF : FrameHist[i];
+	telemetry_send(T_HIST, p, FRAME_BINS);
+	prof_reset();
+}
+#endif
+
+//
+// sends the time left of a frame, and every STATS_FRAMES frames the statistics
+//
+void telemetry_frame (uint16_t ticksleft) {
+	uint8_t p[6];
+	uint16_t ram;
+
+	p[0] = ticksleft;
+	p[1] = ticksleft >> 8;
+	telemetry_send(T_FRAME, p, 2);
+
+	if (--Frames)
+		return;
+	Frames = STATS_FRAMES;
+	isrtime(&p[0], &p[1]);
+	ram = ram_free_min();
+	p[2] = ram;
+	p[3] = ram >> 8;
+	p[4] = ButtonDrops;
+	p[5] = Dropped;
+	telemetry_send(T_STATS, p, 6);
+#ifdef PROFILE
+	telemetry_profile();
+#endif
+}
+
+//
+// sends the events of a game step
+//
+void telemetry_game (uint8_t events, uint8_t level, uint8_t lines) {
+	uint8_t p[3];
+
+	p[0] = events;
+	p[1] = level;
+	p[2] = lines;
+	telemetry_send(T_GAME, p, 3);
+}
+
+//
+// sends the worst times of the demo player's search, if they changed since the last time
+//
+void telemetry_search (uint16_t stepticks, uint16_t frameticks) {
+	uint8_t p[4];
+
+	if ((stepticks == SearchSent[0]) && (frameticks == SearchSent[1]))
+		return;
+	p[0] = stepticks;
+	p[1] = stepticks >> 8;
+	p[2] = frameticks;
+	p[3] = frameticks >> 8;
+	if (telemetry_send(T_SEARCH, p, 4)) {
+		SearchSent[0] = stepticks;
+		SearchSent[1] = frameticks;
+	}
+}
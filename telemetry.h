@@ -0,0 +1,48 @@
+/*
+ *	telemetry.h - records about the running game, sent over the UART
+ *
+ *	built with "make TELEMETRY=1".  each record is a frame of
+ *
+ *		TELEMETRY_SYNC, type, length of the payload, payload, checksum
+ *
+ *	where the checksum makes the sum of type, length, payload and checksum 0 (mod 256).
+ *	a reader that lost track looks for the next TELEMETRY_SYNC whose frame adds up.
+ *	numbers are low byte first.  a record that does not fit into the UART's ring is
+ *	dropped as a whole and counted, the game never waits for the line.
+ *	host/telemetry decodes the records, sim/isrprof -u captures them from simavr.
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <inttypes.h>
+
+#define TELEMETRY_SYNC		0xA5
+#define TELEMETRY_MAXLEN	12			// longest payload
+
+/* record types and their payload */
+#define T_FRAME		1		// uint16 timer ticks (50us) left at the end of the frame
+#define T_STATS		2		// uint8 ISR time max, uint8 mean (8 cycle units), uint16 least free RAM,
+							// uint8 button presses lost, uint8 records dropped (both count up and wrap)
+#define T_GAME		3		// uint8 events (EV_*), uint8 level, uint8 solved lines
+#define T_PROFILE	4		// with PROFILE: uint16 longest render, input, logic and line clearing
+							// (prof_now() counts, see miggl.h), uint16 frames that missed the
+							// deadline, uint16 counts per millisecond (prof_counts_ms())
+#define T_HIST		5		// with PROFILE: FRAME_BINS uint8 frames by the tenths of the frame
+							// they took, the last bin for longer
+#define T_SEARCH	6		// uint16 worst timer ticks (50us) of a line of the demo player's
+							// search, uint16 worst in one frame (sent when they grow)
+
+#define STATS_FRAMES	10		// frames per T_STATS record (and T_PROFILE, T_HIST)
+
+void telemetry_init (void);
+uint8_t telemetry_send (uint8_t type, const uint8_t* payload, uint8_t len);
+void telemetry_frame (uint16_t ticksleft);
+void telemetry_game (uint8_t events, uint8_t level, uint8_t lines);
+void telemetry_search (uint16_t stepticks, uint16_t frameticks);
+
+#endif /* TELEMETRY_H */
@@ -0,0 +1,283 @@
+/*
+ *	tri2s-ai.c - computer player for Tri2s
+ *
+ *	(see tri2s-ai.h)
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#include <inttypes.h>
+#include "tri2s-ai.h"
+
+struct ai_weights AiWeights = { 80, -50, -35, -18 };
+
+AI_LOCAL struct ai_stats AiStats;
+
+
+#if AI_CACHE_BITS > 0
+//
+// cache of field scores, indexed by a hash of the field
+//
+struct ai_cache_entry {
+	uint64_t key;			// full hash of the field (0 is empty)
+	int32_t score;
+};
+
+static AI_LOCAL struct ai_cache_entry AiCache[1UL << AI_CACHE_BITS];
+
+static uint64_t hash_field (const field_t* field) {
+	uint64_t h = 0xcbf29ce484222325ULL;
+	uint8_t i;
+	for (i = 0; i < FIELD_WIDTH; i++) {
+		h ^= (uint64_t)field[i];
+		h *= 0x100000001b3ULL;
+		h ^= h >> 29;
+	}
+	return h | 1;
+}
+#endif
+
+
+//
+// returns the number of set bits
+//
+static uint8_t count_bits (field_t m) {
+	uint8_t n = 0;
+	for (; m; m &= m - 1)
+		n++;
+	return n;
+}
+
+//
+// scores a field without the stone's lines: height, holes and bumpiness
+//
+int32_t ai_score_field (const field_t* field) {
+	int32_t height = 0, holes = 0, bumpiness = 0;
+	int8_t h, lasth = -1;
+	uint8_t i;
+
+#if AI_CACHE_BITS > 0
+	uint64_t key = hash_field(field);
+	struct ai_cache_entry* e = &AiCache[key & ((1UL << AI_CACHE_BITS) - 1)];
+	if (e->key == key) {
+		AiStats.cachehits++;
+		return e->score;
+	}
+#endif
+
+	for (i = 0; i < FIELD_WIDTH; i++) {
+		field_t c = field[i];
+		field_t top = c & -c;					// top-most filled cell of the column
+		h = 0;
+		if (top) {
+			h = FIELD_LINES + 1 - count_bits(top - 1);
+			holes += count_bits(~c & ~((top << 1) - 1) & (field_t)(FIELD_LINEMASK | 1));
+		}
+		height += h;
+		if (lasth >= 0)
+			bumpiness += (h > lasth) ? (h - lasth) : (lasth - h);
+		lasth = h;
+	}
+
+	height = height * AiWeights.height + holes * AiWeights.holes + bumpiness * AiWeights.bumpiness;
+
+#if AI_CACHE_BITS > 0
+	e->key = key;
+	e->score = height;
+#endif
+	return height;
+}
+
+//
+// scores the stone landing at (x y)
+//
+int32_t ai_evaluate (const field_t* field, uint8_t stone, int8_t x, int8_t y) {
+	field_t f[FIELD_WIDTH];
+	field_t lines;
+	uint8_t i;
+
+	AiStats.placements++;
+	if (x <= 0)			// lands in the hidden line ... game over
+		return AI_LOST;
+
+	for (i = 0; i < FIELD_WIDTH; i++)
+		f[i] = field[i];
+	field_place_stone(f, stone, x, y);
+	lines = field_complete_lines(f);
+	if (lines)
+		field_remove_lines(f, lines);
+
+	return ai_score_field(f) + (int32_t)count_bits(lines) * AiWeights.lines;
+}
+
+//
+// starts looking for the best place for a stone which is at (x y) now.
+//
+// every place the stone can reach is looked at, by sweeping the field line by line:
+// in each line the stone is moved and rotated as far as it gets, then everything that
+// can fall goes on to the next line and everything else has landed.
+// each call of ai_search_step() does one line, so the search can be spread over frames.
+//
+void ai_search_begin (struct ai_search* ss, const field_t* field, uint8_t stone, int8_t x, int8_t y) {
+	uint8_t i, n;
+
+	AiStats.searches++;
+	for (i = 0; i < FIELD_WIDTH; i++) {
+		ss->field[i] = field[i];
+		ss->cur[i] = 0;
+	}
+	ss->cur[y] = 0x01;
+	ss->x = x;
+	ss->found = 0;
+	ss->done = 0;
+	ss->best.score = AI_LOST - 1;
+
+	ss->rot[0] = stone;
+	for (n = 1; n < 4; n++) {
+		ss->rot[n] = rotate_stone(ss->rot[n - 1]);
+		if (ss->rot[n] == stone)
+			break;
+	}
+	ss->n = n;
+}
+
+//
+// does the next line of a search, returns 1 when the search is done
+// (the result is in ss->best then)
+//
+uint8_t ai_search_step (struct ai_search* ss) {
+	const field_t* field = ss->field;
+	uint8_t* cur = ss->cur;
+	uint8_t* rot = ss->rot;
+	uint8_t n = ss->n;
+	int8_t x = ss->x;
+	uint8_t next[FIELD_WIDTH];
+	uint8_t r, i, changed, falling;
+	int32_t score;
+
+	if (ss->done)
+		return 1;
+
+	// move and rotate within this line as long as something new is reached
+	do {
+		changed = 0;
+		for (i = 0; i < FIELD_WIDTH; i++)
+			for (r = 0; r < n; r++) {
+				if (!(cur[i] & (1 << r)))
+					continue;
+				uint8_t rr = (r + 1 == n) ? 0 : (r + 1);
+				if (!(cur[i] & (1 << rr)) && stone_fits(field, rot[rr], x, i)) {
+					cur[i] |= 1 << rr;
+					changed = 1;
+				}
+				if ((i + 1 < FIELD_WIDTH) && !(cur[i + 1] & (1 << r)) && stone_fits(field, rot[r], x, i + 1)) {
+					cur[i + 1] |= 1 << r;
+					changed = 1;
+				}
+				if ((i > 0) && !(cur[i - 1] & (1 << r)) && stone_fits(field, rot[r], x, i - 1)) {
+					cur[i - 1] |= 1 << r;
+					changed = 1;
+				}
+			}
+	} while (changed);
+
+	// fall or land
+	falling = 0;
+	for (i = 0; i < FIELD_WIDTH; i++) {
+		next[i] = 0;
+		for (r = 0; r < n; r++) {
+			if (!(cur[i] & (1 << r)))
+				continue;
+			if (stone_fits(field, rot[r], x + 1, i)) {
+				next[i] |= 1 << r;
+				falling = 1;
+			} else {
+				score = ai_evaluate(field, rot[r], x, i);
+				ss->found++;
+				if (score > ss->best.score) {
+					ss->best.score = score;
+					ss->best.x = x;
+					ss->best.y = i;
+					ss->best.stone = rot[r];
+				}
+			}
+		}
+	}
+	for (i = 0; i < FIELD_WIDTH; i++)
+		cur[i] = next[i];
+	ss->x++;
+	if (!falling || ss->x > FIELD_LINES)
+		ss->done = 1;
+	return ss->done;
+}
+
+//
+// finds the best place for a stone which is at (x y) now,
+// returns the number of places found (there is always at least one).
+//
+uint16_t ai_search (const field_t* field, uint8_t stone, int8_t x, int8_t y, struct ai_move* best) {
+	struct ai_search ss;
+
+	ai_search_begin(&ss, field, stone, x, y);
+	while (!ai_search_step(&ss))
+		;
+	*best = ss.best;
+	return ss.found;
+}
+
+//
+// returns the input that brings the stone of game s closer to target t,
+// f is the field without complete lines.  returns AI_BLOCKED if the stone can't
+// get there from where it is.
+//
+uint8_t ai_steer (const struct ai_move* t, const field_t* f, const struct tri2s_state* s) {
+	if (s->stone != t->stone && can_rotate_stone(f, s->stone, s->stonex, s->stoney))
+		return IN_ROTATE;
+	if (s->stoney < t->y && can_move_stone(f, s->stone, s->stonex, s->stoney + 1))
+		return IN_LEFT;
+	if (s->stoney > t->y && can_move_stone(f, s->stone, s->stonex, s->stoney - 1))
+		return IN_RIGHT;
+	if (s->stone == t->stone && s->stoney == t->y)
+		return 0;					// on its way, let it fall
+	return AI_BLOCKED;
+}
+
+//
+// copies the field of game s as it will be when the complete lines are gone
+//
+void ai_settled_field (field_t* f, const struct tri2s_state* s) {
+	uint8_t i;
+	for (i = 0; i < FIELD_WIDTH; i++)
+		f[i] = s->field[i];
+	field_remove_lines(f, s->lines);
+}
+
+//
+// returns the input for the next frame of the game, events are the events of the
+// last frame (see tri2s_step()).  a new target is searched for every new stone, and
+// again whenever the way to the target is blocked.
+//
+uint8_t ai_play (struct ai_player* p, const struct tri2s_state* s, uint8_t events) {
+	field_t f[FIELD_WIDTH];
+	uint8_t tries, input;
+
+	if (s->over)
+		return 0;
+	if (events & EV_LAND)
+		p->planned = 0;
+
+	ai_settled_field(f, s);
+	for (tries = 0; tries < 2; tries++) {
+		if (!p->planned) {
+			ai_search(f, s->stone, s->stonex, s->stoney, &p->target);
+			p->planned = 1;
+		}
+		input = ai_steer(&p->target, f, s);
+		if (input != AI_BLOCKED)
+			return input;
+		p->planned = 0;					// blocked, look again from here
+	}
+	return 0;
+}
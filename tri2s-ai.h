@@ -0,0 +1,93 @@
+/*
+ *	tri2s-ai.h - computer player for Tri2s
+ *
+ *	for each new stone the player looks at every place the stone can reach by moving,
+ *	rotating and falling (following the rules in tri2s-core.c), scores the field that
+ *	would result with a simple heuristic and then steers the stone there.
+ *
+ *	the heuristic is a weighted sum of the complete lines, the height of the stack,
+ *	the holes below it and how bumpy its surface is (see AiWeights).
+ *
+ *	with AI_CACHE_BITS > 0 the scores of fields already seen are kept in a hash table
+ *	of 2^AI_CACHE_BITS entries.  that is meant for the host; the device has no RAM for it.
+ *	the cache does not notice changes of AiWeights, so set them before the first search.
+ *
+ *	the cache and AiStats are global; a host tool that plays in several threads builds
+ *	this with -DAI_LOCAL=__thread, so every thread has its own.
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#ifndef TRI2S_AI_H
+#define TRI2S_AI_H
+
+#include <inttypes.h>
+#include "tri2s-core.h"
+
+#ifndef AI_CACHE_BITS
+#define AI_CACHE_BITS	0
+#endif
+
+#ifndef AI_LOCAL
+#define AI_LOCAL				// storage class of the cache and AiStats
+#endif
+
+/* weights of the heuristic, positive values are good */
+struct ai_weights {
+	int16_t lines;			// per complete line
+	int16_t height;			// per filled line of every column (sum of the column heights)
+	int16_t holes;			// per empty cell with something above it
+	int16_t bumpiness;		// per line of height difference between neighbouring columns
+};
+
+/* a place where a stone can land */
+struct ai_move {
+	int8_t x;				// line of the stone's center
+	int8_t y;				// column of the stone's center
+	uint8_t stone;			// the stone (rotated as it lands)
+	int32_t score;
+};
+
+/* a search in progress (see ai_search_begin()) */
+struct ai_search {
+	field_t field[FIELD_WIDTH];	// the field searched on
+	uint8_t cur[FIELD_WIDTH];	// per column: bit r set if rot[r] is reached in line x
+	uint8_t rot[4];				// the stone's rotations ...
+	uint8_t n;					// ... and how many there are
+	int8_t x;					// the next line to look at
+	uint8_t done;				// != 0 when the search is done
+	uint16_t found;				// landing places found so far
+	struct ai_move best;		// the best of them
+};
+
+/* a computer player */
+struct ai_player {
+	struct ai_move target;	// where the current stone should go
+	uint8_t planned;		// != 0 if target is valid for the current stone
+};
+
+/* statistics */
+struct ai_stats {
+	uint32_t searches;		// stones searched for
+	uint32_t placements;	// landing places scored
+	uint32_t cachehits;		// ... of them found in the cache
+};
+
+extern struct ai_weights AiWeights;
+extern AI_LOCAL struct ai_stats AiStats;
+
+#define AI_LOST		(-1000000L)		// score of a place that ends the game
+#define AI_BLOCKED	0xFF			// returned by ai_steer()
+
+int32_t ai_score_field (const field_t* field);
+int32_t ai_evaluate (const field_t* field, uint8_t stone, int8_t x, int8_t y);
+void ai_search_begin (struct ai_search* ss, const field_t* field, uint8_t stone, int8_t x, int8_t y);
+uint8_t ai_search_step (struct ai_search* ss);
+uint16_t ai_search (const field_t* field, uint8_t stone, int8_t x, int8_t y, struct ai_move* best);
+uint8_t ai_steer (const struct ai_move* t, const field_t* f, const struct tri2s_state* s);
+void ai_settled_field (field_t* f, const struct tri2s_state* s);
+uint8_t ai_play (struct ai_player* p, const struct tri2s_state* s, uint8_t events);
+
+#endif /* TRI2S_AI_H */
@@ -0,0 +1,183 @@
+/*
+ *	tri2s-anim.c - animations, played over the screen while the game goes on
+ *
+ *	(see tri2s-anim.h)
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "mydefs.h"
+#include "miggl.h"
+#include "tri2s-anim.h"
+
+struct anim {
+	const struct anim_step* anim;	// the animation, NULL if the slot is free
+	const struct anim_step* step;	// the first step drawn in this frame
+	uint8_t left;					// frames until the next step (ANIM_HOLD: never)
+	uint8_t mask;					// A_COLUMNS
+	uint8_t repeat;					// times it is played again, 0 for ever
+};
+
+// slot 0 is the screen, the others play over it
+static struct anim Anims[1 + ANIM_SLOTS];
+
+#define STEP_BYTE(step, field)	pgm_read_byte(&(step)->field)
+
+
+//
+// returns the frames of the steps drawn together from step on (see anim_step.frames)
+//
+static uint8_t step_frames (const struct anim_step* step) {
+	uint8_t frames;
+
+	while (!(frames = STEP_BYTE(step, frames)) && (STEP_BYTE(step, op) != A_END))
+		step++;
+	return frames;
+}
+
+//
+// starts an animation in a slot
+//
+static void begin (struct anim* p, const struct anim_step* a, uint8_t mask, uint8_t repeat) {
+	p->anim = p->step = a;
+	p->left = step_frames(a);
+	p->mask = mask;
+	p->repeat = repeat;
+	if (STEP_BYTE(a, op) == A_END)
+		p->anim = NULL;				// nothing to play
+}
+
+//
+// sets the animation that draws the whole screen, under all others.  it plays
+// again and again until it is replaced, NULL leaves the screen to the game.
+//
+void anim_screen (const struct anim_step* a) {
+	if (a)
+		begin(&Anims[0], a, 0, 0);
+	else
+		Anims[0].anim = NULL;
+}
+
+//
+// starts an animation over the screen, mask is the columns of A_COLUMNS.  it plays
+// repeat times, 0 for ever (until anim_stop()).  returns 0 if all slots are taken.
+//
+uint8_t anim_start (const struct anim_step* a, uint8_t mask, uint8_t repeat) {
+	uint8_t i;
+
+	for (i = 1; i <= ANIM_SLOTS; i++)
+		if (!Anims[i].anim) {
+			begin(&Anims[i], a, mask, repeat);
+			return 1;
+		}
+	return 0;
+}
+
+//
+// stops an animation wherever it plays, NULL stops all but the screen
+//
+void anim_stop (const struct anim_step* a) {
+	uint8_t i;
+
+	for (i = 1; i <= ANIM_SLOTS; i++)
+		if (!a || (Anims[i].anim == a))
+			Anims[i].anim = NULL;
+}
+
+//
+// returns 1 if an animation plays over the screen, NULL asks for any of them
+//
+uint8_t anim_playing (const struct anim_step* a) {
+	uint8_t i;
+
+	for (i = 1; i <= ANIM_SLOTS; i++)
+		if (Anims[i].anim && (!a || (Anims[i].anim == a)))
+			return 1;
+	return 0;
+}
+
+//
+// draws a step
+//
+static void draw_step (const struct anim_step* step, uint8_t mask) {
+	uint8_t x, y, bits, c;
+
+	setcolor(STEP_BYTE(step, color));
+	switch (STEP_BYTE(step, op)) {
+		case A_CLEAR:
+			cleardisplay();
+			break;
+		case A_BITMAP:
+			for (y = 0; y < YSCREEN; y++) {
+				bits = STEP_BYTE(step, rows[y]);
+				for (x = 0; x < XSCREEN; x++)
+					if (bits & (0x02 << x))
+						drawpoint(x, y);
+			}
+			break;
+		case A_COLUMNS:
+			for (x = 0; x < XSCREEN; x++)
+				if (mask & (0x02 << x))
+					drawfilledrect(x, 0, x, YSCREEN - 1);
+			break;
+		case A_RECOLOR:
+#ifdef PALETTE
+			for (c = 0; c < 4; c++)
+				setpalette(c, STEP_BYTE(step, rows[getpalette(c)]));
+#else
+			for (x = 0; x < XSCREEN; x++)
+				for (y = 0; y < YSCREEN; y++) {
+					c = readpixel(x, y);
+					setcolor(STEP_BYTE(step, rows[c]));
+					drawpoint(x, y);
+				}
+#endif
+			break;
+	}
+}
+
+//
+// draws the steps of an animation for this frame, then moves it on by a frame
+//
+static void play (struct anim* p) {
+	const struct anim_step* step = p->step;
+
+	for (;;) {
+		draw_step(step, p->mask);
+		if (STEP_BYTE(step, frames) || (STEP_BYTE(step, op) == A_END))
+			break;
+		step++;
+	}
+	if ((p->left == ANIM_HOLD) || --p->left)
+		return;
+
+	p->step = step + 1;
+	if (STEP_BYTE(p->step, op) == A_END) {
+		if (p->repeat && !--p->repeat) {
+			p->anim = NULL;
+			return;
+		}
+		p->step = p->anim;
+	}
+	p->left = step_frames(p->step);
+}
+
+//
+// draws all animations over the screen and moves them on, once per frame before swapbuffers()
+//
+void anim_frame (void) {
+	uint8_t i;
+
+#ifdef PALETTE
+	resetpalette();
+#endif
+	for (i = 0; i <= ANIM_SLOTS; i++)
+		if (Anims[i].anim)
+			play(&Anims[i]);
+}
@@ -0,0 +1,49 @@
+/*
+ *	tri2s-anim.h - animations, played over the screen while the game goes on
+ *
+ *	an animation is a list of steps in flash (PROGMEM), each shown for a number of frames.
+ *	anim_screen() sets the one that draws the whole screen (the intro, the game over),
+ *	anim_start() starts one over it or over the game (a blink, a flash), several can
+ *	play at once.  the game draws its screen and calls anim_frame() before every
+ *	swapbuffers(): that draws the current steps, the screen first, the others in the
+ *	order they were started, and advances them by a frame.  nothing ever waits.
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#ifndef TRI2S_ANIM_H
+#define TRI2S_ANIM_H
+
+#include <inttypes.h>
+#include "miggl.h"
+
+/* what a step draws */
+#define A_END		0		// the end of the animation
+#define A_NONE		1		// nothing (a pause)
+#define A_CLEAR		2		// clears the screen
+#define A_BITMAP	3		// the pixels of rows (bits 1 - 7 are x 0 - 6, see draw_bit_line()) in color
+#define A_COLUMNS	4		// fills the columns of anim_start()'s mask (same bits) with color
+#define A_RECOLOR	5		// pixels of color i become color rows[i], all of the screen
+
+#define ANIM_HOLD	0xFF	// frames of a step that stays until the animation is stopped
+#define ANIM_SLOTS	3		// animations that can play over the screen at once
+
+struct anim_step {
+	uint8_t frames;			// frames it is shown, 0 to draw the next step along with it
+	uint8_t op;				// A_*
+	uint8_t color;
+	uint8_t rows[YSCREEN];	// A_BITMAP, A_RECOLOR
+};
+
+void anim_screen (const struct anim_step* a);
+uint8_t anim_start (const struct anim_step* a, uint8_t mask, uint8_t repeat);
+void anim_stop (const struct anim_step* a);
+uint8_t anim_playing (const struct anim_step* a);
+void anim_frame (void);
+
+/* with PALETTE (see miggl.h) A_RECOLOR writes the palette instead of every pixel, and
+   anim_frame() resets it first.  it then recolors the overlays drawn after it too. */
+
+#endif /* TRI2S_ANIM_H */
@@ -0,0 +1,231 @@
+/*
+ *	tri2s-core.c - Tri2s game rules, independent of the Mignonette hardware
+ *
+ *	(moved here from gameloop() in tri2s.c; see tri2s-core.h)
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#include <inttypes.h>
+#include "tri2s-core.h"
+
+// the corner stones
+const uint8_t CornerStones[4] = {
+	UP | MIDDLE | RIGHT,
+	UP | LEFT | MIDDLE,
+	LEFT | MIDDLE | DOWN,
+	MIDDLE | RIGHT | DOWN
+};
+
+// the straight stones
+const uint8_t StraightStones[2] = {
+	UP | MIDDLE | DOWN,
+	LEFT | MIDDLE | RIGHT
+};
+
+// the difficulty of the game on the device
+const struct tri2s_difficulty Tri2sDifficulty = {
+	FALLTIME_START, FALLTIME_STEP, FALLTIME_MIN, LEVEL_LINES
+};
+
+
+//
+// calculates the next seeds and returns a "random" value between 0 and max
+// (same generator as nextrandom() in miggl.c, but with the seeds kept in the game state)
+//
+uint32_t tri2s_random (struct tri2s_state* s, uint32_t max) {
+	s->seeda = 36969 * (s->seeda & 65535) + (s->seeda >> 16);
+	s->seedb = 18000 * (s->seedb & 65535) + (s->seedb >> 16);
+ 	return ((s->seeda << 16) + s->seedb) % max;
+}
+
+//
+// gets a random stone and returns it
+//
+uint8_t get_random_stone (struct tri2s_state* s) {
+	uint8_t idx = (uint8_t) tri2s_random(s, 6);
+	if (idx < 4)
+		return CornerStones[idx];
+	return StraightStones[idx - 4];
+}
+
+//
+// rotates a stone, returns the rotated stone
+//
+uint8_t rotate_stone (uint8_t stone) {
+	// get idx of stone in CornerStones
+	int8_t  idx = -1;
+	uint8_t j = 0;
+	uint8_t isStraight = 0;
+	for (j = 0; j < 4; j++)
+		if (CornerStones[j] == stone) {
+			idx = j;
+			isStraight = 0;
+			break;
+		}
+	// if not found get idx of stone in StraightStones
+	if (idx == -1)
+		for (j = 0; j < 2; j++)
+			if (StraightStones[j] == stone) {
+				idx = j;
+				isStraight = 1;
+				break;
+			}
+	// if we found an idx ... return next idx in array
+	if (idx != -1) {
+		if (isStraight)
+			return StraightStones[(idx == 1) ? 0 : idx + 1];
+		else
+			return CornerStones[(idx == 3) ? 0 : (idx + 1)];
+	}
+	return 0;
+}
+
+//
+// tests wether a stone can be moved to a given position
+// returns 1 if they do or 0 otherwise
+//
+uint8_t can_move_stone (const field_t* field, uint8_t stone, int8_t x, int8_t y) {
+	// stone can be moved, if it stays within the field bounds and does not overlap
+	return stone_fits(field, stone, x, y);
+}
+
+//
+// tests wether a stone can be rotated
+// returns 1 if they do or 0 otherwise
+//
+uint8_t can_rotate_stone (const field_t* field, uint8_t stone, int8_t x, int8_t y) {
+	// stone can be rotated, if the rotated stone stays within the field bounds and does not overlap
+	return stone_fits(field, rotate_stone(stone), x, y);
+}
+
+//
+// finds the next complete line in the field, starting out from the bottom
+// returns the index of the line
+//
+int8_t get_complete_line (const field_t* field) {
+	return field_complete_line(field);
+}
+
+//
+// starts a new game, the seed selects the sequence of stones
+//
+void tri2s_init (struct tri2s_state* s, uint32_t seed) {
+	tri2s_init_difficulty(s, seed, &Tri2sDifficulty);
+}
+
+//
+// starts a new game with another difficulty than the device's (the host tools try them out),
+// d is used for the whole game
+//
+void tri2s_init_difficulty (struct tri2s_state* s, uint32_t seed, const struct tri2s_difficulty* d) {
+	field_clear(s->field);
+	s->lines = 0;
+	s->seeda = 65537;
+	s->seedb = (seed != 0) ? seed : 12345;		// the generator gets stuck at 0
+	s->stone = get_random_stone(s);
+	s->stonex = SPAWN_X;
+	s->stoney = SPAWN_Y;
+	s->falltime = d->falltime;
+	s->falltimemax = d->falltime;
+	s->solvedlines = 0;
+	s->levelcount = 0;
+	s->totallines = 0;
+	s->over = 0;
+	s->difficulty = d;
+}
+
+//
+// removes the complete lines found by the last tri2s_step() and
+// counts them, returns EV_CLEARED and EV_LEVELUP as they happen
+//
+// the front-end calls this after it has shown the lines, otherwise
+// the next tri2s_step() does it.
+//
+uint8_t tri2s_settle (struct tri2s_state* s) {
+	const struct tri2s_difficulty* d = s->difficulty;
+	uint8_t events = 0;
+	field_t m;
+
+	if (s->lines) {
+		field_remove_lines(s->field, s->lines);
+		for (m = s->lines; m; m &= m - 1) {
+			s->solvedlines++;
+			s->totallines++;
+		}
+		s->lines = 0;
+		events |= EV_CLEARED;
+	}
+
+	// we get faster after a while
+	if (s->solvedlines >= d->levellines) {
+		s->solvedlines = 0;
+		s->falltimemax = (s->falltimemax - d->fallstep < d->fallmin) ? d->fallmin : (s->falltimemax - d->fallstep);
+		s->levelcount++;
+		events |= EV_LEVELUP;
+	}
+	return events;
+}
+
+//
+// advances the game by one frame, returns the events (EV_*) that happened
+//
+uint8_t tri2s_step (struct tri2s_state* s, uint8_t input) {
+	uint8_t events;
+
+	if (s->over)
+		return EV_GAMEOVER;
+
+	events = tri2s_settle(s);
+
+	// handle the input
+	if (input & IN_ROTATE) {
+		if (can_rotate_stone(s->field, s->stone, s->stonex, s->stoney)) {
+			s->stone = rotate_stone(s->stone);
+			events |= EV_MOVE;
+		}
+	} else if (input & IN_LEFT) {
+		if (can_move_stone(s->field, s->stone, s->stonex, s->stoney + 1)) {
+			s->stoney++;
+			events |= EV_MOVE;
+		}
+	} else if (input & IN_RIGHT) {
+		if (can_move_stone(s->field, s->stone, s->stonex, s->stoney - 1)) {
+			s->stoney--;
+			events |= EV_MOVE;
+		}
+	}
+
+	// let stone fall
+	s->falltime--;
+	if (s->falltime <= 0) {
+		s->falltime = s->falltimemax;
+		if (can_move_stone(s->field, s->stone, s->stonex + 1, s->stoney)) {
+			s->stonex++;
+			events |= EV_FALL;
+		} else {
+			field_place_stone(s->field, s->stone, s->stonex, s->stoney);
+			events |= EV_LAND;
+
+			// if fallen stone is to high and reaches out of the field ... game over
+			if (s->stonex <= 0) {
+				s->over = 1;
+				return events | EV_GAMEOVER;
+			}
+
+			// continue with next stone ...
+			s->stonex = SPAWN_X;
+			s->stoney = SPAWN_Y;
+			s->stone = get_random_stone(s);
+			s->falltime = s->falltimemax;
+
+			// check if lines are complete
+			s->lines = field_complete_lines(s->field);
+			if (s->lines)
+				events |= EV_LINES;
+		}
+	}
+	return events;
+}
@@ -0,0 +1,81 @@
+/*
+ *	tri2s-core.h - Tri2s game rules, independent of the Mignonette hardware
+ *
+ *	the whole game is kept in a struct tri2s_state and advanced one frame at a time
+ *	by tri2s_step(), which gets the player's input for that frame and returns what
+ *	happened (EV_* flags).  drawing, sound, timing and buttons are left to the caller,
+ *	so the same rules run in tri2s.c on the device and in the host tools.
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#ifndef TRI2S_CORE_H
+#define TRI2S_CORE_H
+
+#include <inttypes.h>
+#include "playfield.h"
+
+/* input for one frame (only one of them is used, in this order) */
+#define IN_ROTATE	0x01		// rotate the stone (once per button press)
+#define IN_LEFT		0x02		// move the stone left (while held)
+#define IN_RIGHT	0x04		// move the stone right (while held)
+
+/* events returned by tri2s_step() */
+#define EV_MOVE		0x01		// the stone was moved or rotated by the input
+#define EV_FALL		0x02		// the stone fell one line
+#define EV_LAND		0x04		// the stone landed and is now part of the field
+#define EV_LINES	0x08		// there are complete lines (see lines), removed by tri2s_settle()
+#define EV_CLEARED	0x10		// complete lines were removed
+#define EV_LEVELUP	0x20		// 10 more lines solved, the stones fall faster now
+#define EV_GAMEOVER	0x40		// a stone landed in the hidden line
+
+/* difficulty of the game on the device (Tri2sDifficulty) */
+#define FALLTIME_START	9		// frames per line at the start
+#define FALLTIME_STEP	1		// frames per line less with every level ...
+#define FALLTIME_MIN	0		// ... down to this
+#define LEVEL_LINES		10		// lines per level
+
+/* how fast the stones fall, and how that changes from level to level */
+struct tri2s_difficulty {
+	int8_t		falltime;				// frames per line at the start
+	int8_t		fallstep;				// frames per line less with every level ...
+	int8_t		fallmin;				// ... down to this
+	uint8_t		levellines;				// lines per level (at least 1)
+};
+
+struct tri2s_state {
+	field_t		field[FIELD_WIDTH];		// the stacked stones
+	field_t		lines;					// complete lines waiting to be removed
+	uint8_t		stone;					// the falling stone ...
+	int8_t		stonex;					// ... its line (0 is the hidden line)
+	int8_t		stoney;					// ... and its column
+	int8_t		falltime;				// frames until the stone falls
+	int8_t		falltimemax;			// frames per line
+	uint8_t		solvedlines;			// lines solved in this level
+	uint8_t		levelcount;				// levels solved
+	uint16_t	totallines;				// lines solved in the whole game
+	uint8_t		over;					// != 0 once the game is over
+	uint32_t	seeda;					// random number generator state
+	uint32_t	seedb;
+	const struct tri2s_difficulty* difficulty;
+};
+
+extern const uint8_t CornerStones[4];
+extern const uint8_t StraightStones[2];
+extern const struct tri2s_difficulty Tri2sDifficulty;
+
+void tri2s_init (struct tri2s_state* s, uint32_t seed);
+void tri2s_init_difficulty (struct tri2s_state* s, uint32_t seed, const struct tri2s_difficulty* d);
+uint8_t tri2s_step (struct tri2s_state* s, uint8_t input);
+uint8_t tri2s_settle (struct tri2s_state* s);
+
+uint32_t tri2s_random (struct tri2s_state* s, uint32_t max);
+uint8_t get_random_stone (struct tri2s_state* s);
+uint8_t rotate_stone (uint8_t stone);
+uint8_t can_move_stone (const field_t* field, uint8_t stone, int8_t x, int8_t y);
+uint8_t can_rotate_stone (const field_t* field, uint8_t stone, int8_t x, int8_t y);
+int8_t get_complete_line (const field_t* field);
+
+#endif /* TRI2S_CORE_H */
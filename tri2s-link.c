@@ -0,0 +1,386 @@
+/*
+ *	tri2s-link.c - two Tri2s games against each other, over a serial link
+ *
+ *	(see tri2s-link.h)
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#include <inttypes.h>
+#include <string.h>
+#include "tri2s-core.h"
+#include "tri2s-replay.h"
+#include "tri2s-link.h"
+
+#define HIST(t)		((t) & (LINK_HISTORY - 1))
+
+
+/* the games */
+
+//
+// starts both games with the same seed
+//
+void versus_init (struct versus_state* v, uint32_t seed) {
+	uint8_t i;
+	for (i = 0; i < 2; i++) {
+		tri2s_init(&v->game[i], seed);
+		v->cleared[i] = 0;
+		v->garbage[i] = 0;
+	}
+	v->hole = (uint8_t)seed;
+}
+
+//
+// plays a tick of both games, with the input of each.  the complete lines are removed
+// right away (cleared has them), 2 or more at once are garbage for the other game.
+// the garbage comes up when a stone lands, with the hole in a column that changes from
+// line to line (hole is a little random number generator of its own).
+//
+void versus_step (struct versus_state* v, const uint8_t* input, uint8_t* events) {
+	uint8_t i, n, ev;
+	field_t m;
+
+	for (i = 0; i < 2; i++) {
+		struct tri2s_state* g = &v->game[i];
+
+		ev = tri2s_step(g, input[i]);
+		v->cleared[i] = 0;
+		if (ev & EV_LINES) {
+			v->cleared[i] = g->lines;
+			for (n = 0, m = g->lines; m; m &= m - 1)
+				n++;
+			ev |= tri2s_settle(g);
+			if ((n > 1) && (v->garbage[!i] < FIELD_LINES))
+				v->garbage[!i] += n - 1;
+		}
+		if ((ev & EV_LAND) && !g->over && v->garbage[i]) {
+			for (; v->garbage[i]; v->garbage[i]--) {
+				v->hole = v->hole * 5 + 3;
+				if (field_raise(g->field, (v->hole >> 4) % FIELD_WIDTH)) {
+					g->over = 1;			// topped out
+					ev |= EV_GAMEOVER;
+				}
+			}
+			ev |= EV_GARBAGE;
+		}
+		events[i] = ev;
+	}
+}
+
+//
+// returns a checksum of both games
+//
+uint16_t versus_checksum (const struct versus_state* v) {
+	uint16_t a = replay_checksum(&v->game[0]);
+	uint16_t b = replay_checksum(&v->game[1]);
+	return ((a << 1) | (a >> 15)) ^ b ^ ((uint16_t)v->garbage[0] << 8) ^ v->garbage[1] ^ v->hole;
+}
+
+
+/* the messages */
+
+//
+// returns the check of n bytes, a CRC-16 (CCITT)
+//
+static uint16_t link_check (const uint8_t* p, uint8_t n) {
+	uint16_t c = 0xFFFF;
+	uint8_t i;
+
+	while (n--) {
+		c ^= (uint16_t)*p++ << 8;
+		for (i = 0; i < 8; i++)
+			c = (c & 0x8000) ? (c << 1) ^ 0x1021 : (c << 1);
+	}
+	return c;
+}
+
+//
+// returns the tick of a low byte, the one nearest to near
+//
+static uint16_t link_tick16 (uint16_t near, uint8_t low) {
+	return near + (int8_t)(low - (uint8_t)near);
+}
+
+//
+// adds a message of n bytes (the check is added) to out, if it fits
+//
+static void link_send (struct link* l, const uint8_t* msg, uint8_t n) {
+	uint16_t c = link_check(msg, n);
+
+	if (l->outlen + n + 2 > LINK_OUT)
+		return;
+	memcpy(l->out + l->outlen, msg, n);
+	l->out[l->outlen + n] = c;
+	l->out[l->outlen + n + 1] = c >> 8;
+	l->outlen += n + 2;
+	l->stats.sent += n + 2;
+}
+
+//
+// returns the length of the message in rx so far, 0 if it doesn't start like one
+//
+static uint8_t link_length (const struct link* l) {
+	switch (l->rx[0]) {
+		case 'H':
+			return 7;
+		case 'S':
+			return 6;
+		case 'I':
+			if (l->rxlen < 4)
+				return LINK_MSG;		// n is not there yet
+			return (l->rx[3] <= LINK_HISTORY) ? 6 + l->rx[3] : 0;
+	}
+	return 0;
+}
+
+//
+// starts the games, with the nonce of the other device
+//
+static void link_start (struct link* l, uint32_t other) {
+	versus_init(&l->confirmed, l->nonce ^ other);
+	l->current = l->confirmed;
+	l->me = (l->nonce < other) ? 0 : 1;
+	l->state = LINK_PLAYED;
+}
+
+//
+// the inputs of the other device, from tick t on
+//
+static void link_inputs (struct link* l, uint16_t t, const uint8_t* in, uint8_t n) {
+	uint8_t i;
+
+	for (i = 0; i < n; i++, t++) {
+		if ((t == l->received) && (t - l->done < LINK_HISTORY)) {
+			l->remote[HIST(t)] = in[i];
+			l->received++;
+			l->quiet = 0;
+		}
+	}
+}
+
+//
+// handles a complete message in rx
+//
+static void link_message (struct link* l) {
+	const uint8_t* m = l->rx;
+	uint16_t t;
+
+	switch (m[0]) {
+		case 'H':
+			if (l->state == LINK_WAIT) {
+				uint32_t other = (uint32_t)m[1] | ((uint32_t)m[2] << 8) | ((uint32_t)m[3] << 16) | ((uint32_t)m[4] << 24);
+				if (other != l->nonce)		// (a tie waits for the timeout)
+					link_start(l, other);
+			}
+			break;
+
+		case 'I':
+			if (l->state == LINK_WAIT)
+				break;
+			l->heard = 1;
+			t = link_tick16(l->tick, m[2]);
+			if ((t > l->acked) && (t <= l->tick + LINK_DELAY))
+				l->acked = t;
+			link_inputs(l, link_tick16(l->received, m[1]), m + 4, m[3]);
+			break;
+
+		case 'S':
+			t = link_tick16(l->done, m[1]);
+			if (t == l->mytick) {
+				if ((m[2] | (m[3] << 8)) != l->mysum)
+					l->state = LINK_LOST;
+			} else if ((t > l->done) && !l->sumwaiting) {
+				l->sumtick = t;
+				l->sum = m[2] | (m[3] << 8);
+				l->sumwaiting = 1;
+			}
+			break;
+	}
+}
+
+//
+// starts the link, the nonce should be different on both devices (a random number)
+//
+void link_begin (struct link* l, uint32_t nonce) {
+	memset(l, 0, sizeof(*l));
+	l->nonce = nonce;
+	l->state = LINK_WAIT;
+	// the inputs before LINK_DELAY are none, on both devices
+	l->tick = l->done = 0;
+	l->received = l->acked = LINK_DELAY;
+}
+
+//
+// takes a byte from the other device
+//
+void link_receive (struct link* l, uint8_t byte) {
+	uint8_t n;
+
+	l->stats.received++;
+	if ((l->rxlen == 0) && (byte != 'H') && (byte != 'I') && (byte != 'S')) {
+		l->stats.errors++;			// not the start of a message
+		return;
+	}
+	l->rx[l->rxlen++] = byte;
+	n = link_length(l);
+	if (n == 0) {
+		l->stats.errors++;
+		l->rxlen = 0;
+		return;
+	}
+	if (l->rxlen < n)
+		return;
+	if (link_check(l->rx, n - 2) == (l->rx[n - 2] | (l->rx[n - 1] << 8)))
+		link_message(l);
+	else
+		l->stats.errors++;
+	l->rxlen = 0;
+}
+
+
+/* the ticks */
+
+//
+// returns the guess of the other player's input for the next tick: what it did last,
+// but without rotating (that is once per button press)
+//
+static uint8_t link_guess (const struct link* l) {
+	return l->remote[HIST(l->received - 1)] & ~IN_ROTATE;
+}
+
+//
+// plays tick t of current, with a guess where the other device's input is missing
+// (guess has what was taken, known or not)
+//
+static uint8_t link_play (struct link* l, uint16_t t) {
+	uint8_t in[2], ev[2];
+
+	in[l->me] = l->local[HIST(t)];
+	in[!l->me] = l->guess[HIST(t)] = (t < l->received) ? l->remote[HIST(t)] : link_guess(l);
+	versus_step(&l->current, in, ev);
+	return ev[l->me];
+}
+
+//
+// moves confirmed on as far as the inputs are known, and if a guess for those ticks was
+// wrong, plays current again from there
+//
+static void link_confirm (struct link* l) {
+	uint8_t in[2], ev[2], wrong = 0;
+	uint16_t t;
+
+	while ((l->done < l->received) && (l->done < l->tick)) {
+		t = l->done;
+		in[l->me] = l->local[HIST(t)];
+		in[!l->me] = l->remote[HIST(t)];
+		if (in[!l->me] != l->guess[HIST(t)])
+			wrong = 1;
+		versus_step(&l->confirmed, in, ev);
+		l->done++;
+
+		if (l->sumwaiting && (l->sumtick == l->done)) {
+			if (versus_checksum(&l->confirmed) != l->sum)
+				l->state = LINK_LOST;		// the games went apart
+			l->sumwaiting = 0;
+		}
+		if ((l->done % LINK_SUM_TICKS) == 0) {
+			l->mytick = l->done;
+			l->mysum = versus_checksum(&l->confirmed);
+			l->mysumsend = 1;
+		}
+		if ((l->state == LINK_PLAYED) && (l->confirmed.game[0].over || l->confirmed.game[1].over))
+			l->state = LINK_OVER;
+	}
+	if (wrong) {
+		l->stats.rollbacks++;
+		l->current = l->confirmed;
+		for (t = l->done; t != l->tick; t++) {
+			link_play(l, t);
+			l->stats.replayed++;
+		}
+	}
+}
+
+//
+// sends hello, or the inputs the other device doesn't have yet and the checksum
+//
+static void link_output (struct link* l) {
+	uint8_t msg[LINK_MSG];
+	uint16_t t, end = l->tick + LINK_DELAY;
+	uint8_t n = 0;
+
+	if (!l->heard) {
+		msg[0] = 'H';
+		msg[1] = l->nonce;
+		msg[2] = l->nonce >> 8;
+		msg[3] = l->nonce >> 16;
+		msg[4] = l->nonce >> 24;
+		link_send(l, msg, 5);
+	}
+	if (l->state == LINK_WAIT)
+		return;
+	msg[0] = 'I';
+	msg[1] = l->acked;
+	msg[2] = l->received;
+	for (t = l->acked; t != end; t++)
+		msg[4 + n++] = l->local[HIST(t)];
+	msg[3] = n;
+	link_send(l, msg, 4 + n);
+	if (l->mysumsend) {
+		msg[0] = 'S';
+		msg[1] = l->mytick;
+		msg[2] = l->mysum;
+		msg[3] = l->mysum >> 8;
+		link_send(l, msg, 4);
+		l->mysumsend = 0;
+	}
+}
+
+//
+// the next tick, with the input of our player.  returns LINK_PLAYED if the tick was
+// played (with the events of our game in events), LINK_WAIT if the other device is
+// behind (or not there yet), LINK_OVER when the match is over or LINK_LOST.
+// the bytes to send are in out afterwards.  once over, keep calling it for a few ticks,
+// so the other device gets our last inputs.
+//
+uint8_t link_tick (struct link* l, uint8_t input) {
+	uint8_t r = LINK_WAIT;
+
+	l->outlen = 0;
+	l->events = 0;
+	if (l->state == LINK_LOST)
+		return LINK_LOST;
+	if (++l->quiet > LINK_TIMEOUT) {
+		l->state = LINK_LOST;
+		return LINK_LOST;
+	}
+
+	if (l->state == LINK_PLAYED)
+		link_confirm(l);
+	if ((l->state == LINK_PLAYED) && (l->tick - l->done < LINK_ROLLBACK) &&
+			(l->tick + LINK_DELAY - l->acked < LINK_HISTORY)) {
+		l->local[HIST(l->tick + LINK_DELAY)] = input;
+		l->events = link_play(l, l->tick);
+		l->tick++;
+		l->stats.ticks++;
+		r = LINK_PLAYED;
+	} else if (l->state != LINK_OVER) {
+		l->stats.stalls++;
+	}
+	link_output(l);
+	return (l->state == LINK_OVER) ? LINK_OVER : r;
+}
+
+//
+// returns LINK_WIN, LINK_LOSE or LINK_DRAW, once the match is over
+//
+uint8_t link_result (const struct link* l) {
+	uint8_t mine = l->confirmed.game[l->me].over;
+	uint8_t other = l->confirmed.game[!l->me].over;
+
+	if (mine && other)
+		return LINK_DRAW;
+	return mine ? LINK_LOSE : LINK_WIN;
+}
@@ -0,0 +1,133 @@
+/*
+ *	tri2s-link.h - two Tri2s games against each other, over a serial link
+ *
+ *	both devices play both games (struct versus_state), each with the inputs of its own
+ *	player and of the other one, which they send each other every tick (a frame of the
+ *	game).  the games start with the same seed and the same rules run on both, so both
+ *	devices get the same games, in lockstep.  when a player clears 2 or more lines at
+ *	once, the other game gets all but one of them as garbage lines, pushed up from below
+ *	when its next stone lands.  whoever tops out first loses.
+ *
+ *	the input of a tick is taken LINK_DELAY ticks before the tick is played and sent
+ *	right away, which is usually enough for it to get to the other device in time.  if
+ *	it isn't, the tick is played with a guess of the other player's input (the last one,
+ *	but no rotation), for at most LINK_ROLLBACK ticks.  when the real input comes in and
+ *	the guess was wrong, the game goes back to the last tick all inputs were known for
+ *	(confirmed) and plays the ticks since then again.  a device that gets more than
+ *	LINK_ROLLBACK ticks ahead waits for the other one.
+ *
+ *	the messages, each with a CRC-16 at the end (see link_check()):
+ *
+ *		'H' nonce[4]					hello, until the other device has answered.  the
+ *										lower nonce plays game 0, both games get the
+ *										seed nonce ^ other nonce.
+ *		'I' tick ack n input[n]			the inputs of ticks tick to tick + n - 1 (the low
+ *										byte of the tick), all that were not acked yet.
+ *										ack is the next tick of the other device's inputs
+ *										that is needed.
+ *		'S' tick sum[2]					the checksum of the confirmed games at that tick,
+ *										every LINK_SUM_TICKS ticks, to notice if they differ.
+ *
+ *	a message with a wrong CRC is dropped, its inputs are sent again with the next
+ *	one as they are not acked.  this file is independent of the hardware, the caller
+ *	gives it the received bytes (link_receive()) and sends what link_tick() put into out.
+ *	see tri2s.c for the device (make LINK=1) and host/linksim.c for the host.
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#ifndef TRI2S_LINK_H
+#define TRI2S_LINK_H
+
+#include <inttypes.h>
+#include "tri2s-core.h"
+
+#ifndef LINK_DELAY
+#define LINK_DELAY		1		// ticks from taking an input to playing it
+#endif
+#ifndef LINK_ROLLBACK
+#define LINK_ROLLBACK	3		// ticks that may be played with a guessed input
+#endif
+#define LINK_HISTORY	16		// inputs kept (a power of 2, more than the ticks in flight)
+#define LINK_TIMEOUT	50		// ticks without news from the other device, then it's lost
+#define LINK_SUM_TICKS	16		// ticks between checksums
+#define LINK_OUT		40		// bytes link_tick() sends at most
+#define LINK_MSG		(6 + LINK_HISTORY)	// longest message
+
+#if (LINK_DELAY + 2 * LINK_ROLLBACK) >= LINK_HISTORY
+#error "LINK_HISTORY is too small for LINK_DELAY and LINK_ROLLBACK"
+#endif
+
+/* events of versus_step(), besides the EV_* of tri2s_step() */
+#define EV_GARBAGE		0x80	// garbage lines came up under the field
+
+/* link_tick() returns */
+#define LINK_WAIT		0		// no tick played (waiting for the other device)
+#define LINK_PLAYED		1		// a tick was played, see events
+#define LINK_OVER		2		// the match is over (see link_result())
+#define LINK_LOST		3		// the other device went quiet, or the games differ
+
+/* link_result() returns */
+#define LINK_LOSE		0
+#define LINK_WIN		1
+#define LINK_DRAW		2
+
+/* the two games */
+struct versus_state {
+	struct tri2s_state game[2];
+	field_t cleared[2];			// the lines game i removed in the last tick
+	uint8_t garbage[2];			// lines waiting to come up under game i
+	uint8_t hole;				// where the hole of the next garbage line is (see versus_step())
+};
+
+struct link_stats {
+	uint16_t ticks;				// ticks played
+	uint16_t stalls;			// calls of link_tick() that waited
+	uint16_t rollbacks;			// wrong guesses, the ticks since confirmed were played again
+	uint16_t replayed;			// ticks played again for them
+	uint16_t errors;			// messages dropped
+	uint16_t sent;				// bytes put into out
+	uint16_t received;			// bytes received
+};
+
+struct link {
+	struct versus_state confirmed;	// at tick done, all inputs before it are known
+	struct versus_state current;	// at tick tick, the ticks from done on played with guesses
+	uint8_t local[LINK_HISTORY];	// our inputs, by tick
+	uint8_t remote[LINK_HISTORY];	// the other device's, before received
+	uint8_t guess[LINK_HISTORY];	// what current took for them (guessed from received on)
+	uint16_t tick;
+	uint16_t done;
+	uint16_t received;
+	uint16_t acked;				// the other device has our inputs before this tick
+	uint8_t me;					// the game of this device (0 or 1)
+	uint8_t state;				// LINK_WAIT (hello), LINK_PLAYED, LINK_OVER or LINK_LOST
+	uint8_t heard;				// != 0 once the other device sent inputs
+	uint8_t quiet;				// ticks without news from the other device
+	uint8_t events;				// what happened to our game in the tick played last
+	uint32_t nonce;
+	uint16_t sumtick;			// a checksum of the other device for this tick ...
+	uint16_t sum;
+	uint8_t sumwaiting;			// ... waits for confirmed to get there
+	uint16_t mytick;			// our last checksum ...
+	uint16_t mysum;
+	uint8_t mysumsend;			// ... is sent with the next link_tick()
+	uint8_t rx[LINK_MSG];		// the message being received
+	uint8_t rxlen;
+	uint8_t out[LINK_OUT];		// the bytes to send after link_tick()
+	uint8_t outlen;
+	struct link_stats stats;
+};
+
+void versus_init (struct versus_state* v, uint32_t seed);
+void versus_step (struct versus_state* v, const uint8_t* input, uint8_t* events);
+uint16_t versus_checksum (const struct versus_state* v);
+
+void link_begin (struct link* l, uint32_t nonce);
+void link_receive (struct link* l, uint8_t byte);
+uint8_t link_tick (struct link* l, uint8_t input);
+uint8_t link_result (const struct link* l);
+
+#endif /* TRI2S_LINK_H */
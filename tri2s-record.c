@@ -0,0 +1,184 @@
+/*
+ *	tri2s-record.c - records games into the EEPROM and plays them back
+ *
+ *	(see tri2s-record.h and tri2s-replay.h)
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#include <inttypes.h>
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include "tri2s-record.h"
+#include "tri2s-replay.h"
+
+// the EEPROM address a (through uintptr_t, so the host's wider pointers take it too)
+#define EEPROM_ADDR(a)	((uint8_t*)(uintptr_t)(a))
+
+// bytes waiting for the EEPROM (a power of 2).  a game makes less than a byte per
+// frame on average (at most REPLAY_MAXOUT) and the EEPROM takes one in 3.4ms, so this
+// only fills up at the start.
+#define RECORD_RING		16
+
+static uint8_t Ring[RECORD_RING];
+static uint8_t RingHead;		// the next byte goes here ...
+static uint8_t RingTail;		// ... and the EEPROM gets this one next
+
+static uint16_t EepromPos;		// EEPROM address of the next byte
+static uint16_t RecordLen;		// bytes of the recording so far
+static uint8_t Recording;		// 1 while a game is recorded, 2 once the EEPROM is full
+
+static struct replay_coder Coder;
+
+
+//
+// adds a byte to the ring, waits for the EEPROM if the ring is full
+//
+static void put_byte (uint8_t b) {
+	uint8_t next = (RingHead + 1) & (RECORD_RING - 1);
+	while (next == RingTail)
+		record_poll();
+	Ring[RingHead] = b;
+	RingHead = next;
+	RecordLen++;
+}
+
+//
+// writes the next byte of the ring to the EEPROM, if the EEPROM is ready.
+// call this once per frame.
+//
+void record_poll (void) {
+	if (!eeprom_is_ready() || (RingTail == RingHead))
+		return;
+	eeprom_update_byte(EEPROM_ADDR(EepromPos), Ring[RingTail]);
+	RingTail = (RingTail + 1) & (RECORD_RING - 1);
+	EepromPos++;
+}
+
+//
+// starts recording a game with the given seed.  the 'T' of the header is written by
+// record_end(), so a game cut short by switching off leaves no recording behind
+// (the events of the last recording would follow it).
+//
+void record_begin (uint32_t seed) {
+	uint8_t i;
+
+	RingHead = RingTail = 0;
+	EepromPos = 0;
+	RecordLen = 0;
+	replay_encode_begin(&Coder);
+	Recording = 1;
+
+	put_byte(0xFF);					// erased, 'T' at the end
+	put_byte(REPLAY_FORMAT);
+	for (i = 0; i < 4; i++)
+		put_byte((uint8_t)(seed >> (8 * i)));
+	put_byte(FIELD_LINES);
+	put_byte(FIELD_WIDTH);
+}
+
+//
+// records the input of a step, events are those of the step before.  when the EEPROM
+// could be full after it the recording just ends (4 bytes stay free for record_end()).
+//
+void record_input (uint8_t input, uint8_t events) {
+	uint8_t b[REPLAY_MAXOUT];
+	uint8_t i, n;
+
+	if (Recording != 1)
+		return;
+	if (RecordLen + REPLAY_MAXOUT > REPLAY_SIZE - 4) {
+		Recording = 2;
+		return;
+	}
+	n = replay_encode(&Coder, input, events, b);
+	for (i = 0; i < n; i++)
+		put_byte(b[i]);
+}
+
+//
+// ends the recording when the game s is over and waits until it is all in the EEPROM.
+// the end of the recording is only written here, so the EEPROM gets each byte once.
+//
+void record_end (const struct tri2s_state* s) {
+	uint16_t sum;
+	uint8_t b[2];
+	uint8_t i, n;
+
+	if (!Recording)
+		return;
+	n = replay_encode_end(&Coder, Recording == 1, b);
+	for (i = 0; i < n; i++)
+		put_byte(b[i]);
+	if (Recording == 1) {
+		sum = replay_checksum(s);
+		put_byte(sum & 0xFF);
+		put_byte(sum >> 8);
+	}
+	Recording = 0;
+	while (RingTail != RingHead)
+		record_poll();
+	eeprom_update_byte(EEPROM_ADDR(0), 'T');
+}
+
+//
+// starts playing back the recording in the EEPROM, gets its seed.
+// returns 0 if there is no recording for this playfield size.
+//
+uint8_t playback_begin (uint32_t* seed) {
+	uint8_t i;
+
+	if ((eeprom_read_byte(EEPROM_ADDR(0)) != 'T') || (eeprom_read_byte(EEPROM_ADDR(1)) != REPLAY_FORMAT) ||
+		(eeprom_read_byte(EEPROM_ADDR(6)) != FIELD_LINES) || (eeprom_read_byte(EEPROM_ADDR(7)) != FIELD_WIDTH))
+		return 0;
+
+	*seed = 0;
+	for (i = 0; i < 4; i++)
+		*seed |= (uint32_t)eeprom_read_byte(EEPROM_ADDR(2 + i)) << (8 * i);
+	EepromPos = REPLAY_HEADER;
+	replay_decode_begin(&Coder);
+	return 1;
+}
+
+//
+// returns what the decoder says about the next step (see replay_decode()), feeding
+// it the bytes it needs.  past the EEPROM the recording is cut off.
+//
+static uint8_t playback_next (uint8_t* input) {
+	uint8_t r;
+
+	while ((r = replay_decode(&Coder, input)) == REPLAY_MORE) {
+		if (EepromPos >= REPLAY_SIZE)
+			return REPLAY_CUT;
+		replay_feed(&Coder, eeprom_read_byte(EEPROM_ADDR(EepromPos)));
+		EepromPos++;
+	}
+	return r;
+}
+
+//
+// gets the recorded input of the next step, events are those of the step before.
+// returns 0 at the end of the recording
+//
+uint8_t playback_input (uint8_t* input, uint8_t events) {
+	if (events & EV_LAND)
+		replay_land(&Coder);
+	return (playback_next(input) == REPLAY_STEP) ? 1 : 0;
+}
+
+//
+// returns 1 if the recorded game ended just like the game s
+//
+uint8_t playback_check (const struct tri2s_state* s) {
+	uint16_t sum;
+	uint8_t input;
+
+	replay_land(&Coder);				// the game ended with a stone landing
+	if ((playback_next(&input) != REPLAY_GAMEOVER) || (EepromPos > REPLAY_SIZE - 2))
+		return 0;
+	sum = eeprom_read_byte(EEPROM_ADDR(EepromPos));
+	sum |= (uint16_t)eeprom_read_byte(EEPROM_ADDR(EepromPos + 1)) << 8;
+	return (sum == replay_checksum(s)) ? 1 : 0;
+}
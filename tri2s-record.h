@@ -0,0 +1,29 @@
+/*
+ *	tri2s-record.h - records games into the EEPROM and plays them back
+ *
+ *	the recording (see tri2s-replay.h) is collected in a small ring buffer in RAM and
+ *	written to the EEPROM one byte per frame, so a game never waits for the EEPROM.
+ *	the end of the recording is written when the game is over (record_end()).
+ *	get it with "make read-replay" and look at it with host/replay.
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#ifndef TRI2S_RECORD_H
+#define TRI2S_RECORD_H
+
+#include <inttypes.h>
+#include "tri2s-core.h"
+
+void record_begin (uint32_t seed);
+void record_input (uint8_t input, uint8_t events);
+void record_end (const struct tri2s_state* s);
+void record_poll (void);
+
+uint8_t playback_begin (uint32_t* seed);
+uint8_t playback_input (uint8_t* input, uint8_t events);
+uint8_t playback_check (const struct tri2s_state* s);
+
+#endif /* TRI2S_RECORD_H */
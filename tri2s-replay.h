@@ -0,0 +1,305 @@
+/*
+ *	tri2s-replay.h - recording format for Tri2s games
+ *
+ *	a game is fully determined by the seed passed to tri2s_init() and the input of
+ *	every step, so that is all a recording holds.  the inputs are events: a button,
+ *	the step it is pressed in and how long it is held, each stone on its own.  the
+ *	steps are counted from the start of the stone or the last event, and when a stone
+ *	lands is known to the replay (EV_LAND), so the idle steps until then are not in
+ *	the recording.  an event is a nibble (the high one of a byte first):
+ *
+ *		bits 3..2	the button (1 rotate, 2 left, 3 right)
+ *		bit 1		held for 1 or 2 steps (a longer press takes several events)
+ *		bit 0		1 if the stone gets no more input until it lands
+ *
+ *	with no button the nibble is one of:
+ *
+ *		REPLAY_REST			the stone gets no (more) input until it lands
+ *		REPLAY_GAP n		n + 1 steps without input (1 to 16), n is the next nibble
+ *		REPLAY_LONG_GAP n m	(n << 4) + m + 17 steps without input (17 to 272)
+ *		REPLAY_STOP e		the end of the recording: e is REPLAY_OVER when the game ended
+ *							(the checksum of the final game state follows in the next two
+ *							bytes, low byte first), REPLAY_END when the recording just stops
+ *
+ *	the recording is laid out to fill the 512 bytes of EEPROM of the atmega168:
+ *
+ *		0 - 1	"T3" (the device writes the 'T' last, when the recording is complete)
+ *		2 - 5	seed, low byte first
+ *		6		FIELD_LINES
+ *		7		FIELD_WIDTH
+ *		8 -		events, up to REPLAY_SIZE
+ *
+ *	a stone of the computer player takes 0.85 bytes (most of them are turned and moved
+ *	right away), so about 590 stones fit, and 590 of its 1000 games of "autoplay -n 1000".
+ *	("T2" was the format before, a byte per run of steps, where 135 of them fit.)  a game
+ *	that does not fit is recorded up to there and ends with REPLAY_END.
+ *	see tri2s-record.c for the device, host/replay.c for the host.
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#ifndef TRI2S_REPLAY_H
+#define TRI2S_REPLAY_H
+
+#include <inttypes.h>
+#include "tri2s-core.h"
+
+#define REPLAY_SIZE		512		// size of a recording (the EEPROM)
+#define REPLAY_HEADER	8		// bytes before the first event
+#define REPLAY_FORMAT	'3'		// the second byte of the header
+
+/* nibbles without a button */
+#define REPLAY_REST		0x0		// no more input until the stone lands
+#define REPLAY_GAP		0x1		// steps without input, one more nibble
+#define REPLAY_LONG_GAP	0x2		// steps without input, two more nibbles
+#define REPLAY_STOP		0x3		// end of recording, one more nibble:
+#define REPLAY_END		0x0		// ... the recording stops here
+#define REPLAY_OVER		0x1		// ... game over, two bytes of checksum follow
+
+#define REPLAY_GAP_MAX	272		// the longest gap of one event
+#define REPLAY_MAXOUT	3		// bytes replay_encode() makes at most in a step
+
+/* what replay_decode() returns */
+#define REPLAY_MORE		0		// it needs the next byte (replay_feed())
+#define REPLAY_STEP		1		// the input of the next step is there
+#define REPLAY_CUT		2		// the recording stops before the game does
+#define REPLAY_GAMEOVER	3		// the game ended here, the checksum follows
+
+/* decoder states, what the next nibble is */
+#define REPLAY_S_EVENT	0		// the next event
+#define REPLAY_S_RUN	1		// none, a button is held (count steps)
+#define REPLAY_S_IDLE	2		// none, no input (gap steps)
+#define REPLAY_S_REST	3		// none, no input until the stone lands
+#define REPLAY_S_GAP	4		// the steps of a REPLAY_GAP ...
+#define REPLAY_S_GAP_HI	5		// ... or a REPLAY_LONG_GAP
+#define REPLAY_S_GAP_LO	6
+#define REPLAY_S_STOP	7		// the end of the recording
+
+struct replay_coder {
+	uint8_t code;				// button of the current event (1 - 3)
+	uint8_t count;				// steps it is held so far (encoder) or left (decoder)
+	uint16_t gap;				// steps without input so far (encoder) or left (decoder)
+	uint8_t last;				// decoder: no more input for the stone after the event
+	uint8_t state;				// decoder: REPLAY_S_*
+	uint8_t bits;				// a nibble not written (encoder) or read (decoder) yet ...
+	uint8_t nibbles;			// ... if there is one (decoder: two after replay_feed())
+};
+
+//
+// returns the code of an input (only one input counts per step, see tri2s_step())
+//
+static inline uint8_t replay_code (uint8_t input) {
+	if (input & IN_ROTATE)
+		return 1;
+	if (input & IN_LEFT)
+		return 2;
+	if (input & IN_RIGHT)
+		return 3;
+	return 0;
+}
+
+//
+// adds nibble n to the recording, a complete byte goes to out[(*len)++]
+//
+static inline void replay_put (struct replay_coder* c, uint8_t n, uint8_t* out, uint8_t* len) {
+	if (c->nibbles) {
+		out[(*len)++] = c->bits | n;
+		c->nibbles = 0;
+	} else {
+		c->bits = n << 4;
+		c->nibbles = 1;
+	}
+}
+
+//
+// writes the event of the button held so far, if there is one.  last says that the
+// stone gets no more input: without an event that is a REPLAY_REST.
+//
+static inline void replay_put_event (struct replay_coder* c, uint8_t last, uint8_t* out, uint8_t* len) {
+	if (c->count)
+		replay_put(c, (c->code << 2) | ((c->count - 1) << 1) | last, out, len);
+	else if (last)
+		replay_put(c, REPLAY_REST, out, len);
+	c->count = 0;
+}
+
+//
+// writes the steps without input so far
+//
+static inline void replay_put_gap (struct replay_coder* c, uint8_t* out, uint8_t* len) {
+	uint16_t g = c->gap;
+
+	if (g <= 16) {
+		replay_put(c, REPLAY_GAP, out, len);
+		replay_put(c, g - 1, out, len);
+	} else {
+		g -= 17;
+		replay_put(c, REPLAY_LONG_GAP, out, len);
+		replay_put(c, g >> 4, out, len);
+		replay_put(c, g & 0x0F, out, len);
+	}
+	c->gap = 0;
+}
+
+//
+// starts encoding a recording
+//
+static inline void replay_encode_begin (struct replay_coder* c) {
+	c->code = c->count = c->bits = c->nibbles = 0;
+	c->gap = 0;
+}
+
+//
+// adds the input of a step to the recording, events are those of the step before
+// (EV_LAND: this is the first step of a new stone).  the complete bytes go to out,
+// at most REPLAY_MAXOUT; returns how many there are.
+//
+static inline uint8_t replay_encode (struct replay_coder* c, uint8_t input, uint8_t events, uint8_t* out) {
+	uint8_t code = replay_code(input);
+	uint8_t len = 0;
+
+	if (events & EV_LAND) {					// the stone before has all its input
+		replay_put_event(c, 1, out, &len);
+		c->gap = 0;
+	}
+	if (code == 0) {
+		if (++c->gap == REPLAY_GAP_MAX) {
+			replay_put_event(c, 0, out, &len);
+			replay_put_gap(c, out, &len);
+		}
+	} else if (c->count && (c->code == code) && !c->gap && (c->count < 2)) {
+		c->count++;
+	} else {
+		replay_put_event(c, 0, out, &len);
+		if (c->gap)
+			replay_put_gap(c, out, &len);
+		c->code = code;
+		c->count = 1;
+	}
+	return len;
+}
+
+//
+// ends the recording with REPLAY_OVER if the game is over, else with REPLAY_END.
+// the bytes go to out (at most 2), returns how many there are.
+//
+static inline uint8_t replay_encode_end (struct replay_coder* c, uint8_t over, uint8_t* out) {
+	uint8_t len = 0;
+
+	if (over)
+		replay_put_event(c, 1, out, &len);	// the last stone's input
+	replay_put(c, REPLAY_STOP, out, &len);
+	replay_put(c, over ? REPLAY_OVER : REPLAY_END, out, &len);
+	if (c->nibbles)
+		replay_put(c, 0, out, &len);
+	return len;
+}
+
+//
+// starts decoding a recording
+//
+static inline void replay_decode_begin (struct replay_coder* c) {
+	c->code = c->count = c->last = c->bits = c->nibbles = 0;
+	c->gap = 0;
+	c->state = REPLAY_S_EVENT;
+}
+
+//
+// gives the next byte of the recording to the decoder
+//
+static inline void replay_feed (struct replay_coder* c, uint8_t b) {
+	c->bits = b;
+	c->nibbles = 2;
+}
+
+//
+// tells the decoder that the stone landed (EV_LAND), the next step has the next one
+//
+static inline void replay_land (struct replay_coder* c) {
+	if (c->state != REPLAY_S_STOP)
+		c->state = REPLAY_S_EVENT;
+}
+
+//
+// gets the input of the next step into *input.  returns REPLAY_STEP then, REPLAY_MORE
+// if it needs the next byte first (call it again after replay_feed()), or REPLAY_CUT
+// or REPLAY_GAMEOVER at the end of the recording.
+//
+static inline uint8_t replay_decode (struct replay_coder* c, uint8_t* input) {
+	static const uint8_t inputs[4] = { 0, IN_ROTATE, IN_LEFT, IN_RIGHT };
+	uint8_t n;
+
+	while (1) {
+		switch (c->state) {
+			case REPLAY_S_RUN:
+				*input = inputs[c->code];
+				if (--c->count == 0)
+					c->state = c->last ? REPLAY_S_REST : REPLAY_S_EVENT;
+				return REPLAY_STEP;
+			case REPLAY_S_IDLE:
+				*input = 0;
+				if (--c->gap == 0)
+					c->state = REPLAY_S_EVENT;
+				return REPLAY_STEP;
+			case REPLAY_S_REST:
+				*input = 0;
+				return REPLAY_STEP;
+		}
+		if (c->nibbles == 0)
+			return REPLAY_MORE;
+		n = (c->nibbles-- == 2) ? (c->bits >> 4) : (c->bits & 0x0F);
+		switch (c->state) {
+			case REPLAY_S_EVENT:
+				if (n >> 2) {
+					c->code = n >> 2;
+					c->count = ((n >> 1) & 1) + 1;
+					c->last = n & 1;
+					c->state = REPLAY_S_RUN;
+				} else if (n == REPLAY_REST)
+					c->state = REPLAY_S_REST;
+				else if (n == REPLAY_GAP)
+					c->state = REPLAY_S_GAP;
+				else if (n == REPLAY_LONG_GAP)
+					c->state = REPLAY_S_GAP_HI;
+				else
+					c->state = REPLAY_S_STOP;
+				break;
+			case REPLAY_S_GAP:
+				c->gap = n + 1;
+				c->state = REPLAY_S_IDLE;
+				break;
+			case REPLAY_S_GAP_HI:
+				c->gap = (n << 4) + 17;
+				c->state = REPLAY_S_GAP_LO;
+				break;
+			case REPLAY_S_GAP_LO:
+				c->gap += n;
+				c->state = REPLAY_S_IDLE;
+				break;
+			default:							// REPLAY_S_STOP
+				c->nibbles = 0;					// the checksum starts with the next byte
+				return (n == REPLAY_OVER) ? REPLAY_GAMEOVER : REPLAY_CUT;
+		}
+	}
+}
+
+//
+// returns a checksum of the game state, to compare the end of a game and of its replay
+//
+static inline uint16_t replay_checksum (const struct tri2s_state* s) {
+	const uint8_t* p = (const uint8_t*)s->field;
+	uint8_t a = s->levelcount, b = s->solvedlines;
+	uint16_t i;
+
+	for (i = 0; i < sizeof(s->field); i++) {
+		a += p[i];
+		b += a;
+	}
+	a += s->stone + (uint8_t)s->seeda + (uint8_t)s->seedb;
+	b += a;
+	return ((uint16_t)b << 8) | a;
+}
+
+#endif /* TRI2S_REPLAY_H */
@@ -0,0 +1,247 @@
+/*
+ *	tri2s-text.c - scrolling text and numbers, over the screen or over the game
+ *
+ *	(see tri2s-text.h)
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#include <inttypes.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "mydefs.h"
+#include "miggl.h"
+#include "tri2s-text.h"
+
+#define GLYPH_WIDTH		3
+#define SPACE_WIDTH		2		// columns of a space, every character has a gap of 1 after it
+
+//
+// the font, 3 columns per character in the layout of a Disp row: the top pixel of the
+// character is bit 0x20 (x 1 of the screen) and the bottom one 0x02 (x 5).  columns at
+// the right that are empty are left out, so "!", ":" and "." are narrower.
+//
+static const uint8_t Font[][GLYPH_WIDTH] PROGMEM = {
+	{ 0x3E, 0x22, 0x3E },	// 0
+	{ 0x12, 0x3E, 0x02 },	// 1
+	{ 0x2E, 0x2A, 0x3A },	// 2
+	{ 0x22, 0x2A, 0x3E },	// 3
+	{ 0x38, 0x08, 0x3E },	// 4
+	{ 0x3A, 0x2A, 0x2E },	// 5
+	{ 0x3E, 0x2A, 0x2E },	// 6
+	{ 0x20, 0x26, 0x38 },	// 7
+	{ 0x3E, 0x2A, 0x3E },	// 8
+	{ 0x3A, 0x2A, 0x3E },	// 9
+	{ 0x1E, 0x28, 0x1E },	// A
+	{ 0x3E, 0x2A, 0x14 },	// B
+	{ 0x1C, 0x22, 0x22 },	// C
+	{ 0x3E, 0x22, 0x1C },	// D
+	{ 0x3E, 0x2A, 0x22 },	// E
+	{ 0x3E, 0x28, 0x20 },	// F
+	{ 0x1C, 0x22, 0x2E },	// G
+	{ 0x3E, 0x08, 0x3E },	// H
+	{ 0x22, 0x3E, 0x22 },	// I
+	{ 0x04, 0x02, 0x3C },	// J
+	{ 0x3E, 0x08, 0x36 },	// K
+	{ 0x3E, 0x02, 0x02 },	// L
+	{ 0x3E, 0x18, 0x3E },	// M
+	{ 0x3E, 0x20, 0x1E },	// N
+	{ 0x1C, 0x22, 0x1C },	// O
+	{ 0x3E, 0x28, 0x10 },	// P
+	{ 0x1C, 0x26, 0x1A },	// Q
+	{ 0x3E, 0x28, 0x16 },	// R
+	{ 0x12, 0x2A, 0x24 },	// S
+	{ 0x20, 0x3E, 0x20 },	// T
+	{ 0x3E, 0x02, 0x3E },	// U
+	{ 0x3C, 0x02, 0x3C },	// V
+	{ 0x3E, 0x0C, 0x3E },	// W
+	{ 0x36, 0x08, 0x36 },	// X
+	{ 0x30, 0x0E, 0x30 },	// Y
+	{ 0x26, 0x2A, 0x32 },	// Z
+	{ 0x08, 0x08, 0x08 },	// -
+	{ 0x3A, 0x00, 0x00 },	// !
+	{ 0x14, 0x00, 0x00 },	// :
+	{ 0x02, 0x00, 0x00 },	// .
+};
+
+/* the message and where the scrolling is */
+static struct {
+	char msg[TEXT_LEN];
+	uint8_t len;
+	uint8_t pos;					// the character fed in next ...
+	uint8_t col;					// ... and its column
+	uint8_t tail;					// empty columns fed after the end, until it is out
+	uint8_t color;
+	uint8_t mode;					// TEXT_SCREEN or TEXT_OVERLAY
+	uint8_t frames;					// frames per step ...
+	uint8_t left;					// ... and until the next one
+	uint8_t repeat;					// times it scrolls by again, 0 for ever
+	uint8_t on;
+	uint8_t planes[2 * YSCREEN];	// green rows, then red rows, as in Disp
+} Text;
+
+
+//
+// returns the font index of a character, 0xFF for a space
+//
+static uint8_t glyph (char c) {
+	if ((c >= 'a') && (c <= 'z'))
+		c -= 'a' - 'A';
+	if ((c >= '0') && (c <= '9'))
+		return c - '0';
+	if ((c >= 'A') && (c <= 'Z'))
+		return c - 'A' + 10;
+	switch (c) {
+		case '-': return 36;
+		case '!': return 37;
+		case ':': return 38;
+		case '.': return 39;
+	}
+	return 0xFF;
+}
+
+//
+// returns the columns of a character, without the empty ones at its right
+//
+static uint8_t glyph_width (uint8_t g) {
+	uint8_t w = GLYPH_WIDTH;
+
+	if (g == 0xFF)
+		return SPACE_WIDTH;
+	while ((w > 1) && !pgm_read_byte(&Font[g][w - 1]))
+		w--;
+	return w;
+}
+
+//
+// returns the next column of the message and moves on, 0 for the gaps and after the end
+//
+static uint8_t next_column (void) {
+	uint8_t g, bits = 0;
+
+	if (Text.pos >= Text.len) {
+		Text.tail++;
+		return 0;
+	}
+	g = glyph(Text.msg[Text.pos]);
+	if ((g != 0xFF) && (Text.col < GLYPH_WIDTH))
+		bits = pgm_read_byte(&Font[g][Text.col]);
+	if (++Text.col > glyph_width(g)) {		// that was the gap after it
+		Text.col = 0;
+		Text.pos++;
+	}
+	return bits;
+}
+
+//
+// empties the message
+//
+void text_clear (void) {
+	Text.len = 0;
+}
+
+//
+// adds a string from flash to the message, as much as fits
+//
+void text_add_P (const char* s) {
+	char c;
+
+	while ((Text.len < TEXT_LEN) && (c = pgm_read_byte(s++)))
+		Text.msg[Text.len++] = c;
+}
+
+//
+// adds a number to the message
+//
+void text_add_number (uint16_t n) {
+	char digits[5];
+	uint8_t i = 0;
+
+	do {
+		digits[i++] = '0' + n % 10;
+		n /= 10;
+	} while (n);
+	while (i && (Text.len < TEXT_LEN))
+		Text.msg[Text.len++] = digits[--i];
+}
+
+//
+// starts scrolling the message in color, a step every frames frames.  it scrolls by
+// repeat times, 0 for ever (until text_stop()).
+//
+void text_scroll (uint8_t color, uint8_t mode, uint8_t frames, uint8_t repeat) {
+	uint8_t i;
+
+	for (i = 0; i < 2 * YSCREEN; i++)
+		Text.planes[i] = 0;
+	Text.pos = Text.col = Text.tail = 0;
+	Text.color = color;
+	Text.mode = mode;
+	Text.frames = Text.left = frames ? frames : 1;
+	Text.repeat = repeat;
+	Text.on = 1;
+}
+
+void text_stop (void) {
+	Text.on = 0;
+}
+
+//
+// returns 1 while the message scrolls
+//
+uint8_t text_playing (void) {
+	return Text.on;
+}
+
+//
+// scrolls the text by a column: the 5 rows of each plane move along by one (the left
+// column of the message is row 4, the right one row 0) and the next column of the font
+// goes into row 0.  returns 0 once the message has scrolled out completely.
+//
+uint8_t text_step (void) {
+	uint8_t bits = next_column();
+
+	Text.planes[4] = Text.planes[3];
+	Text.planes[3] = Text.planes[2];
+	Text.planes[2] = Text.planes[1];
+	Text.planes[1] = Text.planes[0];
+	Text.planes[0] = (Text.color & GREEN) ? bits : 0;
+	Text.planes[YSCREEN + 4] = Text.planes[YSCREEN + 3];
+	Text.planes[YSCREEN + 3] = Text.planes[YSCREEN + 2];
+	Text.planes[YSCREEN + 2] = Text.planes[YSCREEN + 1];
+	Text.planes[YSCREEN + 1] = Text.planes[YSCREEN];
+	Text.planes[YSCREEN] = (Text.color & RED) ? bits : 0;
+	return Text.tail < YSCREEN;
+}
+
+//
+// puts the text onto the screen and scrolls it on when it is time, once per frame
+// before swapbuffers() (after anim_frame())
+//
+void text_frame (void) {
+	uint8_t y, lit;
+
+	if (!Text.on)
+		return;
+	for (y = 0; y < YSCREEN; y++) {
+		if (Text.mode == TEXT_SCREEN) {
+			Disp[y] = Text.planes[y];
+			Disp[y + YSCREEN] = Text.planes[y + YSCREEN];
+		} else {
+			lit = Text.planes[y] | Text.planes[y + YSCREEN];
+			Disp[y] = (Disp[y] & ~lit) | Text.planes[y];
+			Disp[y + YSCREEN] = (Disp[y + YSCREEN] & ~lit) | Text.planes[y + YSCREEN];
+		}
+	}
+	if (--Text.left)
+		return;
+	Text.left = Text.frames;
+	if (!text_step()) {
+		if (Text.repeat && !--Text.repeat)
+			Text.on = 0;
+		else
+			Text.pos = Text.col = Text.tail = 0;
+	}
+}
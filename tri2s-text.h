@@ -0,0 +1,42 @@
+/*
+ *	tri2s-text.h - scrolling text and numbers, over the screen or over the game
+ *
+ *	the message (text_clear(), text_add_P(), text_add_number()) scrolls in from the right
+ *	and out to the left in a 3x5 font from flash, the Mignonette held the way the game
+ *	is played: 5 pixels wide and 7 high.  a column of the text is a row of the Disp
+ *	planes then, so a step of the scrolling moves the 5 rows of the text's own pair of
+ *	planes along by one and puts the next column of the font into the first, it never
+ *	draws the whole message.  text_frame() puts the planes onto the screen before every
+ *	swapbuffers(), over the animations: all of it (TEXT_SCREEN) or the lit pixels only
+ *	(TEXT_OVERLAY, the game goes on under it).
+ *
+ *	letters are upper case (lower case is shown as upper case), besides them there are
+ *	digits, '-', '!', ':' and '.'; anything else is a space.
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#ifndef TRI2S_TEXT_H
+#define TRI2S_TEXT_H
+
+#include <inttypes.h>
+#include "miggl.h"
+
+#define TEXT_LEN		12		// characters of a message
+
+/* how text_frame() draws the text */
+#define TEXT_SCREEN		0		// the whole screen, black around the text
+#define TEXT_OVERLAY	1		// only the pixels of the text, over the game
+
+void text_clear (void);
+void text_add_P (const char* s);
+void text_add_number (uint16_t n);
+void text_scroll (uint8_t color, uint8_t mode, uint8_t frames, uint8_t repeat);
+void text_stop (void);
+uint8_t text_playing (void);
+uint8_t text_step (void);
+void text_frame (void);
+
+#endif /* TRI2S_TEXT_H */
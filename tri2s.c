@@ -49,14 +49,22 @@
 #include "mydefs.h"
 #include "iodefs.h"
 #include "miggl.h"			/* Mignonette Game Library */
+#include "tri2s-core.h"		/* the game rules */
+#include "tri2s-ai.h"		/* the computer player */
+#include "tri2s-record.h"	/* recording games into the EEPROM */
+#include "tri2s-anim.h"		/* animations */
+#include "tri2s-text.h"		/* scrolling text */
+#include "ramcheck.h"		/* free RAM */
+#ifdef TELEMETRY
+#include "telemetry.h"		/* records over the UART */
+#endif
+#ifdef LINK
+#include "uart.h"
+#include "tri2s-link.h"		/* a match against another Mignonette */
+#endif
 
-#define UP 		0x01
-#define LEFT 	0x02
-#define MIDDLE  0x04
-#define RIGHT 	0x08
-#define DOWN 	0x10
 // korobeneiki - at least something similiar 
-byte IntroSong[] = {
+const byte IntroSong[] PROGMEM = {
 	N_E4,N_QUARTER,
 	N_B3,N_8TH,
 	N_C4,N_8TH,
@@ -98,35 +106,150 @@ byte IntroSong[] = {
 	N_END
 };
 
+// while a game is played: two beats to start, then arpeggios of Am, G, F and E, over and over
+const byte GameSong[] PROGMEM = {
+	N_A3,N_QUARTER,
+	N_E4,N_QUARTER,
+	N_LOOP,
+	N_A3,N_8TH, N_C4,N_8TH, N_E4,N_8TH, N_C4,N_8TH,
+	N_A3,N_8TH, N_C4,N_8TH, N_E4,N_8TH, N_A4,N_8TH,
+	N_G3,N_8TH, N_B3,N_8TH, N_D4,N_8TH, N_B3,N_8TH,
+	N_G3,N_8TH, N_B3,N_8TH, N_D4,N_8TH, N_G4,N_8TH,
+	N_F3,N_8TH, N_A3,N_8TH, N_C4,N_8TH, N_A3,N_8TH,
+	N_F3,N_8TH, N_A3,N_8TH, N_C4,N_8TH, N_F4,N_8TH,
+	N_E3,N_8TH, N_GS3,N_8TH, N_B3,N_8TH, N_GS3,N_8TH,
+	N_E3,N_8TH, N_GS3,N_8TH, N_B3,N_8TH, N_E4,N_8TH,
+	N_END
+};
 
-// the bitmaps displayed for the intro screen
-uint8_t IntroScreenGreen[] = { 0x0E, 0xFA, 0x82, 0xFA, 0x0E };
-uint8_t IntroScreenYellow[] = { 0x00, 0x04, 0x7C, 0x04, 0x00 };
+// the game over, once (it waits for the sound effect first), then the intro song follows
+const byte GameOverSong[] PROGMEM = {
+	N_REST,N_HALF,
+	N_E4,N_QUARTER,
+	N_DS4,N_QUARTER,
+	N_D4,N_QUARTER,
+	N_CS4,N_HALF_DOT,
+	N_END
+};
 
-// the bitmaps displayed for the game over screen
-uint8_t GameOverScreenRed[] = { 0x0E, 0x1A, 0x12, 0x1A, 0x0E };
-uint8_t GameOverScreenYellow[] = { 0xA0, 0xA4, 0x40, 0xA4, 0xA0 };
 
-// bitmap for the current stone
-uint8_t MaskField[] = { 0x00, 0x00, 0x00, 0x00, 0x00 };
+// the intro screen
+const struct anim_step IntroAnim[] PROGMEM = {
+	{ 0, A_CLEAR },
+	{ 0, A_BITMAP, GREEN, { 0x0E, 0xFA, 0x82, 0xFA, 0x0E } },
+	{ ANIM_HOLD, A_BITMAP, YELLOW, { 0x00, 0x04, 0x7C, 0x04, 0x00 } },
+	{ 0, A_END }
+};
 
-// bitmap for the stacked stones
-uint8_t PlayField[] = { 0x00, 0x00, 0x00, 0x00, 0x00 };
+// the game over screen
+const struct anim_step GameOverAnim[] PROGMEM = {
+	{ 0, A_CLEAR },
+	{ 0, A_BITMAP, RED, { 0x0E, 0x1A, 0x12, 0x1A, 0x0E } },
+	{ ANIM_HOLD, A_BITMAP, YELLOW, { 0xA0, 0xA4, 0x40, 0xA4, 0xA0 } },
+	{ 0, A_END }
+};
 
-// the corner stones
-uint8_t CornerStones[] = {
-	UP | MIDDLE | RIGHT,
-	UP | LEFT | MIDDLE,	
-	LEFT | MIDDLE | DOWN,
-	MIDDLE | RIGHT | DOWN	
+#ifdef LINK
+// the screen of the winner of a match
+const struct anim_step WinAnim[] PROGMEM = {
+	{ 0, A_CLEAR },
+	{ 0, A_BITMAP, YELLOW, { 0x1C, 0x22, 0x22, 0x22, 0x1C } },
+	{ ANIM_HOLD, A_BITMAP, GREEN, { 0x40, 0x80, 0x40, 0x20, 0x10 } },
+	{ 0, A_END }
 };
+#endif
 
-// the straight stones
-uint8_t StraightStones[] = { 
-	UP | MIDDLE | DOWN,
-	LEFT | MIDDLE | RIGHT
+// blinks where complete lines were removed (the lines are the mask of anim_start())
+const struct anim_step LineBlinkAnim[] PROGMEM = {
+	{ 1, A_COLUMNS, YELLOW },
+	{ 1, A_COLUMNS, GREEN },
+	{ 0, A_END }
+};
+
+// flashes the screen, once per repeat: black becomes yellow, everything else red
+const struct anim_step FlashAnim[] PROGMEM = {
+	{ 1, A_RECOLOR, 0, { YELLOW, RED, RED, RED } },
+	{ 1, A_NONE },
+	{ 0, A_END }
+};
+
+// the sound effects (see struct sfx in miggl.h)
+const struct sfx RotateSfx[] PROGMEM = {
+	{ SFX_HZ(1200), SFX_SWEEP(1200, 1600, 24), SFX_MS(24), SFX_SQUARE, 20, 0 }
+};
+const struct sfx LandSfx[] PROGMEM = {
+	{ SFX_HZ(3000), SFX_SWEEP(3000, 600, 80), SFX_MS(80), SFX_NOISE, 40, 6 }
+};
+const struct sfx LinesSfx[] PROGMEM = {
+	{ SFX_HZ(400), SFX_SWEEP(400, 1600, 120), SFX_MS(120), SFX_SQUARE | SFX_CHAIN, 30, 0 },
+	{ SFX_HZ(1600), 0, SFX_MS(80), SFX_PULSE, 30, 5 }
+};
+const struct sfx LevelUpSfx[] PROGMEM = {
+	{ SFX_HZ(523), 0, SFX_MS(64), SFX_PULSE | SFX_CHAIN, 35, 0 },		// C5
+	{ SFX_HZ(659), 0, SFX_MS(64), SFX_PULSE | SFX_CHAIN, 35, 0 },		// E5
+	{ SFX_HZ(784), 0, SFX_MS(64), SFX_PULSE | SFX_CHAIN, 35, 0 },		// G5
+	{ SFX_HZ(1047), 0, SFX_MS(240), SFX_PULSE, 35, 12 }				// C6
 };
+const struct sfx GameOverSfx[] PROGMEM = {
+	{ SFX_HZ(600), SFX_SWEEP(600, 100, 400), SFX_MS(400), SFX_PULSE | SFX_CHAIN, 40, 40 },
+	{ SFX_HZ(1500), 0, SFX_MS(120), SFX_NOISE, 30, 8 }
+};
+
+// bitmap for the current stone
+field_t MaskField[FIELD_WIDTH];
+
+// the game in progress
+struct tri2s_state Game;
+
+// the computer player (for the demo, or for the game with AUTOPLAY)
+struct ai_player Player;
+
+// frames the intro screen waits for a key before a demo game starts
+#define ATTRACT_DELAY	100
+
+// frames the game over screen shows the skull before the lines scroll by
+#define GAMEOVER_FRAMES	20
+
+// frames after a key press before the buttons count again, time to let go of it
+#define KEY_FRAMES		3
+
+// timer ticks (50us) left free at the end of a frame when the demo player searches
+#define ATTRACT_MARGIN	20
 
+// timer ticks (50us) left in the frame the demo player needs for its first search step,
+// before any step was timed: half of the frame (100ms)
+#define ATTRACT_FIRST	1000
+
+// the demo player's search, spread over as many frames as it needs
+struct ai_search Search;
+uint8_t Searching;
+
+// worst case timer ticks (50us) the demo player spent searching (T_SEARCH with TELEMETRY) ...
+uint16_t AttractStepTicks;		// ... one line of the field
+uint16_t AttractFrameTicks;		// ... in one frame
+
+// what gameloop() plays
+#define MODE_PLAY		0		// a game with the buttons, recorded into the EEPROM
+#define MODE_DEMO		1		// a demo game played by the computer
+#define MODE_REPLAY		2		// the game recorded in the EEPROM
+
+// the sections of gameloop() timed by PROF_START() and PROF_STOP() (make PROFILE=1)
+#define PROF_RENDER		0		// drawing the field and the stone
+#define PROF_INPUT		1		// the buttons, the demo player or the replay
+#define PROF_LOGIC		2		// a step of the game rules
+#define PROF_LINES		3		// clearing complete lines
+
+#ifdef LINK
+// the match against another Mignonette
+struct link Link;
+
+// frames the link keeps going after the match, so the other one gets our last inputs
+#define LINK_LINGER		10
+#endif
+
+// the part of the field shown on the display (first line and column)
+uint8_t ViewX = 0;
+uint8_t ViewY = 0;
 
 //
 // draws bits 2 to 7 into a line of the screen with a given color
@@ -142,384 +265,531 @@ void draw_bit_line (uint8_t line, uint8_t color, uint8_t bits) {
 }
 
 //
-// draws a whole bitmap into the screen with a given color
+// draws the part of a field that is in view into the screen with a given color
 //
-void draw_bitmap (uint8_t* screen, uint8_t color) {
+void draw_field (field_t* field, uint8_t color) {
 	uint8_t y;
-	for (y = 0; y < YSCREEN; y++)
-		draw_bit_line(y, color, screen[y]);			
+	for (y = 0; (y < YSCREEN) && (ViewY + y < FIELD_WIDTH); y++)
+		draw_bit_line(y, color, (uint8_t)(field[ViewY + y] >> ViewX));
 }
 
 //
-// waits for a keypress and restarts music meanwhile if needed
+// returns the new start of a view of size n on a field of size max, so that
+// position pos is in view and has one line of its surroundings visible too
 //
-void wait_for_anykey (void) {
-	while (1) {
-		handlebuttons();
-		if (ButtonA || ButtonB || ButtonC || ButtonD)
-			break;
-	}
-	ButtonA = ButtonB = ButtonC = ButtonD = 0;
-	sleep_ms(250);
+uint8_t follow (uint8_t view, int8_t pos, uint8_t n, uint8_t max) {
+	if (pos < view + 1)
+		view = (pos < 1) ? 0 : (pos - 1);
+	else if (pos > view + n - 2)
+		view = pos - n + 2;
+	return (view > max - n) ? (max - n) : view;
 }
 
 //
-// shows the intro screen and waits for a keypress
+// moves the view along with the stone at (x y), if the field is larger than the screen
 //
-void show_intro_screen (void) {
-	// show bitmap
-	cleardisplay();	
-	draw_bitmap(IntroScreenGreen, GREEN);
-	draw_bitmap(IntroScreenYellow, YELLOW);
-	swapbuffers();
-	sleep_ms(250);	
-	// wait for keypress
-	wait_for_anykey();
+void update_viewport (int8_t x, int8_t y) {
+#if FIELD_LINES > XSCREEN
+	ViewX = follow(ViewX, x - 1, XSCREEN, FIELD_LINES);		// x - 1 is the line of the stone's center
+#endif
+#if FIELD_WIDTH > YSCREEN
+	ViewY = follow(ViewY, y, YSCREEN, FIELD_WIDTH);
+#endif
 }
 
 //
-// shows the game over screen and waits for a keypress
+// draws the animations and the text over the screen and shows it, until the frame ends
 //
-void show_gameover_screen (void) {
-	// show bitmap
-	cleardisplay();	
-	draw_bitmap(GameOverScreenRed, RED);
-	draw_bitmap(GameOverScreenYellow, YELLOW);
+void show_frame (void) {
+	anim_frame();
+	text_frame();
 	swapbuffers();
-	sleep_ms(250);	
-	// wait for keypress
-	wait_for_anykey();
 }
 
-// 
-// rotates a stone, returns the rotated stone
-//
-uint8_t rotate_stone (uint8_t stone) {
-	// get idx of stone in CornerStones
-	int8_t  idx = -1;
-	uint8_t j = 0;
-	uint8_t isStraight = 0;
-	for (j = 0; j < 4; j++) 
-		if (CornerStones[j] == stone) {
-			idx = j;
-			isStraight = 0;
-			break;		
+//
+// shows the screen as it is for n frames, the animations stand still
+//
+void hold_frames (uint8_t n) {
+	while (n--)
+		swapbuffers();
+}
+
+//
+// waits for a keypress, but for at most n frames (0 waits forever), with the
+// animations going on.  returns 1 if a key was pressed or 0 otherwise
+//
+uint8_t wait_for_key (uint8_t n) {
+	while (1) {
+		handlebuttons();
+		if (ButtonA || ButtonB || ButtonC || ButtonD)
+			break;
+		if (frameticksleft() == 0) {
+			show_frame();
+			if (n && (--n == 0))
+				return 0;
 		}
-	// if not found get idx of stone in StraightStones
-	if (idx == -1) 
-		for (j = 0; j < 2; j++) 
-			if (StraightStones[j] == stone) {
-				idx = j;
-				isStraight = 1;
-				break;		
-			}	
-	// if we found an idx ... return next idx in array
-	if (idx != -1) {
-		if (isStraight) 
-			return StraightStones[(idx == 1) ? 0 : idx + 1];		
-		else 
-			return CornerStones[(idx == 3) ? 0 : (idx + 1)];		
 	}
-	return 0;
+	ButtonA = ButtonB = ButtonC = ButtonD = 0;
+	for (n = 0; n < KEY_FRAMES; n++)
+		show_frame();
+	return 1;
 }
 
 //
-// clears a bitmap
+// waits for a keypress with the screen standing still (the pause)
 //
-void clear_bitmap (uint8_t* screen) {
-	uint8_t i = 0;
-	for (i = 0; i < 5; i++)
-		screen[i] = 0x00;
+void wait_for_anykey (void) {
+	hold_frames(KEY_FRAMES);
+	do
+		handlebuttons();
+	while (!(ButtonA || ButtonB || ButtonC || ButtonD));
+	ButtonA = ButtonB = ButtonC = ButtonD = 0;
+	hold_frames(KEY_FRAMES);
 }
 
 //
-// draws a pixel into a bitmap
+// shows the intro screen and waits for a keypress
+// returns 1 if a key was pressed or 0 if it is time for a demo game
 //
-void draw_pixel_to_bitmap (uint8_t* screen, uint8_t x, uint8_t y) {
-	if ((x <= XSCREEN) && (y < YSCREEN))
-		screen[y] = screen[y] | (0x01 << x);
+uint8_t show_intro_screen (void) {
+	uint8_t key;
+
+	anim_screen(IntroAnim);
+	show_frame();
+	key = wait_for_key(ATTRACT_DELAY);
+	anim_screen(NULL);
+	return key;
 }
 
 //
-// draws a stone into a given bitmap
+// returns the lines the game solved.  not levelcount times the lines per level plus
+// solvedlines: the lines a clear solves beyond the next level are dropped with the
+// level-up, and levelcount wraps
 //
-void draw_stone_to_bitmap (uint8_t* screen, uint8_t x, uint8_t y, uint8_t stone) {
-	draw_pixel_to_bitmap (screen, x, y);
-	if ((stone & UP) == UP)
-		draw_pixel_to_bitmap  (screen, x - 1, y);
-	if ((stone & DOWN) == DOWN)
-		draw_pixel_to_bitmap  (screen, x + 1, y);
-	if ((stone & LEFT) == LEFT)
-		draw_pixel_to_bitmap  (screen, x, y + 1);
-	if ((stone & RIGHT) == RIGHT)
-		draw_pixel_to_bitmap  (screen, x, y - 1);
-}	
+uint16_t game_lines (void) {
+	return Game.totallines;
+}
 
 //
-// finds the next complete line in the playfield, starting out from the bottom
-// returns the index of the line
+// shows the game over screen, then the lines of the game scrolling by, until a keypress
 //
-int8_t get_complete_line () {
-	int8_t i = 0, j = 0, k = 0;
-
-	for (j = XSCREEN - 1; j >= 0; j--) {
-		k = 0;	
-		for (i = 0; i < 5; i++)
-			if ((PlayField[i] & (0x02 << j)) == (0x02 << j))
-				k++;
-		if (k == 5)
-			return j;
+void show_gameover_screen (void) {
+	anim_screen(GameOverAnim);
+	show_frame();
+	if (!wait_for_key(GAMEOVER_FRAMES)) {
+		text_clear();
+		text_add_P(PSTR("LINES "));
+		text_add_number(game_lines());
+		text_scroll(YELLOW, TEXT_SCREEN, 1, 0);
+		wait_for_key(0);
+		text_stop();
 	}
-	return -1;
+	anim_screen(NULL);
 }
 
 //
-// clears a line in the playfield, by first blinking it, then removing the line
-// and finally shifting the stuff above down a line
+// removes the complete lines from the field and lets the stuff above drop down,
+// where they were blinks for a while over the game
+// returns the events of removing them (see tri2s_settle())
 //
-void clear_line (int8_t line) {
-	uint8_t i = 0;
-	uint8_t mask_lower = 0xFF << (line + 2);
-	uint8_t mask_upper = 0xFF >> (XSCREEN - line);
-
-	// make line blink...
-	setcolor(YELLOW);
-	drawfilledrect(line, 0, line, YSCREEN - 1);
-	swapbuffers();
-	sleep_ms(25);
-	setcolor(GREEN);
-	drawfilledrect(line, 0, line, YSCREEN - 1);
-	swapbuffers();
-	sleep_ms(25);
-	setcolor(YELLOW);
-	drawfilledrect(line, 0, line, YSCREEN - 1);
-	swapbuffers();
-	sleep_ms(25);
-	setcolor(GREEN);
-	drawfilledrect(line, 0, line, YSCREEN - 1);
-	swapbuffers();
-	sleep_ms(25);
-		
-	// remove line from bitmap and drop the upper part one down
-	for (i = 0; i < 5; i++) 
-		PlayField[i] = ((PlayField[i] & mask_upper) << 0x01) | (PlayField[i] & mask_lower);
+uint8_t clear_lines (field_t lines) {
+	anim_start(LineBlinkAnim, (uint8_t)(lines >> ViewX), 1);
+	return tri2s_settle(&Game);
+}
 
-	// update the display
+#ifdef RAMCHECK
+//
+// shows the free RAM in units of 8 bytes, as binary numbers with the lowest bit at the
+// top: the least there ever was in the right column (red), right now next to it (green)
+//
+void show_ram_free (void) {
 	cleardisplay();
-	draw_bitmap(PlayField, GREEN);
+	draw_bit_line(0, RED, (uint8_t)(ram_free_min() / 8) << 1);
+	draw_bit_line(1, GREEN, (uint8_t)(ram_free() / 8) << 1);
 	swapbuffers();
-	sleep_ms(50);
 }
+#endif
 
-//
-// checks if two bitmaps overlap, returns 1 if they do or 0 otherwise
-//
-uint8_t screens_overlap (uint8_t* screen1, uint8_t* screen2) {
-	uint8_t i = 0;
-	for (i = 0; i < 5; i++)
-		if ((screen1[i] & screen2[i]) != 0)
-			return 1;
-	return 0;
+// flashes the screen n times, over the game
+void flash_screen (uint8_t n) {
+	anim_start(FlashAnim, 0, n);
 }
 
 //
-// checks if a pixel is set in a bitmap, returns 1 if they do or 0 otherwise
+// the music: the intro song loops on the intro screen and in the demo ...
 //
-uint8_t is_field_set (uint8_t* screen, uint8_t x, uint8_t y) {
-	return ((screen[y] & (0x01 << x)) == (0x01 << x)) ? 1 : 0;
+void intro_music (void) {
+	playsong(IntroSong);
+	loopsong(1);
 }
 
 //
-// tests wether a stone can be moved in a given direction
-// returns 1 if they do or 0 otherwise
-//
-uint8_t can_move_stone (uint8_t* screen, uint8_t stone, uint8_t x, uint8_t y, uint8_t dir) {
-	// stone can be moved, if ...
-	uint8_t canmove = 0;
-	uint8_t TempField[] = { 0x00, 0x00, 0x00, 0x00, 0x00 };
-	int8_t left = ((stone & LEFT) == LEFT) ? (y + 1) : y;
-	int8_t right = ((stone & RIGHT) == RIGHT) ? (y - 1) : y;
-	int8_t down = ((stone & DOWN) == DOWN) ? (x + 1) : x;
-
-	// ... it  stays within screen bounds
-	if (((dir & LEFT) == LEFT) && (left <= YSCREEN - 1))
-		canmove |= LEFT;
-	if (((dir & RIGHT) == RIGHT) && (right >= 0))
-		canmove |= RIGHT;
-	if (((dir & DOWN) == DOWN) && (down <= XSCREEN))
-		canmove |= DOWN;
-	// UP is not needed
-
-	// ... it does not overlap
-	draw_stone_to_bitmap(TempField, x, y, stone);
-	if (screens_overlap(screen, TempField))
-		canmove &= ~dir;
-
-	return ((canmove & dir) == dir) ? 1 : 0;
+// ... the game's song while a game is played ...
+//
+void game_music (void) {
+	playsong(GameSong);
+	loopsong(1);
 }
 
 //
-// tests wether a stone can be rotated
-// returns 1 if they do or 0 otherwise
+// ... and at the game over its tune plays once, the intro song follows it without a gap
 //
-uint8_t can_rotate_stone (uint8_t* screen, uint8_t stone, uint8_t x, uint8_t y) {
-	// stone can be rotated, if ...
-	uint8_t s = rotate_stone (stone);
-	uint8_t TempField[] = { 0x00, 0x00, 0x00, 0x00, 0x00 };	
-	int8_t left = ((s & LEFT) == LEFT) ? (y + 1) : y;
-	int8_t right = ((s & RIGHT) == RIGHT) ? (y - 1) : y;
-	int8_t down = ((s & DOWN) == DOWN) ? (x + 1) : x;
-	
-	// ... it  stays within screen bounds
-	if (left > YSCREEN - 1)
-		return 0;
-	if (right < 0)
-		return 0;
-	if (down > XSCREEN)
-		return 0;
+void gameover_music (void) {
+	loopsong(0);
+	playsong(GameOverSong);
+	queuesong(IntroSong, 1);
+}
 
-	// ... it does not overlap
-	draw_stone_to_bitmap(TempField, x, y, s);
-	if (screens_overlap(screen, TempField))
-		return 0;
-	return 1;
+//
+// plays the sound effect of the events of a frame (input is what was played).  the game
+// over, a new level and complete lines cut off any effect that is playing, a landing
+// stone or a rotation only get theirs when none is.
+//
+void event_sfx (uint8_t events, uint8_t input) {
+	if (events & EV_GAMEOVER)
+		sfx_play(GameOverSfx);
+	else if (events & EV_LEVELUP)
+		sfx_play(LevelUpSfx);
+	else if (events & EV_LINES)
+		sfx_play(LinesSfx);
+	else if (sfx_playing())
+		return;
+	else if (events & EV_LAND)
+		sfx_play(LandSfx);
+	else if ((events & EV_MOVE) && (input & IN_ROTATE))
+		sfx_play(RotateSfx);
 }
 
 //
-// gets a random stone and returns it
+// returns the demo player's input for the next frame, events are the events of
+// the last frame.  while the player is still searching the stone just falls.
 //
-uint8_t get_random_stone () {
-	uint8_t idx = (uint8_t) nextrandom(6);
-	if (idx < 4)
-		return CornerStones[idx];
-	return StraightStones[idx - 4];
-}
+uint8_t attract_input (uint8_t events) {
+	field_t f[FIELD_WIDTH];
+	uint8_t input;
 
-// flashes the screen n times
-void flash_screen (uint8_t n) {
-	uint8_t i, x, y;
+	if (events & EV_LAND)
+		Player.planned = 0;
+	if (Searching)
+		return 0;
 
-	for (i = 0; i < n; i++) {
-		for (x = 0; x < XSCREEN; x++) 	
-			for (y = 0; y < YSCREEN; y++) {
-				setcolor ((readpixel(x, y) == BLACK) ? YELLOW : RED);
-				drawpoint(x ,y);
-			}
-		swapbuffers();
-		sleep_ms(50);
-		for (x = 0; x < XSCREEN; x++) 	
-			for (y = 0; y < YSCREEN; y++) {
-				setcolor ((readpixel(x, y) == YELLOW) ? BLACK: GREEN);
-				drawpoint(x, y);
-			}
-		swapbuffers();
-		sleep_ms(50);
+	ai_settled_field(f, &Game);
+	if (Player.planned) {
+		input = ai_steer(&Player.target, f, &Game);
+		if (input != AI_BLOCKED)
+			return input;
+	}
+	// new stone, or the way is blocked: look (again) from here
+	ai_search_begin(&Search, f, Game.stone, Game.stonex, Game.stoney);
+	Searching = 1;
+	Player.planned = 0;
+	return 0;
+}
+
+//
+// lets the demo player search in the rest of the current frame.  it does one line of
+// the field after another, as long as the worst case of one line still fits into
+// what is left of the frame, so the frame (and the sound) is never delayed.  the first
+// step, whose worst case is not known yet, waits for a frame with ATTRACT_FIRST left.
+//
+void attract_think (void) {
+	uint16_t start, left, now;
+
+	if (!Searching)
+		return;
+
+	start = left = frameticksleft();
+	if ((AttractStepTicks == 0) && (left < ATTRACT_FIRST))
+		return;
+	while (left > AttractStepTicks + ATTRACT_MARGIN) {
+		uint8_t done = ai_search_step(&Search);
+		now = frameticksleft();
+		if ((now < left) && (left - now > AttractStepTicks))
+			AttractStepTicks = left - now;
+		left = now;
+		if (done) {
+			Player.target = Search.best;
+			Player.planned = 1;
+			Searching = 0;
+			break;
+		}
 	}
+	if ((left < start) && (start - left > AttractFrameTicks))
+		AttractFrameTicks = start - left;
 }
 
 // 
-// the gameloop for the actual gameplay
+// the gameloop for the actual gameplay, a demo game played by the computer or
+// the replay of the recorded game (see MODE_*)
+// returns 1 if a key ended the demo or the replay, 0 if the game is over
 //
-void gameloop (void) {
+uint8_t gameloop (uint8_t mode) {
 
-	int8_t stonex = 0, stoney = 2;
-	int8_t falltime = 9;
-	int8_t falltimemax = 9;
-	int8_t  completeline = -1;
-	uint8_t stone = get_random_stone();
-	uint8_t solvedlines = 0;
-	uint8_t levelcount = 0;
+	uint8_t input, events = 0;
+	uint32_t seed = nextrandom(0xFFFFFFFFUL);
 
-	clear_bitmap(MaskField);
-	clear_bitmap(PlayField);
+	if ((mode == MODE_REPLAY) && !playback_begin(&seed))
+		return 1;
+	if (mode == MODE_PLAY) {
+		record_begin(seed);
+		game_music();
+	}
+	tri2s_init(&Game, seed);
+	ViewX = ViewY = 0;
+	Player.planned = 0;
+	Searching = 0;
+	anim_stop(NULL);
+	text_stop();
 
 	while (1) {
 
 		// draw display
+		PROF_START(PROF_RENDER);
+		update_viewport(Game.stonex, Game.stoney);
 		cleardisplay();		
-		clear_bitmap(MaskField);
-		draw_stone_to_bitmap(MaskField, stonex, stoney, stone);
-		draw_bitmap(PlayField, GREEN);
-		draw_bitmap(MaskField, RED);		
+		field_clear(MaskField);
+		field_place_stone(MaskField, Game.stone, Game.stonex, Game.stoney);
+		draw_field(Game.field, GREEN);
+		draw_field(MaskField, RED);		
+		PROF_STOP(PROF_RENDER);
 
 		// handle the button presses
+		PROF_START(PROF_INPUT);
 		handlebuttons();
 
-		if (ButtonB) { 				// pause
-			sleep_ms(250);
+		input = 0;
+		if (mode != MODE_PLAY) {	// any key ends the demo or the replay
+			if (ButtonA || ButtonB || ButtonC || ButtonD) {
+				ButtonA = ButtonB = ButtonC = ButtonD = 0;
+				hold_frames(KEY_FRAMES);
+				return 1;
+			}
+			if (mode == MODE_DEMO)
+				input = attract_input(events);
+			else if (!playback_input(&input, events))
+				return 1;			// the recording ends before the game
+		} else if (ButtonB) { 				// pause
+#ifdef RAMCHECK
+			show_ram_free();
+#endif
 			wait_for_anykey();
+#ifdef AUTOPLAY
+		} else {					// the computer plays
+			input = ai_play(&Player, &Game, events);
+#else
 		} else if (ButtonA && ButtonAEvent) { 		// rotate
-			if (can_rotate_stone(PlayField, stone, stonex, stoney))
-				stone = rotate_stone(stone);
-				ButtonAEvent = 0;
+			input = IN_ROTATE;
+			ButtonAEvent = 0;
 		} else if (ButtonC) { 		// move left
-			if (can_move_stone(PlayField, stone, stonex, stoney + 1, LEFT))
-				stoney++;
+			input = IN_LEFT;
 		} else if (ButtonD) { 		// move right
-			if (can_move_stone(PlayField, stone, stonex, stoney - 1, RIGHT))
-				stoney--;
+			input = IN_RIGHT;
+#endif
+		}
+		PROF_STOP(PROF_INPUT);
+
+		PROF_START(PROF_LOGIC);
+		if (mode == MODE_PLAY)
+			record_input(input, events);
+		events = tri2s_step(&Game, input);
+		PROF_STOP(PROF_LOGIC);
+
+		if (events & EV_LAND) {
+			cleardisplay();
+			draw_field(Game.field, GREEN);
+			show_frame();
 		}
 
-		// let stone fall
-		falltime--;
-		if (falltime <= 0) {
-			falltime = falltimemax;
-			if (can_move_stone(PlayField, stone, stonex + 1, stoney, DOWN))
-				stonex++;
-			else {
-				draw_stone_to_bitmap(PlayField, stonex, stoney, stone);
-				cleardisplay();
-				draw_bitmap(PlayField, GREEN);
-				swapbuffers();
-				
-				// if fallen stone is to high and reaches out of the display ... game over
-				if (stonex <= 0) 
-					return;
-
-				// continue with next stone ...
-				stonex = 0;
-				stoney = 2; 
-				stone = get_random_stone();
-				falltime = falltimemax;
+		// if fallen stone is to high and reaches out of the field ... game over
+		if (events & EV_GAMEOVER) {
+#ifdef TELEMETRY
+			telemetry_game(events, Game.levelcount, Game.solvedlines);
+#endif
+			if (mode != MODE_DEMO)
+				event_sfx(events, input);
+			if (mode == MODE_PLAY) {
+				record_end(&Game);
+				gameover_music();
+			} else if ((mode == MODE_REPLAY) && !playback_check(&Game)) {
+				flash_screen(1);	// the replay went different from the game
 			}
+			return 0;
 		}
 
-		// check if line complete
-		completeline = -1;
-		while ((completeline = get_complete_line()) != -1) {
-			clear_line(completeline);
-			solvedlines++;
-			sleep_ms(120);
+		// check if lines complete
+		if (events & EV_LINES) {
+			PROF_START(PROF_LINES);
+			events |= clear_lines(Game.lines);
+			PROF_STOP(PROF_LINES);
 		}
 
+#ifdef TELEMETRY
+		if (events & ~(EV_MOVE | EV_FALL))
+			telemetry_game(events, Game.levelcount, Game.solvedlines);
+#endif
+
 		// we get faster after a while
-		if (solvedlines >= 10) { 
-			solvedlines = 0;		
-			falltimemax = (falltimemax < 1) ? 0 : (falltimemax - 1);
-			levelcount++;
-			// flash the screen level count times, to  indicate progress...
-			flash_screen(levelcount);
+		if (events & EV_LEVELUP) {
+			// flash the screen and show the new level (the first one is 1) over the game
+			flash_screen(1);
+			text_clear();
+			text_add_P(PSTR("LEVEL "));
+			text_add_number(Game.levelcount + 1);
+			text_scroll(YELLOW, TEXT_OVERLAY, 1, 1);
 		}
-		swapbuffers();
+
+		// the demo game is played to the song only
+		if (mode != MODE_DEMO)
+			event_sfx(events, input);
+
+		if (mode == MODE_DEMO)
+			attract_think();
+		if (mode == MODE_PLAY)
+			record_poll();
+#ifdef TELEMETRY
+		telemetry_frame(frameticksleft());
+		if (mode == MODE_DEMO)
+			telemetry_search(AttractStepTicks, AttractFrameTicks);
+#endif
+		show_frame();
 	}
 
 }
 
+#ifdef LINK
+//
+// takes the bytes the other Mignonette sent, plays the next tick of the match and sends
+// what the link has to send.  returns what link_tick() returned
+//
+uint8_t link_frame (uint8_t input) {
+	uint8_t buf[UART_RX_RING];
+	uint8_t i, n, r;
+
+	n = uart_read(buf, sizeof(buf));
+	for (i = 0; i < n; i++)
+		link_receive(&Link, buf[i]);
+	r = link_tick(&Link, input);
+	uart_write(Link.out, Link.outlen);	// if the ring is full, the inputs go with the next ones
+	return r;
+}
+
+//
+// a match against another Mignonette over the UART (see tri2s-link.h): both play the
+// same stones, clearing 2 or more lines at once pushes lines up under the other
+// field.  there is no pause.  returns 0 when the match is over, 1 if nobody answered
+// or the link was lost.
+//
+uint8_t linkloop (void) {
+	struct tri2s_state* g = &Link.current.game[0];
+	uint8_t input, r;
+
+	uart_init();
+	link_begin(&Link, nextrandom(0xFFFFFFFFUL));
+	game_music();
+	ViewX = ViewY = 0;
+	anim_stop(NULL);
+	text_stop();
+
+	do {
+		handlebuttons();
+		input = 0;
+		if (ButtonA && ButtonAEvent)
+			input = IN_ROTATE;
+		else if (ButtonC)
+			input = IN_LEFT;
+		else if (ButtonD)
+			input = IN_RIGHT;
+
+		r = link_frame(input);
+		event_sfx(Link.events, input);		// (none if no tick was played)
+		if (r == LINK_PLAYED) {
+			g = &Link.current.game[Link.me];
+			if (input == IN_ROTATE)
+				ButtonAEvent = 0;		// a waiting tick keeps the rotation for the next one
+			if (Link.current.cleared[Link.me])
+				anim_start(LineBlinkAnim, (uint8_t)(Link.current.cleared[Link.me] >> ViewX), 1);
+			if (Link.events & EV_GARBAGE)
+				flash_screen(1);
+		}
+
+		update_viewport(g->stonex, g->stoney);
+		cleardisplay();
+		if (Link.state != LINK_WAIT) {
+			field_clear(MaskField);
+			field_place_stone(MaskField, g->stone, g->stonex, g->stoney);
+			draw_field(g->field, GREEN);
+			draw_field(MaskField, RED);
+		}
+		show_frame();
+	} while ((r == LINK_WAIT) || (r == LINK_PLAYED));
+
+	if (r == LINK_LOST) {
+		intro_music();
+		return 1;
+	}
+	gameover_music();
+	for (r = 0; r < LINK_LINGER; r++) {
+		link_frame(0);
+		show_frame();
+	}
+	return 0;
+}
+
+//
+// shows who won the match and waits for a keypress
+//
+void show_link_result (void) {
+	anim_screen((link_result(&Link) == LINK_WIN) ? WinAnim : GameOverAnim);
+	show_frame();
+	wait_for_key(0);
+	anim_screen(NULL);
+}
+#endif
+
 // 
 // tri2s main program
 //
 int main (void) {
 	
 	initmiggl();
+#ifdef TELEMETRY
+	telemetry_init();
+#endif
 
 	setenvelope(128, 32, 60, 32);
 
-	playsong(IntroSong);
-	loopsong(1);
+	intro_music();
+
+	// D held down while switching on ... replay the last game
+	sleep_ms(50);
+	handlebuttons();
+	if (ButtonD) {
+		do {						// wait until it is let go
+			ButtonD = 0;
+			sleep_ms(20);
+			handlebuttons();
+		} while (ButtonD);
+		if (!gameloop(MODE_REPLAY))
+			show_gameover_screen();
+	}
+#ifdef LINK
+	// C held down ... a match against the Mignonette on the other end of the UART
+	if (ButtonC) {
+		do {
+			ButtonC = 0;
+			sleep_ms(20);
+			handlebuttons();
+		} while (ButtonC);
+		if (!linkloop())
+			show_link_result();
+	}
+#endif
 	
 	while (1) {
-		show_intro_screen();
-		gameloop();
+		// nobody pressed a key ... show a demo game, until it is over or a key is pressed
+		if (!show_intro_screen() && !gameloop(MODE_DEMO))
+			continue;
+		gameloop(MODE_PLAY);
 		show_gameover_screen();
 	}
 	return 0;
@@ -0,0 +1,127 @@
+/*
+ *	uart.c - the UART of the atmega168, transmitting from a ring buffer
+ *
+ *	(see uart.h)  the main program is the only one to add to the ring and the
+ *	USART_UDRE interrupt the only one to take from it, so neither has to turn off
+ *	the interrupts: each of them writes only its own index (see struct ring_idx in
+ *	isrsafe.h).  adding a byte takes about 10 cycles and never waits; the
+ *	interrupt takes about 30 cycles per byte sent.
+ *
+ *	the receiver works the other way round: the USART_RX interrupt puts the bytes
+ *	into a ring of its own and the main program takes them with uart_read().  a byte
+ *	that doesn't fit is dropped (the link checks its messages, see tri2s-link.h).
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "mydefs.h"
+#include "miggl.h"
+#include "uart.h"
+#include "isrsafe.h"
+
+#define UART_UBRR	((F_CPU + UART_BAUD * 4) / (UART_BAUD * 8) - 1)		// rounded, for U2X0
+
+static uint8_t TxRing[UART_TX_RING];
+static struct ring_idx TxIdx;		// the main program puts bytes at the head, the interrupt sends from the tail
+static uint8_t RxRing[UART_RX_RING];
+static struct ring_idx RxIdx;		// the interrupt puts bytes at the head, the main program takes them
+
+
+//
+// sends the next byte of the ring, and stops when it is empty
+//
+ISR(USART_UDRE_vect)
+{
+	uint8_t tail = TxIdx.tail;
+
+	if (tail == TxIdx.head) {
+		UCSR0B &= ~_BV(UDRIE0);
+		return;
+	}
+	UDR0 = TxRing[tail];
+	ring_take(&TxIdx, RING_NEXT(tail, UART_TX_RING));
+}
+
+//
+// puts a received byte into the ring, or drops it if the ring is full
+//
+ISR(USART_RX_vect)
+{
+	uint8_t head = RxIdx.head;
+	uint8_t b = UDR0;
+
+	if (RING_NEXT(head, UART_RX_RING) == RxIdx.tail)
+		return;
+	RxRing[head] = b;
+	ring_put(&RxIdx, RING_NEXT(head, UART_RX_RING));
+}
+
+//
+// 8 data bits, no parity, 1 stop bit.  this takes PD1 (ROW2) and PD0 from the display
+// and PORTD; call it after initmiggl(), avrinit() turns the transmitter off.
+//
+void uart_init (void) {
+	TxIdx.head = TxIdx.tail = 0;
+	RxIdx.head = RxIdx.tail = 0;
+	UBRR0 = UART_UBRR;
+	UCSR0A = _BV(U2X0);
+	UCSR0C = _BV(UCSZ01) | _BV(UCSZ00);
+	UCSR0B = _BV(TXEN0) | _BV(RXEN0) | _BV(RXCIE0);
+}
+
+//
+// returns the free space in the ring (one byte of it always stays empty)
+//
+uint8_t uart_free (void) {
+	return ring_free(&TxIdx, UART_TX_RING);
+}
+
+//
+// queues n bytes, all or none.  returns 1 if they were queued, 0 if the ring is too full.
+//
+uint8_t uart_write (const uint8_t* buf, uint8_t n) {
+	uint8_t head = TxIdx.head;
+
+	if (n > uart_free())
+		return 0;
+	while (n--) {
+		TxRing[head] = *buf++;
+		head = RING_NEXT(head, UART_TX_RING);
+	}
+	ring_put(&TxIdx, head);		// the bytes are in the ring before the interrupt sees them
+	// the interrupt may turn UDRIE0 off in between, but then it has sent everything
+	// before the new bytes and turning it back on is right
+	UCSR0B |= _BV(UDRIE0);
+	return 1;
+}
+
+int uart_putchar (char c, FILE* stream) {
+	uint8_t b = c;
+	return uart_write(&b, 1) ? 0 : -1;
+}
+
+//
+// takes up to n received bytes into buf, returns how many
+//
+uint8_t uart_read (uint8_t* buf, uint8_t n) {
+	uint8_t tail = RxIdx.tail;
+	uint8_t i;
+
+	for (i = 0; (i < n) && (tail != RxIdx.head); i++) {
+		buf[i] = RxRing[tail];
+		tail = RING_NEXT(tail, UART_RX_RING);
+	}
+	ring_take(&RxIdx, tail);	// the bytes are read before the interrupt may overwrite them
+	return i;
+}
+
+int uart_getchar (FILE* stream) {
+	uint8_t b;
+	return uart_read(&b, 1) ? b : -1;
+}
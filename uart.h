@@ -9,6 +9,12 @@
  * Stdio demo, UART declarations
  *
  * $Id: uart.h,v 1.1.2.1 2005/12/28 22:35:08 joerg_wunsch Exp $
+ *
+ * implemented in uart.c for the Mignonette: the transmitter sends from a ring
+ * buffer, one byte per USART_UDRE interrupt, so writing never waits for the
+ * line, and the receiver fills a ring in the USART_RX interrupt.  TxD is PD1,
+ * which is ROW2 of the display as well, so with the UART on that row shows
+ * the serial data instead of the picture.
  */
 
 /* CPU frequency */
@@ -16,8 +22,18 @@
 //#define F_CPU 8000000UL
 //#define F_CPU 1000000UL
 
-/* UART baud rate */
-#define UART_BAUD  9600
+/* UART baud rate (with U2X0, 38461 at 8MHz) */
+#define UART_BAUD  38400
+
+/*
+ * Bytes waiting to be sent (a power of 2, at most 256).
+ */
+#define UART_TX_RING 64
+
+/*
+ * Bytes received and not read yet (a power of 2, at most 256).
+ */
+#define UART_RX_RING 32
 
 /*
  * Perform UART startup initialization.
@@ -25,18 +41,29 @@
 void	uart_init(void);
 
 /*
- * Send one character to the UART.
+ * Send one character to the UART.  Returns -1 without waiting if the
+ * ring is full.
  */
 int	uart_putchar(char c, FILE *stream);
 
 /*
- * Size of internal line buffer used by uart_getchar().
+ * Send n bytes, all of them or (if they don't fit into the ring) none.
+ * Returns 1 if they were queued.
+ */
+uint8_t	uart_write(const uint8_t *buf, uint8_t n);
+
+/*
+ * Free space in the transmit ring.
+ */
+uint8_t	uart_free(void);
+
+/*
+ * Take up to n received bytes, returns how many there were.
  */
-#define RX_BUFSIZE 80
+uint8_t	uart_read(uint8_t *buf, uint8_t n);
 
 /*
- * Receive one character from the UART.  The actual reception is
- * line-buffered, and one character is returned from the buffer at
- * each invokation.
+ * Receive one character from the UART.  Returns -1 if there is none
+ * (there is no line buffer, see uart.c).
  */
 int	uart_getchar(FILE *stream);